@@ -0,0 +1,506 @@
+//! Persistent, user-global action cache backed by a content-addressable store.
+//!
+//! An action (e.g. compiling a single translation unit) is identified by a *base key*
+//! built from everything known before the action runs: the tool binary, the full
+//! argument vector, and the primary input's contents. Headers are only known after
+//! the compiler has written its `.d` file, so each base key maps to a *manifest* that
+//! records every input the action read along with its content hash. A lookup re-hashes
+//! those inputs and, if they all still match, restores the cached outputs instead of
+//! running the tool.
+//!
+//! The store lives under `~/.anubis/cache` so every mode, worktree, and checkout shares it:
+//! - `ac/{base_key}.json`: inputs from the last successful run and the hashes of its outputs
+//! - `cas/{hh}/{hash}`: output files keyed by the xxh3 hash of their contents
+//!
+//! Outputs are hardlinked between the store and `.anubis-build` (falling back to a copy
+//! across filesystems), so store entries must never be written in place. Rules call
+//! `unlink_outputs` before running a tool. For the same reason recency is tracked on
+//! manifests, never on blobs: a hit bumps the manifest's mtime, and `gc` treats a blob as
+//! last used when the newest manifest referencing it was.
+//!
+//! Input paths under the project root are stored root-relative (`./src/foo.h`) and resolved
+//! against the current root on lookup, so manifests are valid in any checkout.
+//!
+//! An optional `RemoteCache` backs the local store: local misses fall through to the remote,
+//! and successful actions are uploaded in the background.
+
+use crate::remote_cache::{RemoteCache, RemoteKind};
+use crate::util;
+use crate::{anyhow_loc, bail_loc, function_name};
+use anyhow::Context;
+use camino::{Utf8Path, Utf8PathBuf};
+use dashmap::DashMap;
+use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
+use std::hash::Hasher;
+use std::time::SystemTime;
+use xxhash_rust::xxh3::Xxh3;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug, Default)]
+pub struct ActionCache {
+    dir: Utf8PathBuf,
+
+    /// Tool binaries are large and identical for every action in a build, so hash them once.
+    tool_hashes: DashMap<Utf8PathBuf, u64>,
+
+    /// Project root that manifest input paths are relative to. Empty keeps absolute paths.
+    root: Utf8PathBuf,
+
+    remote: Option<RemoteCache>,
+}
+
+/// A file read by an action, with the xxh3 hash of its contents.
+#[derive(Clone, Debug, Serialize, Deserialize, Hash, PartialEq, Eq)]
+pub struct ActionInput {
+    pub path: Utf8PathBuf,
+    pub hash: u64,
+}
+
+/// Summary of a single `ActionCache::gc` pass.
+#[derive(Debug, Default)]
+pub struct GcStats {
+    pub blobs_removed: usize,
+    pub bytes_removed: u64,
+    pub bytes_remaining: u64,
+    pub manifests_removed: usize,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug, Serialize, Deserialize)]
+struct ActionManifest {
+    inputs: Vec<ActionInput>,
+    outputs: Vec<CachedOutput>,
+}
+
+#[derive(Debug, Serialize, Deserialize)]
+struct CachedOutput {
+    name: String,
+    hash: u64,
+    size: u64,
+
+    /// Restored on blobs downloaded from a remote cache, which arrive without permissions.
+    #[serde(default)]
+    executable: bool,
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl ActionCache {
+    pub fn new(dir: Utf8PathBuf) -> ActionCache {
+        ActionCache {
+            dir,
+            tool_hashes: Default::default(),
+            root: Default::default(),
+            remote: None,
+        }
+    }
+
+    pub fn set_root(&mut self, root: Utf8PathBuf) {
+        self.root = root;
+    }
+
+    pub fn set_remote(&mut self, remote: RemoteCache) {
+        self.remote = Some(remote);
+    }
+
+    /// Waits for queued remote uploads. Call once at the end of a build.
+    pub fn flush_uploads(&self) {
+        if let Some(remote) = &self.remote {
+            remote.flush();
+        }
+    }
+
+    pub fn dir(&self) -> &Utf8Path {
+        &self.dir
+    }
+
+    /// Returns the content hash of a tool binary, computing it at most once per process.
+    pub fn tool_hash(&self, tool: &Utf8Path) -> anyhow::Result<u64> {
+        if let Some(hash) = self.tool_hashes.get(tool) {
+            return Ok(*hash);
+        }
+
+        let hash = hash_file(tool)?;
+        self.tool_hashes.insert(tool.to_owned(), hash);
+        Ok(hash)
+    }
+
+    /// Attempts to satisfy an action from the cache.
+    /// - Returns the verified inputs if every recorded input still matches and all `outputs` were restored
+    /// - Returns `Ok(None)` on a miss; `outputs` are left untouched
+    pub fn lookup(&self, base_key: u64, outputs: &[&Utf8Path]) -> anyhow::Result<Option<Vec<ActionInput>>> {
+        let manifest_path = self.manifest_path(base_key);
+        let manifest_str = match std::fs::read_to_string(&manifest_path) {
+            Ok(s) => s,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => match self.fetch_manifest(base_key)? {
+                Some(s) => s,
+                None => return Ok(None),
+            },
+            Err(e) => return Err(e).with_context(|| anyhow_loc!("Failed to read manifest [{}]", manifest_path)),
+        };
+        let mut manifest: ActionManifest = serde_json::from_str(&manifest_str)
+            .with_context(|| anyhow_loc!("Failed to parse manifest [{}]", manifest_path))?;
+
+        // Every input the action read last time must be byte-identical
+        for input in &mut manifest.inputs {
+            input.path = util::resolve_root_relative(&input.path, &self.root);
+            match hash_file(&input.path) {
+                Ok(hash) if hash == input.hash => (),
+                _ => return Ok(None),
+            }
+        }
+
+        // Make sure every blob is present before touching anything. A size mismatch means
+        // the blob was evicted mid-write or modified through a hardlink.
+        if manifest.outputs.len() != outputs.len() {
+            return Ok(None);
+        }
+        let mut blobs = Vec::with_capacity(outputs.len());
+        for (cached, output) in manifest.outputs.iter().zip(outputs) {
+            if output.file_name() != Some(cached.name.as_str()) {
+                return Ok(None);
+            }
+            let blob = self.blob_path(cached.hash);
+            match std::fs::metadata(&blob) {
+                Ok(meta) if meta.len() == cached.size => blobs.push(blob),
+                _ if self.fetch_blob(cached)? => blobs.push(blob),
+                _ => return Ok(None),
+            }
+        }
+
+        touch(&manifest_path);
+        for (blob, output) in blobs.iter().zip(outputs) {
+            if let Some(parent) = output.parent() {
+                std::fs::create_dir_all(parent)?;
+            }
+            link_or_copy(blob, output)
+                .with_context(|| anyhow_loc!("Failed to restore [{}] from [{}]", output, blob))?;
+        }
+
+        Ok(Some(manifest.inputs))
+    }
+
+    /// Records a successful action.
+    /// - `inputs` are every file the action read (source plus headers from the `.d` file)
+    /// - `outputs` are added to the content-addressable store so a later lookup can restore them
+    /// - Returns the hashed inputs
+    pub fn store(&self, base_key: u64, inputs: &[Utf8PathBuf], outputs: &[&Utf8Path]) -> anyhow::Result<Vec<ActionInput>> {
+        let mut hashed_inputs = Vec::with_capacity(inputs.len());
+        for path in inputs {
+            hashed_inputs.push(ActionInput {
+                path: path.clone(),
+                hash: hash_file(path)?,
+            });
+        }
+
+        let mut manifest_outputs = Vec::with_capacity(outputs.len());
+        for output in outputs {
+            let name = output.file_name().ok_or_else(|| anyhow_loc!("No filename for [{}]", output))?;
+            let hash = hash_file(output)?;
+            let blob = self.blob_path(hash);
+            if !blob.exists() {
+                if let Some(parent) = blob.parent() {
+                    std::fs::create_dir_all(parent)
+                        .with_context(|| anyhow_loc!("Failed to create cache dir [{}]", parent))?;
+                }
+                let temp = util::temp_path(&blob);
+                link_or_copy(output, &temp).with_context(|| anyhow_loc!("Failed to cache [{}]", output))?;
+                std::fs::rename(&temp, &blob)?;
+            }
+            let meta = std::fs::metadata(&blob)?;
+            manifest_outputs.push(CachedOutput {
+                name: name.to_owned(),
+                hash,
+                size: meta.len(),
+                executable: is_executable(&meta),
+            });
+        }
+
+        // Write the manifest last so a lookup never sees a manifest without its outputs
+        let manifest = ActionManifest {
+            inputs: hashed_inputs
+                .iter()
+                .map(|input| ActionInput {
+                    path: util::root_relative(input.path.as_str(), &self.root).into(),
+                    hash: input.hash,
+                })
+                .collect(),
+            outputs: manifest_outputs,
+        };
+        let manifest_json = serde_json::to_string(&manifest)?;
+        util::write_atomic(&self.manifest_path(base_key), manifest_json.as_bytes())?;
+
+        // Blobs are queued ahead of the manifest so a remote reader never sees a dangling manifest
+        if let Some(remote) = &self.remote {
+            for output in &manifest.outputs {
+                remote.upload_file(RemoteKind::Cas, output.hash, self.blob_path(output.hash));
+            }
+            remote.upload_bytes(RemoteKind::ActionCache, base_key, manifest_json.into_bytes());
+        }
+
+        Ok(hashed_inputs)
+    }
+
+    /// Evicts least-recently-used blobs until the store is at most `max_bytes`,
+    /// then removes manifests that reference an evicted blob.
+    pub fn gc(&self, max_bytes: u64) -> anyhow::Result<GcStats> {
+        let mut stats = GcStats::default();
+
+        // A blob was last used when the newest manifest referencing it was written or hit
+        let mut manifests: Vec<(Utf8PathBuf, Option<ActionManifest>)> = Vec::new();
+        let mut last_used: HashMap<u64, SystemTime> = HashMap::new();
+        for manifest_path in read_dir_paths(&self.dir.join("ac"))? {
+            let manifest = std::fs::read_to_string(&manifest_path)
+                .ok()
+                .and_then(|s| serde_json::from_str::<ActionManifest>(&s).ok());
+            if let (Some(manifest), Ok(modified)) = (&manifest, std::fs::metadata(&manifest_path)?.modified()) {
+                for output in &manifest.outputs {
+                    let used = last_used.entry(output.hash).or_insert(modified);
+                    *used = (*used).max(modified);
+                }
+            }
+            manifests.push((manifest_path, manifest));
+        }
+
+        // Collect every blob with its size and last use. Blobs no manifest references fall back to
+        // their own mtime, which is when they were produced.
+        let mut blobs: Vec<(SystemTime, u64, Utf8PathBuf)> = Vec::new();
+        for shard in read_dir_paths(&self.dir.join("cas"))? {
+            for blob in read_dir_paths(&shard)? {
+                let meta = std::fs::metadata(&blob)?;
+                if meta.is_file() {
+                    let hash = blob.file_name().and_then(|name| u64::from_str_radix(name, 16).ok());
+                    let used = match hash.and_then(|hash| last_used.get(&hash)) {
+                        Some(used) => *used,
+                        None => meta.modified()?,
+                    };
+                    blobs.push((used, meta.len(), blob));
+                }
+            }
+        }
+
+        let mut total: u64 = blobs.iter().map(|(_, size, _)| size).sum();
+        blobs.sort();
+        for (_, size, blob) in blobs {
+            if total <= max_bytes {
+                break;
+            }
+            std::fs::remove_file(&blob).with_context(|| anyhow_loc!("Failed to evict [{}]", blob))?;
+            total -= size;
+            stats.blobs_removed += 1;
+            stats.bytes_removed += size;
+        }
+        stats.bytes_remaining = total;
+
+        // Drop manifests that can no longer be satisfied
+        for (manifest_path, manifest) in manifests {
+            let complete = manifest.is_some_and(|m| m.outputs.iter().all(|o| self.blob_path(o.hash).exists()));
+            if !complete {
+                std::fs::remove_file(&manifest_path)
+                    .with_context(|| anyhow_loc!("Failed to remove manifest [{}]", manifest_path))?;
+                stats.manifests_removed += 1;
+            }
+        }
+
+        Ok(stats)
+    }
+
+    /// Downloads a manifest missing from the local store and keeps a local copy.
+    fn fetch_manifest(&self, base_key: u64) -> anyhow::Result<Option<String>> {
+        let Some(remote) = &self.remote else {
+            return Ok(None);
+        };
+        let Some(bytes) = remote.get(RemoteKind::ActionCache, base_key)? else {
+            return Ok(None);
+        };
+        let manifest_str = String::from_utf8(bytes).map_err(|_| anyhow_loc!("Remote manifest is not utf-8"))?;
+        util::write_atomic(&self.manifest_path(base_key), manifest_str.as_bytes())?;
+        Ok(Some(manifest_str))
+    }
+
+    /// Downloads a blob missing from the local store. Returns false if the remote doesn't have it.
+    fn fetch_blob(&self, cached: &CachedOutput) -> anyhow::Result<bool> {
+        let Some(remote) = &self.remote else {
+            return Ok(false);
+        };
+        let Some(bytes) = remote.get(RemoteKind::Cas, cached.hash)? else {
+            return Ok(false);
+        };
+
+        // Never let a truncated or corrupt download into the store
+        let mut h = Xxh3::new();
+        h.update(&bytes);
+        if bytes.len() as u64 != cached.size || h.finish() != cached.hash {
+            tracing::warn!("Discarding corrupt remote blob [{:016x}]", cached.hash);
+            return Ok(false);
+        }
+        let blob = self.blob_path(cached.hash);
+        util::write_atomic(&blob, &bytes)?;
+        if cached.executable {
+            set_executable(&blob)?;
+        }
+        Ok(true)
+    }
+
+    fn manifest_path(&self, base_key: u64) -> Utf8PathBuf {
+        self.dir.join("ac").join(format!("{:016x}.json", base_key))
+    }
+
+    fn blob_path(&self, hash: u64) -> Utf8PathBuf {
+        let name = format!("{:016x}", hash);
+        self.dir.join("cas").join(&name[..2]).join(name)
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Public functions
+// ----------------------------------------------------------------------------
+
+/// Returns the xxh3 hash of a file's contents.
+pub fn hash_file(path: &Utf8Path) -> anyhow::Result<u64> {
+    let bytes = std::fs::read(path).with_context(|| anyhow_loc!("Failed to read [{}] for hashing", path))?;
+    let mut h = Xxh3::new();
+    h.update(&bytes);
+    Ok(h.finish())
+}
+
+/// Writes a Makefile-style dependency file listing `inputs`, in the format `parse_dep_file` reads.
+/// Used on a cache hit so the `.d` names this checkout's paths rather than the original builder's.
+pub fn write_dep_file(dep_file: &Utf8Path, target: &Utf8Path, inputs: &[ActionInput]) -> anyhow::Result<()> {
+    let escape = |p: &Utf8Path| p.as_str().replace(' ', "\\ ");
+    let mut content = format!("{}: ", escape(target));
+    for input in inputs {
+        content.push_str(" \\\n  ");
+        content.push_str(&escape(&input.path));
+    }
+    content.push('\n');
+    std::fs::write(dep_file, content).with_context(|| anyhow_loc!("Failed to write [{}]", dep_file))
+}
+
+/// Removes existing outputs before a tool overwrites them.
+/// Outputs may be hardlinks into the shared store, and a tool that writes in place would corrupt it.
+pub fn unlink_outputs(outputs: &[&Utf8Path]) -> anyhow::Result<()> {
+    for output in outputs {
+        match std::fs::remove_file(output) {
+            Ok(()) => (),
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => (),
+            Err(e) => return Err(e).with_context(|| anyhow_loc!("Failed to remove [{}]", output)),
+        }
+    }
+    Ok(())
+}
+
+/// Parses a Makefile-style dependency file (as written by `-MD -MF`) into its input paths.
+///
+/// Format:
+///   target.obj: src.cpp dep1.h \
+///     dep2.h \
+///     dir\ with\ spaces/dep3.h
+pub fn parse_dep_file(dep_file: &Utf8Path) -> anyhow::Result<Vec<Utf8PathBuf>> {
+    let content = std::fs::read_to_string(dep_file)
+        .with_context(|| anyhow_loc!("Failed to read dependency file [{}]", dep_file))?;
+    parse_dep_str(&content)
+}
+
+/// Parses the contents of a Makefile-style dependency file. See `parse_dep_file`.
+pub fn parse_dep_str(content: &str) -> anyhow::Result<Vec<Utf8PathBuf>> {
+    // Join continuation lines
+    let joined = content.replace("\\\r\n", " ").replace("\\\n", " ");
+
+    // Skip the target. Windows paths contain ':' so look for ": " rather than the first ':'
+    let Some(idx) = joined.find(": ") else {
+        if joined.trim().is_empty() {
+            return Ok(Default::default());
+        }
+        bail_loc!("Malformed dependency file, no target separator found");
+    };
+
+    let mut deps = Vec::new();
+    let mut current = String::new();
+    let mut chars = joined[idx + 2..].chars().peekable();
+    while let Some(c) = chars.next() {
+        match c {
+            // Escaped space
+            '\\' if chars.peek() == Some(&' ') => {
+                current.push(' ');
+                chars.next();
+            }
+            c if c.is_whitespace() => {
+                if !current.is_empty() {
+                    deps.push(Utf8PathBuf::from(std::mem::take(&mut current)));
+                }
+            }
+            c => current.push(c),
+        }
+    }
+    if !current.is_empty() {
+        deps.push(Utf8PathBuf::from(current));
+    }
+
+    Ok(deps)
+}
+
+// ----------------------------------------------------------------------------
+// Private functions
+// ----------------------------------------------------------------------------
+
+/// Points `dest` at the same contents as `src`, replacing `dest` if it exists.
+/// Hardlinks when possible so the store and build tree share storage; copies across filesystems.
+fn link_or_copy(src: &Utf8Path, dest: &Utf8Path) -> anyhow::Result<()> {
+    unlink_outputs(&[dest])?;
+    if std::fs::hard_link(src, dest).is_err() {
+        std::fs::copy(src, dest)?;
+    }
+    Ok(())
+}
+
+#[cfg(unix)]
+fn is_executable(meta: &std::fs::Metadata) -> bool {
+    use std::os::unix::fs::PermissionsExt;
+    meta.permissions().mode() & 0o111 != 0
+}
+
+#[cfg(not(unix))]
+fn is_executable(_meta: &std::fs::Metadata) -> bool {
+    false
+}
+
+#[cfg(unix)]
+fn set_executable(path: &Utf8Path) -> anyhow::Result<()> {
+    use std::os::unix::fs::PermissionsExt;
+    std::fs::set_permissions(path, std::fs::Permissions::from_mode(0o755))?;
+    Ok(())
+}
+
+#[cfg(not(unix))]
+fn set_executable(_path: &Utf8Path) -> anyhow::Result<()> {
+    Ok(())
+}
+
+/// Marks a manifest as recently used for LRU eviction. Failure only affects eviction order.
+/// Never call this on a blob: it shares an inode with build outputs in every worktree.
+fn touch(path: &Utf8Path) {
+    if let Ok(file) = std::fs::File::options().write(true).open(path) {
+        let _ = file.set_modified(SystemTime::now());
+    }
+}
+
+/// Lists a directory, treating a missing directory as empty.
+fn read_dir_paths(dir: &Utf8Path) -> anyhow::Result<Vec<Utf8PathBuf>> {
+    let entries = match dir.read_dir_utf8() {
+        Ok(entries) => entries,
+        Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(Vec::new()),
+        Err(e) => return Err(e).with_context(|| anyhow_loc!("Failed to read [{}]", dir)),
+    };
+    let mut paths = Vec::new();
+    for entry in entries {
+        paths.push(entry?.path().to_owned());
+    }
+    Ok(paths)
+}
@@ -0,0 +1,248 @@
+//! Tests for action_cache.rs
+
+use camino::{Utf8Path, Utf8PathBuf};
+use std::time::{Duration, SystemTime};
+
+use crate::action_cache::*;
+use crate::{assert_err, assert_ok};
+use crate::test_utils::scratch_dir;
+
+#[test]
+fn parse_dep_str_basic() {
+    let deps = parse_dep_str("foo.obj: /src/foo.cpp /src/foo.h \\\n  /src/bar.h \\\n  /src/baz.h\n").unwrap();
+    assert_eq!(deps, vec!["/src/foo.cpp", "/src/foo.h", "/src/bar.h", "/src/baz.h"]);
+}
+
+#[test]
+fn parse_dep_str_windows_paths() {
+    let deps = parse_dep_str("C:/out/foo.obj: C:/src/foo.cpp \\\r\n  C:/src/foo.h\r\n").unwrap();
+    assert_eq!(deps, vec!["C:/src/foo.cpp", "C:/src/foo.h"]);
+}
+
+#[test]
+fn parse_dep_str_escaped_spaces() {
+    let deps = parse_dep_str("foo.obj: /my\\ src/foo.cpp /inc/a.h\n").unwrap();
+    assert_eq!(deps, vec!["/my src/foo.cpp", "/inc/a.h"]);
+}
+
+#[test]
+fn parse_dep_str_empty_and_malformed() {
+    assert_eq!(parse_dep_str("").unwrap(), Vec::<Utf8PathBuf>::new());
+    assert_err!(parse_dep_str("not a dep file"));
+}
+
+#[test]
+fn action_cache_roundtrip() {
+    let dir = scratch_dir("action_cache_tests", "roundtrip");
+    let cache = ActionCache::new(dir.join("cache"));
+
+    let src = dir.join("foo.cpp");
+    let header = dir.join("foo.h");
+    let obj = dir.join("out/foo.obj");
+    std::fs::write(&src, "int foo() { return 1; }").unwrap();
+    std::fs::write(&header, "int foo();").unwrap();
+    std::fs::create_dir_all(obj.parent().unwrap()).unwrap();
+    std::fs::write(&obj, "object bytes").unwrap();
+
+    // Miss before anything was stored
+    assert!(cache.lookup(42, &[&obj]).unwrap().is_none());
+
+    assert_ok!(cache.store(42, &[src.clone(), header.clone()], &[&obj]));
+
+    // Hit restores the output
+    std::fs::remove_file(&obj).unwrap();
+    let inputs = cache.lookup(42, &[&obj]).unwrap().unwrap();
+    assert_eq!(inputs.len(), 2);
+    assert_eq!(inputs[0].path, src);
+    assert_eq!(inputs[0].hash, hash_file(&src).unwrap());
+    assert_eq!(std::fs::read_to_string(&obj).unwrap(), "object bytes");
+
+    // Different base key is a miss
+    assert!(cache.lookup(43, &[&obj]).unwrap().is_none());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn action_cache_header_change_misses() {
+    let dir = scratch_dir("action_cache_tests", "header_change");
+    let cache = ActionCache::new(dir.join("cache"));
+
+    let header = dir.join("foo.h");
+    let obj = dir.join("foo.obj");
+    std::fs::write(&header, "int foo();").unwrap();
+    std::fs::write(&obj, "object bytes").unwrap();
+    assert_ok!(cache.store(7, &[header.clone()], &[&obj]));
+    assert!(cache.lookup(7, &[&obj]).unwrap().is_some());
+
+    // Editing a recorded input invalidates the entry
+    std::fs::write(&header, "int foo(int);").unwrap();
+    assert!(cache.lookup(7, &[&obj]).unwrap().is_none());
+
+    // Deleting a recorded input invalidates the entry
+    std::fs::remove_file(&header).unwrap();
+    assert!(cache.lookup(7, &[&obj]).unwrap().is_none());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn action_cache_tool_hash_is_content_based() {
+    let dir = scratch_dir("action_cache_tests", "tool_hash");
+    let cache = ActionCache::new(dir.join("cache"));
+
+    let a = dir.join("clang_a");
+    let b = dir.join("clang_b");
+    std::fs::write(&a, "same binary").unwrap();
+    std::fs::write(&b, "same binary").unwrap();
+    assert_eq!(cache.tool_hash(&a).unwrap(), cache.tool_hash(&b).unwrap());
+    assert_err!(cache.tool_hash(Utf8Path::new("/does/not/exist/clang")));
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn action_cache_outputs_are_shared_between_build_trees() {
+    let dir = scratch_dir("action_cache_tests", "shared");
+    let cache = ActionCache::new(dir.join("cache"));
+
+    // Two worktrees producing the same object
+    let obj_a = dir.join("worktree_a/foo.obj");
+    let obj_b = dir.join("worktree_b/foo.obj");
+    std::fs::create_dir_all(obj_a.parent().unwrap()).unwrap();
+    std::fs::write(&obj_a, "object bytes").unwrap();
+    assert_ok!(cache.store(42, &[], &[&obj_a]));
+
+    // The second tree restores from the store without the first tree's file
+    std::fs::remove_file(&obj_a).unwrap();
+    assert!(cache.lookup(42, &[&obj_b]).unwrap().is_some());
+    assert_eq!(std::fs::read_to_string(&obj_b).unwrap(), "object bytes");
+
+    // Identical contents from a different action share a single blob
+    std::fs::write(&obj_a, "object bytes").unwrap();
+    assert_ok!(cache.store(43, &[], &[&obj_a]));
+    let stats = cache.gc(u64::MAX).unwrap();
+    assert_eq!(stats.bytes_remaining, "object bytes".len() as u64);
+
+    // Unlinking an output leaves the store intact
+    assert_ok!(unlink_outputs(&[&obj_b, &dir.join("never_existed.obj")]));
+    assert!(cache.lookup(42, &[&obj_b]).unwrap().is_some());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn action_cache_gc_evicts_least_recently_used() {
+    let dir = scratch_dir("action_cache_tests", "gc");
+    let cache = ActionCache::new(dir.join("cache"));
+
+    let old = dir.join("old/foo.obj");
+    let new = dir.join("new/foo.obj");
+    std::fs::create_dir_all(old.parent().unwrap()).unwrap();
+    std::fs::create_dir_all(new.parent().unwrap()).unwrap();
+    std::fs::write(&old, "old object").unwrap();
+    std::fs::write(&new, "new object").unwrap();
+    assert_ok!(cache.store(1, &[], &[&old]));
+    assert_ok!(cache.store(2, &[], &[&new]));
+
+    // Recency is tracked on manifests
+    let manifest = dir.join("cache/ac").join(format!("{:016x}.json", 1));
+    let file = std::fs::File::options().write(true).open(&manifest).unwrap();
+    file.set_modified(SystemTime::now() - Duration::from_secs(3600)).unwrap();
+
+    // Under the limit nothing is evicted
+    let stats = cache.gc(1024).unwrap();
+    assert_eq!(stats.blobs_removed, 0);
+    assert_eq!(stats.manifests_removed, 0);
+
+    // Over the limit the oldest blob and its manifest go first
+    let stats = cache.gc("new object".len() as u64).unwrap();
+    assert_eq!(stats.blobs_removed, 1);
+    assert_eq!(stats.manifests_removed, 1);
+    assert!(cache.lookup(1, &[&old]).unwrap().is_none());
+    assert!(cache.lookup(2, &[&new]).unwrap().is_some());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn action_cache_hits_leave_shared_outputs_untouched() {
+    let dir = scratch_dir("action_cache_tests", "hit_mtime");
+    let cache = ActionCache::new(dir.join("cache"));
+
+    let obj_a = dir.join("worktree_a/foo.obj");
+    let obj_b = dir.join("worktree_b/foo.obj");
+    std::fs::create_dir_all(obj_a.parent().unwrap()).unwrap();
+    std::fs::write(&obj_a, "object bytes").unwrap();
+    let backdated = SystemTime::now() - Duration::from_secs(3600);
+    std::fs::File::options().write(true).open(&obj_a).unwrap().set_modified(backdated).unwrap();
+    assert_ok!(cache.store(7, &[], &[&obj_a]));
+
+    // Another worktree hitting the same blob must not change the first worktree's stamp
+    assert!(cache.lookup(7, &[&obj_b]).unwrap().is_some());
+    assert_eq!(std::fs::metadata(&obj_a).unwrap().modified().unwrap(), backdated);
+
+    // The hit still counts as a use, so the blob outlives an older unreferenced one
+    let manifest = dir.join("cache/ac").join(format!("{:016x}.json", 7));
+    assert!(std::fs::metadata(&manifest).unwrap().modified().unwrap() > backdated);
+    let other = dir.join("worktree_a/other.obj");
+    std::fs::write(&other, "older object").unwrap();
+    std::fs::File::options().write(true).open(&other).unwrap().set_modified(backdated).unwrap();
+    assert_ok!(cache.store(8, &[], &[&other]));
+    std::fs::remove_file(dir.join("cache/ac").join(format!("{:016x}.json", 8))).unwrap();
+    let stats = cache.gc("object bytes".len() as u64).unwrap();
+    assert_eq!(stats.blobs_removed, 1);
+    assert!(cache.lookup(7, &[&obj_b]).unwrap().is_some());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn action_cache_manifests_are_root_relative() {
+    let dir = scratch_dir("action_cache_tests", "root_relative");
+
+    // Identical sources in two checkouts
+    for checkout in ["checkout_a", "checkout_b"] {
+        std::fs::create_dir_all(dir.join(checkout).join("src")).unwrap();
+        std::fs::write(dir.join(checkout).join("src/foo.h"), "int foo();").unwrap();
+        std::fs::write(dir.join(checkout).join("foo.obj"), "object bytes").unwrap();
+    }
+
+    let mut cache_a = ActionCache::new(dir.join("cache"));
+    cache_a.set_root(dir.join("checkout_a"));
+    let stored = cache_a
+        .store(42, &[dir.join("checkout_a/src/foo.h")], &[&dir.join("checkout_a/foo.obj")])
+        .unwrap();
+    assert_eq!(stored[0].path, dir.join("checkout_a/src/foo.h"));
+
+    // The second checkout resolves the recorded header against its own root
+    let mut cache_b = ActionCache::new(dir.join("cache"));
+    cache_b.set_root(dir.join("checkout_b"));
+    let obj_b = dir.join("checkout_b/foo.obj");
+    let inputs = cache_b.lookup(42, &[&obj_b]).unwrap().unwrap();
+    assert_eq!(inputs[0].path, dir.join("checkout_b/src/foo.h"));
+
+    // Editing the header in checkout_b only misses there
+    std::fs::write(dir.join("checkout_b/src/foo.h"), "int bar();").unwrap();
+    assert!(cache_b.lookup(42, &[&obj_b]).unwrap().is_none());
+    assert!(cache_a.lookup(42, &[&dir.join("checkout_a/foo.obj")]).unwrap().is_some());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn write_dep_file_roundtrips_through_parser() {
+    let dir = scratch_dir("action_cache_tests", "write_dep_file");
+    let dep_file = dir.join("foo.d");
+    let inputs = vec![
+        ActionInput { path: "/src/foo.cpp".into(), hash: 1 },
+        ActionInput { path: "/my src/foo.h".into(), hash: 2 },
+    ];
+    assert_ok!(write_dep_file(&dep_file, Utf8Path::new("/out/foo.obj"), &inputs));
+    assert_eq!(parse_dep_file(&dep_file).unwrap(), vec!["/src/foo.cpp", "/my src/foo.h"]);
+
+    assert_ok!(write_dep_file(&dep_file, Utf8Path::new("/out/foo.obj"), &[]));
+    assert_eq!(parse_dep_file(&dep_file).unwrap(), Vec::<Utf8PathBuf>::new());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
@@ -1,8 +1,14 @@
+use crate::action_cache::ActionCache;
+use crate::build_journal::BuildJournal;
+use crate::build_snapshot::{self, BuildSnapshot, BuildSnapshots, SnapshotFile};
+use crate::glob_cache::GlobCache;
+use crate::job_history::JobHistory;
 use crate::job_system;
 use crate::job_system::*;
 use crate::papyrus;
 use crate::papyrus::resolve_value_with_dir;
 use crate::papyrus::*;
+use crate::papyrus_snapshot::PapyrusSnapshots;
 use crate::rules;
 use crate::rules::*;
 use crate::toolchain;
@@ -20,9 +26,11 @@ use heck::ToLowerCamelCase;
 use serde::{Deserialize, Deserializer, Serialize, Serializer};
 use std::any;
 use std::any::Any;
-use std::collections::HashMap;
+use std::collections::{BTreeMap, HashMap};
 use std::path::{Path, PathBuf};
+use std::hash::Hash;
 use std::sync::Arc;
+use std::sync::OnceLock;
 use std::sync::RwLock;
 
 // utility for an Arc<Mutex<HashMap<K,V>>>
@@ -41,27 +49,48 @@ pub struct Anubis {
     /// When true, external tools (e.g., clang) will be invoked with verbose flags (e.g., -v)
     pub verbose_tools: bool,
 
+    /// Memory the job system may commit to running jobs. `None` disables memory-aware admission.
+    pub memory_budget: Option<u64>,
+
+    /// Keep building everything that doesn't depend on a failed job, then report every failure.
+    pub keep_going: bool,
+
     // environment caches
     pub dir_exists_cache: DashMap<Utf8PathBuf, bool>,
+    pub glob_cache: GlobCache,
 
     // papyrus caches
-    pub raw_config_cache: SharedHashMap<AnubisConfigRelPath, ArcResult<papyrus::Value>>,
-    pub resolved_config_cache: SharedHashMap<ResolvedConfigCacheKey, ArcResult<papyrus::Value>>,
+    pub papyrus_snapshots: PapyrusSnapshots,
+    pub raw_config_cache: OnceMap<AnubisConfigRelPath, papyrus::Value>,
+    pub resolved_object_cache: OnceMap<ResolvedObjectCacheKey, papyrus::Value>,
     
     // data caches
-    pub mode_cache: SharedHashMap<AnubisTarget, ArcResult<Mode>>,
-    pub toolchain_cache: SharedHashMap<ToolchainCacheKey, ArcResult<Toolchain>>,
+    pub mode_cache: OnceMap<AnubisTarget, Mode>,
+    pub toolchain_cache: OnceMap<ToolchainCacheKey, Toolchain>,
     pub rule_typeinfos: SharedHashMap<RuleTypename, RuleTypeInfo>,
-    pub rule_cache: SharedHashMap<AnubisTarget, ArcResult<dyn Rule>>,
+    pub rule_cache: OnceMap<AnubisTarget, dyn Rule>,
 
     // job execution caches    
     pub job_cache: SharedHashMap<JobCacheKey, JobId>,
     pub rule_job_cache: DashMap<RuleJobCacheKey, JobId>,
+
+    // persistent caches
+    pub action_cache: ActionCache,
+    pub build_journal: BuildJournal,
+    pub build_snapshots: BuildSnapshots,
+    pub job_history: Arc<JobHistory>,
+}
+
+/// Concurrent cache that computes each entry exactly once. A thread asking for an entry that
+/// another thread is computing waits for that result instead of computing its own.
+#[derive(Debug)]
+pub struct OnceMap<K: Eq + Hash, T: ?Sized> {
+    entries: DashMap<K, Arc<OnceLock<ArcResult<T>>>>,
 }
 
 #[derive(Clone, Debug, Default, Eq, Hash, PartialEq)]
 pub struct AnubisTarget {
-    full_path: String,    // ex: //path/to/foo:bar
+    full_path: Arc<str>,  // ex: //path/to/foo:bar. Shared, so clones don't allocate
     separator_idx: usize, // index of ':'
 }
 
@@ -94,12 +123,13 @@ pub struct ToolchainCacheKey {
     pub toolchain: AnubisTarget,
 }
 
-/// Cache key for resolved config caching.
-/// Configs are resolved with mode-specific variables (via select() statements),
-/// so the same config file can produce different results for different modes.
+/// Cache key for resolved object caching.
+/// Objects are resolved with mode-specific variables (via select() statements),
+/// so the same target can produce different results for different modes.
 #[derive(Clone, Debug, Eq, Hash, PartialEq)]
-pub struct ResolvedConfigCacheKey {
-    pub config_path: AnubisConfigRelPath,
+pub struct ResolvedObjectCacheKey {
+    /// The object's config file and name, e.g. //path/to/foo:bar for object bar in //path/to/foo/ANUBIS.
+    pub target: AnubisTarget,
     pub mode: AnubisTarget,
 }
 
@@ -122,9 +152,51 @@ pub struct RuleJobCacheKey {
 // ----------------------------------------------------------------------------
 // implementations
 // ----------------------------------------------------------------------------
+impl<K: Eq + Hash, T: ?Sized> Default for OnceMap<K, T> {
+    fn default() -> Self {
+        OnceMap {
+            entries: Default::default(),
+        }
+    }
+}
+
+impl<K: Clone + Eq + Hash, T: ?Sized> OnceMap<K, T> {
+    /// Returns the entry for `key`, running `init` to compute it if no thread has yet.
+    /// `init` must not ask this map for the same key.
+    pub fn get_or_init(&self, key: &K, init: impl FnOnce() -> ArcResult<T>) -> ArcResult<T> {
+        // Clone the cell out so the map isn't locked while `init` runs
+        let cell = match self.entries.get(key) {
+            Some(cell) => cell.clone(),
+            None => self.entries.entry(key.clone()).or_default().clone(),
+        };
+        cell.get_or_init(init).clone()
+    }
+
+    /// Keys of every entry that has been computed.
+    pub fn keys(&self) -> Vec<K> {
+        self.entries.iter().filter(|cell| cell.get().is_some()).map(|cell| cell.key().clone()).collect()
+    }
+
+    /// True if the entry for `key` has been computed.
+    pub fn contains(&self, key: &K) -> bool {
+        self.entries.get(key).is_some_and(|cell| cell.get().is_some())
+    }
+
+    /// Number of entries that have been computed.
+    pub fn len(&self) -> usize {
+        self.entries.iter().filter(|cell| cell.get().is_some()).count()
+    }
+}
+
 impl Anubis {
-    pub fn new(root: Utf8PathBuf, verbose_tools: bool) -> anyhow::Result<Anubis> {
+    /// `cache_dir` is the action cache directory, normally `util::get_global_cache_dir()`.
+    pub fn new(root: Utf8PathBuf, cache_dir: Utf8PathBuf, verbose_tools: bool) -> anyhow::Result<Anubis> {
         let mut anubis = Anubis {
+            action_cache: ActionCache::new(cache_dir),
+            build_journal: BuildJournal::new(root.join(".anubis-build").join(".journal")),
+            build_snapshots: BuildSnapshots::new(root.join(".anubis-build").join(".graph")),
+            job_history: Arc::new(JobHistory::new(root.join(".anubis-build").join(".job_history"))),
+            papyrus_snapshots: PapyrusSnapshots::new(root.join(".anubis-build").join(".papyrus")),
             root,
             verbose_tools,
             ..Default::default()
@@ -191,7 +263,7 @@ impl AnubisTarget {
         if parts[0].is_empty() {
             // If first part is empty this is a rel-path
             Ok(AnubisTarget {
-                full_path: input.to_owned(),
+                full_path: input.into(),
                 separator_idx: 0,
             })
         } else {
@@ -205,7 +277,7 @@ impl AnubisTarget {
             }
 
             Ok(AnubisTarget {
-                full_path: input.to_owned().replace("\\", "/"),
+                full_path: input.replace("\\", "/").into(),
                 separator_idx: parts[0].len(),
             })
         }
@@ -234,7 +306,7 @@ impl AnubisTarget {
         let separator_idx = dir_relpath.len() + 2; // +2 for "//"
 
         AnubisTarget {
-            full_path,
+            full_path: full_path.into(),
             separator_idx,
         }
     }
@@ -414,11 +486,10 @@ fn arcify<T>(v: anyhow::Result<T>) -> anyhow::Result<Arc<T>> {
 
 impl Anubis {
     pub fn get_mode(&self, mode_target: &AnubisTarget) -> anyhow::Result<Arc<Mode>> {
-        // check if mode already exists
-        if let Some(mode) = read_lock(&self.mode_cache)?.get(mode_target) {
-            return mode.clone();
-        }
+        self.mode_cache.get_or_init(mode_target, || self.load_mode(mode_target))
+    }
 
+    fn load_mode(&self, mode_target: &AnubisTarget) -> anyhow::Result<Arc<Mode>> {
         // get raw config
         let config_path = mode_target.get_config_relpath();
         let config = self.get_raw_config(&config_path)?;
@@ -446,10 +517,7 @@ impl Anubis {
             m.vars.insert("host_arch".into(), host_arch.into());
         }
 
-        // Arcify and store mode
-        let mode: ArcResult<Mode> = mode.arcify();
-        write_lock(&self.mode_cache)?.insert(mode_target.clone(), mode.clone());
-        mode
+        mode.arcify()
     }
 
     pub fn get_toolchain(
@@ -457,118 +525,101 @@ impl Anubis {
         mode: Arc<Mode>,
         toolchain_target: &AnubisTarget,
     ) -> anyhow::Result<Arc<Toolchain>> {
-        // Check if toolchain already exists
         let key = ToolchainCacheKey {
             mode: mode.target.clone(),
             toolchain: toolchain_target.clone(),
         };
-        if let Some(toolchain) = read_lock(&self.toolchain_cache)?.get(&key) {
-            return toolchain.clone();
-        }
+        self.toolchain_cache.get_or_init(&key, || self.load_toolchain(&mode, toolchain_target))
+    }
 
+    fn load_toolchain(&self, mode: &Mode, toolchain_target: &AnubisTarget) -> anyhow::Result<Arc<Toolchain>> {
         let mut toolchain = (|| {
-            // get config
-            let config = self.get_resolved_config(&toolchain_target.get_config_relpath(), &*mode)?;
+            // get resolved toolchain object
+            let object = self.get_resolved_object(toolchain_target, mode)?;
 
             // deserialize toolchain
-            config.deserialize_named_object::<Toolchain>(toolchain_target.target_name())
+            object.deserialize_object::<Toolchain>(toolchain_target.target_name())
         })();
 
         // inject target into toolchain
         if let Ok(t) = &mut toolchain {
             t.target = toolchain_target.clone();
         }
-        let toolchain = toolchain.arcify();
-
-        // store Toolchain
-        write_lock(&self.toolchain_cache)?.insert(key, toolchain.clone());
-        toolchain
+        toolchain.arcify()
     }
 
     fn get_raw_config(&self, config_path: &AnubisConfigRelPath) -> ArcResult<papyrus::Value> {
-        let paps = read_lock(&self.raw_config_cache)?;
-        let maybe_papyrus = paps.get(config_path);
-        match maybe_papyrus {
-            Some(Ok(papyrus)) => Ok(papyrus.clone()),
-            Some(Err(e)) => {
-                bail_loc!(
-                    "Can't get mode [{}] because papyrus parse failed with [{}]",
-                    config_path.0,
-                    e
-                )
-            }
-            None => {
-                // drop read lock
-                drop(paps);
-
+        self.raw_config_cache
+            .get_or_init(config_path, || {
                 // parse papyrus file
                 let filepath = config_path.get_abspath(&self.root);
-                let result = papyrus::read_papyrus_file(filepath.as_ref()).map(|v| Arc::new(v));
-
-                // acquire write lock and store
-                write_lock(&self.raw_config_cache)?.insert(config_path.clone(), result.clone());
-                result
-            }
-        }
+                self.papyrus_snapshots.read_papyrus_file(&filepath).map(|v| Arc::new(v))
+            })
+            .map_err(|e| {
+                anyhow_loc!("Can't read config [{}] because papyrus parse failed with [{}]", config_path.0, e)
+            })
     }
 
-    pub fn get_resolved_config(
-        &self,
-        config_relpath: &AnubisConfigRelPath,
-        mode: &Mode,
-    ) -> ArcResult<papyrus::Value> {
-        // Create cache key that includes both config path and mode
-        let cache_key = ResolvedConfigCacheKey {
-            config_path: config_relpath.clone(),
+    /// Resolves one named object of an ANUBIS file for a mode. Only that object's globs and
+    /// selects are evaluated, so building one target doesn't pay for every other target in the file.
+    pub fn get_resolved_object(&self, target: &AnubisTarget, mode: &Mode) -> ArcResult<papyrus::Value> {
+        // Create cache key that includes both target and mode
+        let cache_key = ResolvedObjectCacheKey {
+            target: target.clone(),
             mode: mode.target.clone(),
         };
 
-        // check if resolved config already exists
-        if let Some(config) = read_lock(&self.resolved_config_cache)?.get(&cache_key) {
-            return config.clone();
-        }
+        self.resolved_object_cache.get_or_init(&cache_key, || self.resolve_object(target, mode))
+    }
 
-        // get raw config
-        let raw_config = self.get_raw_config(config_relpath)?;
-        let config_abspath = config_relpath.get_abspath(&self.root);
-        let config_dir = config_abspath.parent().unwrap();
-
-        // Extract the directory relative path for resolving relative targets
-        // config_relpath is like "//path/to/dir/ANUBIS", we want "path/to/dir"
-        let dir_relpath = config_relpath.get_dir_relpath();
-
-        let resolved_config = match resolve_value_with_dir(
-            (*raw_config).clone(),
-            config_dir.as_std_path(),
-            &mode.vars,
-            Some(&dir_relpath),
-        ) {
-            Ok(v) => Ok::<papyrus::Value, anyhow::Error>(v),
-            Err(e) => {
-                let e_str = e.to_string();
-                bail_loc!("Error resolving config [{:?}]: {}", config_relpath.0, e_str)
+    fn resolve_object(&self, target: &AnubisTarget, mode: &Mode) -> ArcResult<papyrus::Value> {
+        let resolved_object = (|| -> anyhow::Result<papyrus::Value> {
+            // get raw object
+            let config_relpath = target.get_config_relpath();
+            let raw_config = self.get_raw_config(&config_relpath)?;
+            let raw_object = raw_config.get_named_object(target.target_name())?;
+            let config_abspath = config_relpath.get_abspath(&self.root);
+            let config_dir = config_abspath.parent().unwrap();
+
+            // Extract the directory relative path for resolving relative targets
+            // config_relpath is like "//path/to/dir/ANUBIS", we want "path/to/dir"
+            let dir_relpath = config_relpath.get_dir_relpath();
+
+            // Expand the globs this mode reaches in parallel, so resolution finds them cached
+            let mut globs = Vec::new();
+            papyrus::collect_globs(raw_object, &mode.vars, &mut globs);
+            if globs.len() > 1 {
+                let globs: Vec<_> = globs.into_iter().map(|glob| (config_dir, glob)).collect();
+                self.glob_cache.expand_all(&globs);
             }
-        }?;
-
-        // Store the resolved config in cache
-        let arc_resolved = Arc::new(resolved_config);
-        write_lock(&self.resolved_config_cache)?.insert(cache_key, Ok(arc_resolved.clone()));
 
-        Ok(arc_resolved)
+            let resolved = resolve_value_with_dir(
+                raw_object,
+                config_dir.as_std_path(),
+                &mode.vars,
+                Some(&dir_relpath),
+                &self.glob_cache,
+            )
+            .map_err(|e| {
+                anyhow_loc!("Error resolving target [{}] in config [{:?}]: {}", target, config_relpath.0, e)
+            })?;
+            if let Some(info) = resolved.as_unresolved() {
+                bail_loc!("Target [{}] is unresolved for mode [{}]: {}", target, mode.target, info.reason);
+            }
+            Ok(resolved)
+        })()
+        .arcify();
+        resolved_object
     }
 
     pub fn get_rule(&self, rule: &AnubisTarget, mode: &Mode) -> ArcResult<dyn Rule> {
-        // check cache
-        if let Some(rule) = read_lock(&self.rule_cache)?.get(rule) {
-            return rule.clone();
-        }
+        self.rule_cache.get_or_init(rule, || self.load_rule(rule, mode))
+    }
 
+    fn load_rule(&self, rule: &AnubisTarget, mode: &Mode) -> ArcResult<dyn Rule> {
         let new_rule = (|| {
-            // get resolved config
-            let config = self.get_resolved_config(&rule.get_config_relpath(), mode)?;
-
-            // get rule object
-            let papyrus = config.get_named_object(rule.target_name())?;
+            // get resolved rule object
+            let papyrus = &*self.get_resolved_object(rule, mode)?;
             let rule_typename = match papyrus {
                 Value::Object(obj) => RuleTypename(obj.typename.clone()),
                 _ => bail_loc!("Rule [{}] ", rule),
@@ -582,12 +633,42 @@ impl Anubis {
             (rti.parse_rule)(rule.clone(), papyrus)
         })();
 
-        // store rule in cache
-        write_lock(&self.rule_cache)?.insert(rule.clone(), new_rule.clone());
-
         new_rule
     }
 
+    /// Describes what this session's build depended on, for `build_targets_unless_up_to_date`.
+    pub fn build_snapshot(&self) -> anyhow::Result<BuildSnapshot> {
+        let mut configs = Vec::new();
+        for config_path in self.raw_config_cache.keys() {
+            configs.push(SnapshotFile::new(config_path.get_abspath(&self.root))?);
+        }
+
+        let mut patterns = Vec::new();
+        for key in self.resolved_object_cache.keys() {
+            let config_relpath = key.target.get_config_relpath();
+            let raw_config = self.get_raw_config(&config_relpath)?;
+            let raw_object = raw_config.get_named_object(key.target.target_name())?;
+            let config_dir = config_relpath.get_abspath(&self.root).parent().unwrap().to_owned();
+            build_snapshot::collect_glob_patterns(&raw_object, &config_dir, &mut patterns);
+        }
+        patterns.sort_unstable();
+        patterns.dedup();
+        let globs = patterns
+            .into_iter()
+            .map(|pattern| {
+                let hash = build_snapshot::hash_glob(&pattern);
+                (pattern, hash)
+            })
+            .collect();
+
+        Ok(BuildSnapshot {
+            executable: build_snapshot::current_executable_stamp(),
+            configs,
+            globs,
+            outputs: self.build_journal.checked_outputs(),
+        })
+    }
+
     /// Build a rule target, using the rule-level job cache to prevent duplicate jobs.
     ///
     /// This method checks if a job for the given (mode, target) combination already exists.
@@ -741,7 +822,12 @@ pub fn build_targets(
     let toolchain = anubis.get_toolchain(mode.clone(), toolchain_path)?;
 
     // Create a SINGLE job system shared across ALL targets
-    let job_system: Arc<JobSystem> = Arc::new(JobSystem::new());
+    let job_system: Arc<JobSystem> = Arc::new(
+        JobSystem::with_history(anubis.job_history.clone())
+            .with_tokens(crate::job_tokens::get())
+            .with_memory_budget(anubis.memory_budget)
+            .with_keep_going(anubis.keep_going),
+    );
     let job_context = Arc::new(JobContext {
         anubis,
         job_system: job_system.clone(),
@@ -773,7 +859,20 @@ pub fn build_targets(
         counter: job_system.next_id.clone(),
     });
 
-    JobSystem::run_to_completion(job_system.clone(), num_workers, progress_tx)?;
+    let build_result = JobSystem::run_to_completion(job_system.clone(), num_workers, progress_tx);
+
+    // Persist up-to-date information even if the build failed so finished objects are not rebuilt
+    if let Err(e) = job_context.anubis.build_journal.save() {
+        tracing::warn!("Failed to save build journal: {}", e);
+    }
+    if let Err(e) = job_context.anubis.job_history.save() {
+        tracing::warn!("Failed to save job history: {}", e);
+    }
+    job_context.anubis.action_cache.flush_uploads();
+    if build_result.is_err() {
+        report_failures(&job_context.anubis, mode_target, &job_system);
+    }
+    build_result?;
 
     // Log completion and collect artifacts for all targets
     let mut artifacts = Vec::with_capacity(target_paths.len());
@@ -790,6 +889,86 @@ pub fn build_targets(
     Ok(artifacts)
 }
 
+/// Builds `target_paths` like `build_targets`, but skips the build when the last identical build
+/// started no tools and nothing it depended on has changed since.
+pub fn build_targets_unless_up_to_date(
+    anubis: Arc<Anubis>,
+    mode_target: &AnubisTarget,
+    toolchain_path: &AnubisTarget,
+    target_paths: &[AnubisTarget],
+    num_workers: usize,
+    progress_tx: crossbeam::channel::Sender<crate::progress::ProgressEvent>,
+) -> anyhow::Result<()> {
+    let key = build_snapshot::snapshot_key(mode_target, toolchain_path, target_paths, anubis.verbose_tools);
+    if let Some(snapshot) = anubis.build_snapshots.load(key) {
+        match snapshot.invalidation(&anubis.build_journal) {
+            None => {
+                tracing::info!("All {} target(s) up to date", target_paths.len());
+                // Keep any mtimes the journal refreshed while validating
+                anubis.build_journal.save()?;
+                return Ok(());
+            }
+            Some(reason) => tracing::debug!("Not using build snapshot: {}", reason),
+        }
+    }
+
+    let tools_started = crate::process_reactor::spawned();
+    build_targets(anubis.clone(), mode_target, toolchain_path, target_paths, num_workers, progress_tx)?;
+
+    if crate::process_reactor::spawned() != tools_started {
+        anubis.build_snapshots.remove(key);
+        return Ok(());
+    }
+    match anubis.build_snapshot().and_then(|snapshot| anubis.build_snapshots.save(key, &snapshot)) {
+        Ok(()) => tracing::debug!("Saved build snapshot [{:016x}]", key),
+        Err(e) => tracing::warn!("Failed to save build snapshot: {}", e),
+    }
+    Ok(())
+}
+
+/// Logs every job that failed during a build, grouped by the target whose rule spawned it.
+fn report_failures(anubis: &Anubis, mode_target: &AnubisTarget, job_system: &JobSystem) {
+    let failures = job_system.failures();
+    if failures.is_empty() {
+        return;
+    }
+
+    // Compile and link jobs belong to the nearest rule job up their spawner chain
+    let rule_jobs: HashMap<JobId, AnubisTarget> = anubis
+        .rule_job_cache
+        .iter()
+        .filter(|entry| &entry.key().mode == mode_target)
+        .map(|entry| (*entry.value(), entry.key().target.clone()))
+        .collect();
+    let owning_target = |mut job_id: JobId| loop {
+        if let Some(target) = rule_jobs.get(&job_id) {
+            return target.target_path().to_string();
+        }
+        match job_system.spawner(job_id) {
+            Some(spawner) => job_id = spawner,
+            None => return "(no target)".to_owned(),
+        }
+    };
+
+    let mut by_target: BTreeMap<String, Vec<&JobFailure>> = Default::default();
+    for failure in &failures {
+        by_target.entry(owning_target(failure.job_id)).or_default().push(failure);
+    }
+
+    tracing::error!(
+        "[{}] jobs failed in [{}] targets; [{}] jobs were skipped because a dep failed",
+        failures.len(),
+        by_target.len(),
+        job_system.num_skipped()
+    );
+    for (target, failures) in &by_target {
+        tracing::error!("  {}", target);
+        for failure in failures {
+            tracing::error!("    {} {}: {}", failure.display.verb, failure.display.short_name, failure.error);
+        }
+    }
+}
+
 /// Represents a target pattern that can match multiple targets.
 /// For example, "//samples/basic/..." matches all targets under the samples/basic directory.
 #[derive(Clone, Debug)]
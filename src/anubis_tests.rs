@@ -3,7 +3,10 @@
 use camino::Utf8PathBuf;
 
 use crate::anubis::*;
+use crate::papyrus::Value;
+use crate::toolchain::Mode;
 use crate::{assert_err, assert_ok};
+use crate::test_utils::scratch_dir;
 
 #[test]
 fn anubis_target_invalid() {
@@ -132,3 +135,177 @@ fn target_pattern_parse() {
     assert!(TargetPattern::parse("examples/...").is_none());
     assert!(TargetPattern::parse("//...").is_none()); // Invalid root syntax - must use ///...
 }
+
+#[test]
+fn resolved_object_only_resolves_requested_target() -> anyhow::Result<()> {
+    let root = scratch_dir("anubis_tests", "resolved_object");
+    std::fs::create_dir_all(root.join("pkg"))?;
+    std::fs::write(root.join("pkg/main.c"), "")?;
+    std::fs::write(
+        root.join("pkg/ANUBIS"),
+        r#"
+        test_rule(
+            name = "good",
+            srcs = glob(["*.c"]),
+            deps = Targets([":other"]),
+        )
+        test_rule(
+            name = "broken",
+            srcs = glob(["missing/*.c"]),
+        )
+        test_rule(
+            name = "windows_only",
+            value = select(
+                (platform) => {
+                    (windows) = "win_value"
+                }
+            ),
+        )
+        "#,
+    )?;
+
+    let anubis = Anubis {
+        root: root.clone(),
+        ..Default::default()
+    };
+    let mode = |platform: &str| Mode {
+        name: platform.to_owned(),
+        vars: [("platform".to_owned(), platform.to_owned())].into(),
+        target: AnubisTarget::new(&format!("//mode:{}", platform)).unwrap(),
+    };
+    let linux = mode("linux");
+
+    // The broken glob in a sibling target doesn't stop "good" from resolving
+    let good = AnubisTarget::new("//pkg:good")?;
+    let resolved = anubis.get_resolved_object(&good, &linux)?;
+    assert_eq!(resolved.get_key("srcs")?, &Value::Paths(vec![root.join("pkg/main.c")]));
+    assert_eq!(resolved.get_key("deps")?, &Value::Targets(vec![AnubisTarget::new("//pkg:other")?]));
+
+    // Cached per target and mode
+    assert!(std::sync::Arc::ptr_eq(&resolved, &anubis.get_resolved_object(&good, &linux)?));
+    assert_eq!(anubis.resolved_object_cache.len(), 1);
+
+    assert_err!(anubis.get_resolved_object(&AnubisTarget::new("//pkg:broken")?, &linux));
+    assert_err!(anubis.get_resolved_object(&AnubisTarget::new("//pkg:missing")?, &linux));
+
+    let windows_only = AnubisTarget::new("//pkg:windows_only")?;
+    let err = anubis.get_resolved_object(&windows_only, &linux).unwrap_err().to_string();
+    assert!(err.contains("unresolved"), "{}", err);
+    let resolved = anubis.get_resolved_object(&windows_only, &mode("windows"))?;
+    assert_eq!(resolved.get_key("value")?, &Value::String("win_value".to_owned()));
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+#[test]
+fn once_map_computes_each_key_once() {
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use std::sync::Arc;
+
+    let map: OnceMap<u32, u32> = Default::default();
+    let inits = AtomicUsize::new(0);
+    let barrier = std::sync::Barrier::new(8);
+
+    std::thread::scope(|scope| {
+        for _ in 0..8 {
+            scope.spawn(|| {
+                barrier.wait();
+                for key in 0..16 {
+                    let value = map.get_or_init(&key, || {
+                        inits.fetch_add(1, Ordering::Relaxed);
+                        std::thread::sleep(std::time::Duration::from_micros(200));
+                        Ok(Arc::new(key * 2))
+                    });
+                    assert_eq!(*value.unwrap(), key * 2);
+                }
+            });
+        }
+    });
+
+    assert_eq!(inits.load(Ordering::Relaxed), 16);
+    assert_eq!(map.len(), 16);
+
+    // Errors are cached too
+    let err = map.get_or_init(&99, || anyhow::bail!("broken"));
+    assert_err!(err);
+    assert_err!(map.get_or_init(&99, || Ok(Arc::new(0))));
+}
+
+#[test]
+fn concurrent_resolves_share_one_parse() -> anyhow::Result<()> {
+    let root = scratch_dir("anubis_tests", "concurrent_resolves");
+    std::fs::create_dir_all(root.join("pkg"))?;
+    std::fs::write(root.join("pkg/ANUBIS"), r#"test_rule(name = "a", value = "x")"#)?;
+
+    let anubis = Anubis {
+        root: root.clone(),
+        ..Default::default()
+    };
+    let mode = Mode {
+        name: "linux".to_owned(),
+        vars: Default::default(),
+        target: AnubisTarget::new("//mode:linux")?,
+    };
+    let target = AnubisTarget::new("//pkg:a")?;
+
+    let resolved: Vec<_> = std::thread::scope(|scope| {
+        let threads: Vec<_> =
+            (0..8).map(|_| scope.spawn(|| anubis.get_resolved_object(&target, &mode).unwrap())).collect();
+        threads.into_iter().map(|t| t.join().unwrap()).collect()
+    });
+    assert!(resolved.iter().all(|object| std::sync::Arc::ptr_eq(object, &resolved[0])));
+    assert_eq!(anubis.raw_config_cache.len(), 1);
+    assert_eq!(anubis.resolved_object_cache.len(), 1);
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+/// Benchmark: allocations and peak heap for loading every rule of the ffmpeg sample in each mode.
+/// Run with: cargo test --release --features count-allocations bench_load_ffmpeg_rules -- --ignored
+///   --nocapture --test-threads=1
+#[cfg(feature = "count-allocations")]
+#[test]
+#[ignore]
+fn bench_load_ffmpeg_rules() -> anyhow::Result<()> {
+    use crate::test_utils::measure_allocations;
+
+    let root = Utf8PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+    let cache_dir = scratch_dir("anubis_tests", "bench_cache");
+    let mut anubis = Anubis::new(root.clone(), cache_dir.clone(), false)?;
+    anubis.papyrus_snapshots = Default::default();
+    let config_path = root.join("samples/external/ffmpeg/ANUBIS");
+    let config = crate::papyrus::read_papyrus_file(config_path.as_std_path())?;
+    let names: Vec<String> = config
+        .as_array()
+        .unwrap()
+        .iter()
+        .filter_map(|object| match object.as_object()?.fields.get("name")? {
+            Value::String(name) => Some(name.clone()),
+            _ => None,
+        })
+        .collect();
+
+    let (_, parse) = measure_allocations(|| crate::papyrus::read_papyrus_file(config_path.as_std_path()));
+    println!("        parse: {:>9} allocations, {:>9} peak bytes", parse.allocations, parse.peak_bytes);
+
+    for mode_name in ["win_dev", "win_release", "linux_dev", "linux_release"] {
+        let (rules, stats) = measure_allocations(|| -> anyhow::Result<usize> {
+            let mode = anubis.get_mode(&AnubisTarget::new(&format!("//mode:{}", mode_name))?)?;
+            for name in &names {
+                anubis.get_rule(&AnubisTarget::new(&format!("//samples/external/ffmpeg:{}", name))?, &mode)?;
+            }
+            Ok(names.len())
+        });
+        let rules = rules?;
+        println!(
+            "{:>13}: {:>9} allocations, {:>9} peak bytes, {} rules",
+            mode_name, stats.allocations, stats.peak_bytes, rules
+        );
+        anubis.rule_cache = Default::default();
+    }
+
+    let _ = std::fs::remove_dir_all(&cache_dir);
+    Ok(())
+}
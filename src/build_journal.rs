@@ -0,0 +1,318 @@
+//! Build journal for stat-only up-to-date checks.
+//!
+//! For every output the journal remembers the command that produced it and every input
+//! it read (from the compiler's `.d` file), along with each input's mtime and size at the
+//! time it was recorded. On the next build an output is up to date if the command is the
+//! same and every input still has the same mtime and size, which only costs `stat` calls.
+//! If an input's mtime changed but its size did not, its xxh3 hash is compared against the
+//! recorded one so that touched-but-identical files do not force a rebuild.
+//!
+//! Each record also keeps the hash of the output itself. Callers use it for early cutoff:
+//! steps report the hash of what they produced, and dependents pass those hashes to
+//! `is_up_to_date_with`, so an input rewritten with identical bytes neither forces a rebuild
+//! nor has to be read again.
+//!
+//! The journal is a single compact binary file at `{root}/.anubis-build/.journal`. It is
+//! loaded on first use and written back once at the end of a build.
+
+use crate::action_cache::{self, ActionInput};
+use crate::util::{self, ByteReader};
+use crate::{anyhow_loc, bail_loc, bail_loc_if, function_name};
+use camino::{Utf8Path, Utf8PathBuf};
+use dashmap::DashMap;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::OnceLock;
+use std::time::UNIX_EPOCH;
+
+const JOURNAL_MAGIC: &[u8; 4] = b"ANBJ";
+const JOURNAL_VERSION: u32 = 2;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug, Default)]
+pub struct BuildJournal {
+    path: Utf8PathBuf,
+    records: OnceLock<DashMap<Utf8PathBuf, JournalRecord>>,
+    dirty: AtomicBool,
+
+    /// Outputs found up to date or recorded since the journal was opened, with their command hash.
+    checked: DashMap<Utf8PathBuf, u64>,
+}
+
+/// Cheap identity of a file on disk.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct FileStamp {
+    pub mtime_ns: u64,
+    pub size: u64,
+}
+
+#[derive(Clone, Debug, PartialEq)]
+pub struct JournalRecord {
+    /// Hash of the tool and full argument vector that produced the output.
+    pub command_hash: u64,
+    pub output: FileStamp,
+    pub output_hash: Option<u64>,
+    pub inputs: Vec<JournalInput>,
+}
+
+#[derive(Clone, Debug, PartialEq)]
+pub struct JournalInput {
+    pub path: Utf8PathBuf,
+    pub stamp: FileStamp,
+
+    /// Content hash, if one was known when the record was written.
+    pub hash: Option<u64>,
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl FileStamp {
+    pub fn stat(path: &Utf8Path) -> Option<FileStamp> {
+        let metadata = std::fs::metadata(path).ok()?;
+        let mtime_ns = metadata.modified().ok()?.duration_since(UNIX_EPOCH).ok()?.as_nanos() as u64;
+        Some(FileStamp {
+            mtime_ns,
+            size: metadata.len(),
+        })
+    }
+}
+
+impl BuildJournal {
+    pub fn new(path: Utf8PathBuf) -> BuildJournal {
+        BuildJournal {
+            path,
+            records: Default::default(),
+            dirty: AtomicBool::new(false),
+            checked: Default::default(),
+        }
+    }
+
+    /// Returns true if `output` was produced by `command_hash` and none of its recorded inputs changed.
+    /// - Inputs with matching mtime and size are unchanged without reading them
+    /// - Inputs with a new mtime but the same size are hashed and compared to the recorded hash
+    pub fn is_up_to_date(&self, output: &Utf8Path, command_hash: u64) -> bool {
+        self.is_up_to_date_with(output, command_hash, |_| None)
+    }
+
+    /// Same as `is_up_to_date`, but `known_hash` can supply the current hash of an input
+    /// (e.g. from an upstream job's artifact) so touched inputs don't have to be read again.
+    pub fn is_up_to_date_with(
+        &self,
+        output: &Utf8Path,
+        command_hash: u64,
+        known_hash: impl Fn(&Utf8Path) -> Option<u64>,
+    ) -> bool {
+        // Clone the record so no map lock is held while hashing
+        let Some(mut record) = self.records().get(output).map(|r| r.clone()) else {
+            return false;
+        };
+
+        if record.command_hash != command_hash || FileStamp::stat(output) != Some(record.output) {
+            return false;
+        }
+
+        let mut refreshed = false;
+        for input in &mut record.inputs {
+            let Some(stamp) = FileStamp::stat(&input.path) else {
+                return false;
+            };
+            if stamp == input.stamp {
+                continue;
+            }
+
+            // Touched but possibly identical. Hash only when we have something to compare against.
+            let (Some(recorded_hash), true) = (input.hash, stamp.size == input.stamp.size) else {
+                return false;
+            };
+            let current_hash = match known_hash(&input.path) {
+                Some(hash) => Ok(hash),
+                None => action_cache::hash_file(&input.path),
+            };
+            match current_hash {
+                Ok(hash) if hash == recorded_hash => {
+                    input.stamp = stamp;
+                    refreshed = true;
+                }
+                _ => return false,
+            }
+        }
+
+        // Remember the new mtimes so the next build doesn't hash these files again
+        if refreshed {
+            self.records().insert(output.to_owned(), record);
+            self.dirty.store(true, Ordering::Relaxed);
+        }
+
+        self.checked.insert(output.to_owned(), command_hash);
+        true
+    }
+
+    /// Returns the output hash recorded by the previous build, if any.
+    pub fn output_hash(&self, output: &Utf8Path) -> Option<u64> {
+        self.records().get(output).and_then(|r| r.output_hash)
+    }
+
+    /// Records that `output` was just produced by `command_hash` from `inputs`.
+    /// Inputs are stat'd now; their hashes are kept so a later mtime-only change can be verified cheaply.
+    /// Returns the hash of `output`.
+    pub fn record(&self, output: &Utf8Path, command_hash: u64, inputs: &[ActionInput]) -> Option<u64> {
+        let output_stamp = FileStamp::stat(output)?;
+        let output_hash = action_cache::hash_file(output).ok();
+
+        let mut journal_inputs = Vec::with_capacity(inputs.len());
+        for input in inputs {
+            let stamp = FileStamp::stat(&input.path)?;
+            journal_inputs.push(JournalInput {
+                path: input.path.clone(),
+                stamp,
+                hash: Some(input.hash),
+            });
+        }
+
+        self.records().insert(
+            output.to_owned(),
+            JournalRecord {
+                command_hash,
+                output: output_stamp,
+                output_hash,
+                inputs: journal_inputs,
+            },
+        );
+        self.dirty.store(true, Ordering::Relaxed);
+        self.checked.insert(output.to_owned(), command_hash);
+        output_hash
+    }
+
+    /// Every output this session found up to date or recorded, with the command hash it was checked for.
+    pub fn checked_outputs(&self) -> Vec<(Utf8PathBuf, u64)> {
+        self.checked.iter().map(|entry| (entry.key().clone(), *entry.value())).collect()
+    }
+
+    /// Writes the journal back to disk if anything changed since it was loaded.
+    pub fn save(&self) -> anyhow::Result<()> {
+        if !self.dirty.swap(false, Ordering::Relaxed) {
+            return Ok(());
+        }
+
+        util::write_atomic(&self.path, &encode_journal(self.records()))
+    }
+
+    pub fn len(&self) -> usize {
+        self.records().len()
+    }
+
+    fn records(&self) -> &DashMap<Utf8PathBuf, JournalRecord> {
+        self.records.get_or_init(|| match std::fs::read(&self.path) {
+            Ok(bytes) => decode_journal(&bytes).unwrap_or_else(|e| {
+                tracing::warn!("Ignoring unreadable build journal [{}]: {}", self.path, e);
+                Default::default()
+            }),
+            Err(_) => Default::default(),
+        })
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Serialization
+// ----------------------------------------------------------------------------
+// Layout (all integers little-endian):
+//   magic[4] version:u32
+//   path_count:u32 { len:u32 bytes[len] }*
+//   record_count:u32 {
+//       output:u32 command_hash:u64 mtime:u64 size:u64 has_hash:u8 hash:u64
+//       input_count:u32 { path:u32 mtime:u64 size:u64 has_hash:u8 hash:u64 }*
+//   }*
+// Paths are stored once in a table and referenced by index since headers are shared by many objects.
+
+fn encode_journal(records: &DashMap<Utf8PathBuf, JournalRecord>) -> Vec<u8> {
+    let mut paths: Vec<Utf8PathBuf> = Default::default();
+    let mut path_indices: HashMap<Utf8PathBuf, u32> = Default::default();
+    let mut intern = |path: &Utf8Path| -> u32 {
+        if let Some(idx) = path_indices.get(path) {
+            return *idx;
+        }
+        let idx = paths.len() as u32;
+        paths.push(path.to_owned());
+        path_indices.insert(path.to_owned(), idx);
+        idx
+    };
+
+    let mut body: Vec<u8> = Default::default();
+    body.extend((records.len() as u32).to_le_bytes());
+    for entry in records.iter() {
+        let (output, record) = entry.pair();
+        body.extend(intern(output).to_le_bytes());
+        body.extend(record.command_hash.to_le_bytes());
+        body.extend(record.output.mtime_ns.to_le_bytes());
+        body.extend(record.output.size.to_le_bytes());
+        body.push(record.output_hash.is_some() as u8);
+        body.extend(record.output_hash.unwrap_or(0).to_le_bytes());
+        body.extend((record.inputs.len() as u32).to_le_bytes());
+        for input in &record.inputs {
+            body.extend(intern(&input.path).to_le_bytes());
+            body.extend(input.stamp.mtime_ns.to_le_bytes());
+            body.extend(input.stamp.size.to_le_bytes());
+            body.push(input.hash.is_some() as u8);
+            body.extend(input.hash.unwrap_or(0).to_le_bytes());
+        }
+    }
+
+    let mut bytes: Vec<u8> = Default::default();
+    bytes.extend(JOURNAL_MAGIC);
+    bytes.extend(JOURNAL_VERSION.to_le_bytes());
+    bytes.extend((paths.len() as u32).to_le_bytes());
+    for path in &paths {
+        util::put_str(&mut bytes, path.as_str());
+    }
+    bytes.extend(body);
+    bytes
+}
+
+fn decode_journal(bytes: &[u8]) -> anyhow::Result<DashMap<Utf8PathBuf, JournalRecord>> {
+    let mut r = ByteReader::new(bytes, "journal");
+    bail_loc_if!(r.take(4)? != JOURNAL_MAGIC, "Bad journal magic");
+    let version = r.u32()?;
+    bail_loc_if!(version != JOURNAL_VERSION, "Unsupported journal version [{}]", version);
+
+    let paths = r.list(|r| Ok(Utf8PathBuf::from(r.str()?)))?;
+    let path = |idx: u32| -> anyhow::Result<Utf8PathBuf> {
+        paths.get(idx as usize).cloned().ok_or_else(|| anyhow_loc!("Journal path index [{}] out of range", idx))
+    };
+
+    let records: DashMap<Utf8PathBuf, JournalRecord> = Default::default();
+    let record_count = r.u32()?;
+    for _ in 0..record_count {
+        let output = path(r.u32()?)?;
+        let command_hash = r.u64()?;
+        let output_stamp = FileStamp {
+            mtime_ns: r.u64()?,
+            size: r.u64()?,
+        };
+        let output_hash = r.optional_u64()?;
+        let input_count = r.u32()? as usize;
+        let mut inputs = Vec::with_capacity(input_count);
+        for _ in 0..input_count {
+            let path = path(r.u32()?)?;
+            let stamp = FileStamp {
+                mtime_ns: r.u64()?,
+                size: r.u64()?,
+            };
+            let hash = r.optional_u64()?;
+            inputs.push(JournalInput { path, stamp, hash });
+        }
+        records.insert(
+            output,
+            JournalRecord {
+                command_hash,
+                output: output_stamp,
+                output_hash,
+                inputs,
+            },
+        );
+    }
+
+    Ok(records)
+}
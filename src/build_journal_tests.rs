@@ -0,0 +1,132 @@
+//! Tests for build_journal.rs
+
+use std::time::{Duration, SystemTime};
+
+use crate::action_cache::hash_file;
+use crate::assert_ok;
+use crate::build_journal::*;
+use crate::test_utils::{input, scratch_dir, write_backdated};
+
+#[test]
+fn journal_unknown_output_is_stale() {
+    let dir = scratch_dir("build_journal_tests", "unknown");
+    let journal = BuildJournal::new(dir.join(".journal"));
+    assert!(!journal.is_up_to_date(&dir.join("foo.obj"), 1));
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn journal_unchanged_inputs_are_up_to_date() {
+    let dir = scratch_dir("build_journal_tests", "unchanged");
+    let journal = BuildJournal::new(dir.join(".journal"));
+    let header = dir.join("foo.h");
+    let obj = dir.join("foo.obj");
+    write_backdated(&header, "int foo();");
+    write_backdated(&obj, "object");
+
+    journal.record(&obj, 1, &[input(&header)]);
+    assert!(journal.is_up_to_date(&obj, 1));
+
+    // Different command
+    assert!(!journal.is_up_to_date(&obj, 2));
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn journal_detects_content_change() {
+    let dir = scratch_dir("build_journal_tests", "content_change");
+    let journal = BuildJournal::new(dir.join(".journal"));
+    let header = dir.join("foo.h");
+    let obj = dir.join("foo.obj");
+    write_backdated(&header, "int foo();");
+    write_backdated(&obj, "object");
+    journal.record(&obj, 1, &[input(&header)]);
+
+    // Same size, different contents
+    std::fs::write(&header, "int bar();").unwrap();
+    assert!(!journal.is_up_to_date(&obj, 1));
+
+    // Deleted input
+    std::fs::remove_file(&header).unwrap();
+    assert!(!journal.is_up_to_date(&obj, 1));
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn journal_touched_identical_input_is_up_to_date() {
+    let dir = scratch_dir("build_journal_tests", "touched");
+    let journal = BuildJournal::new(dir.join(".journal"));
+    let header = dir.join("foo.h");
+    let obj = dir.join("foo.obj");
+    write_backdated(&header, "int foo();");
+    write_backdated(&obj, "object");
+    journal.record(&obj, 1, &[input(&header)]);
+
+    // Rewrite with identical contents; mtime changes but the hash matches
+    std::fs::write(&header, "int foo();").unwrap();
+    assert!(journal.is_up_to_date(&obj, 1));
+
+    // Modified output is stale
+    std::fs::write(&obj, "tampered").unwrap();
+    assert!(!journal.is_up_to_date(&obj, 1));
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn journal_save_and_reload() {
+    let dir = scratch_dir("build_journal_tests", "reload");
+    let header = dir.join("foo.h");
+    let obj_a = dir.join("a.obj");
+    let obj_b = dir.join("b.obj");
+    write_backdated(&header, "int foo();");
+    write_backdated(&obj_a, "a");
+    write_backdated(&obj_b, "b");
+
+    let journal = BuildJournal::new(dir.join(".journal"));
+    journal.record(&obj_a, 1, &[input(&header)]);
+    journal.record(&obj_b, 2, &[input(&header)]);
+    assert_ok!(journal.save());
+
+    let reloaded = BuildJournal::new(dir.join(".journal"));
+    assert_eq!(reloaded.len(), 2);
+    assert!(reloaded.is_up_to_date(&obj_a, 1));
+    assert!(reloaded.is_up_to_date(&obj_b, 2));
+    assert!(!reloaded.is_up_to_date(&obj_b, 1));
+
+    // A corrupt journal is ignored rather than failing the build
+    std::fs::write(dir.join(".journal"), "garbage").unwrap();
+    let corrupt = BuildJournal::new(dir.join(".journal"));
+    assert_eq!(corrupt.len(), 0);
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn journal_known_hashes_and_output_hash() {
+    let dir = scratch_dir("build_journal_tests", "known_hashes");
+    let journal = BuildJournal::new(dir.join(".journal"));
+    let obj = dir.join("foo.obj");
+    let lib = dir.join("foo.lib");
+    write_backdated(&obj, "object");
+    write_backdated(&lib, "library");
+
+    let obj_hash = hash_file(&obj).unwrap();
+    let lib_hash = journal.record(&lib, 1, &[input(&obj)]);
+    assert_eq!(lib_hash, Some(hash_file(&lib).unwrap()));
+    assert_eq!(journal.output_hash(&lib), lib_hash);
+    assert_eq!(journal.output_hash(&obj), None);
+
+    // Object rewritten with identical bytes; a known hash is trusted instead of reading the file
+    std::fs::write(&obj, "object").unwrap();
+    assert!(journal.is_up_to_date_with(&lib, 1, |p| (p == obj).then_some(obj_hash)));
+
+    // A known hash that differs means the input changed
+    let file = std::fs::File::options().write(true).open(&obj).unwrap();
+    file.set_modified(SystemTime::now() + Duration::from_secs(60)).unwrap();
+    assert!(!journal.is_up_to_date_with(&lib, 1, |p| (p == obj).then_some(obj_hash ^ 1)));
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
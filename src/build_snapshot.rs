@@ -0,0 +1,255 @@
+//! Snapshots of no-op builds.
+//!
+//! Even when every output is up to date, a build resolves its mode and toolchain, loads every
+//! rule, expands every glob, and creates and runs every job before it learns there was nothing
+//! to do. When a build finishes without starting a single tool, its conclusion only depended on
+//! a few things: the ANUBIS files it read, what its globs matched, the anubis executable, and the
+//! journal entries of the outputs it checked. Those are written to
+//! `{root}/.anubis-build/.graph/{key}`, keyed by mode, toolchain, and target list.
+//!
+//! The next build with the same key revalidates the snapshot: config files by stamp (hashing only
+//! when the stamp moved), globs by re-listing them, and outputs through the build journal, which is
+//! stat-only when nothing changed. If everything still holds the build is skipped outright.
+//!
+//! Globs are collected from the raw target objects, including `select` branches this mode didn't
+//! take. A change there needlessly invalidates the snapshot, which only costs a normal build.
+
+use crate::anubis::AnubisTarget;
+use crate::build_journal::{BuildJournal, FileStamp};
+use crate::glob_cache::GlobCache;
+use crate::papyrus::{Glob, Value};
+use crate::util::{self, ByteReader};
+use crate::{anyhow_loc, bail_loc, bail_loc_if, function_name};
+use camino::{Utf8Path, Utf8PathBuf};
+use std::sync::Arc;
+
+const SNAPSHOT_MAGIC: &[u8; 4] = b"ANBG";
+const SNAPSHOT_VERSION: u32 = 2;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+/// Directory of build snapshots. The default has no directory and never skips a build.
+#[derive(Debug, Default)]
+pub struct BuildSnapshots {
+    dir: Option<Utf8PathBuf>,
+}
+
+/// Everything a no-op build's result depended on.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct BuildSnapshot {
+    pub executable: Option<FileStamp>,
+    pub configs: Vec<SnapshotFile>,
+
+    /// Absolute glob include patterns and the hash of what they matched.
+    pub globs: Vec<(String, u64)>,
+
+    /// Outputs and the command hash the journal checked them against.
+    pub outputs: Vec<(Utf8PathBuf, u64)>,
+}
+
+#[derive(Clone, Debug, PartialEq)]
+pub struct SnapshotFile {
+    pub path: Utf8PathBuf,
+    pub stamp: FileStamp,
+    pub hash: u64,
+}
+
+// ----------------------------------------------------------------------------
+// Public functions
+// ----------------------------------------------------------------------------
+/// Identifies a build by everything that picks its jobs and their command lines.
+pub fn snapshot_key(
+    mode: &AnubisTarget,
+    toolchain: &AnubisTarget,
+    targets: &[AnubisTarget],
+    verbose_tools: bool,
+) -> u64 {
+    let mut targets: Vec<&str> = targets.iter().map(|t| t.target_path()).collect();
+    targets.sort_unstable();
+    util::quick_hash(&(mode.target_path(), toolchain.target_path(), targets, verbose_tools))
+}
+
+/// Stamp of the running anubis binary, so a rebuilt anubis never trusts an old snapshot.
+pub fn current_executable_stamp() -> Option<FileStamp> {
+    let exe = Utf8PathBuf::try_from(std::env::current_exe().ok()?).ok()?;
+    FileStamp::stat(&exe)
+}
+
+/// Hashes the sorted list of paths `pattern` matches. A pattern that fails to parse hashes as no matches.
+pub fn hash_glob(pattern: &str) -> u64 {
+    let glob = Glob {
+        includes: vec![pattern.to_owned()],
+        excludes: Vec::new(),
+    };
+    let paths = GlobCache::default().expand(Utf8Path::new(""), &glob).unwrap_or_else(|_| Arc::new([]));
+    util::quick_hash(&paths)
+}
+
+/// Appends every glob include pattern in `value` to `patterns`, made absolute against `dir`.
+pub fn collect_glob_patterns(value: &Value, dir: &Utf8Path, patterns: &mut Vec<String>) {
+    let mut add_glob = |glob: &Glob| patterns.extend(glob.includes.iter().map(|p| dir.join(p).to_string()));
+    match value {
+        Value::Glob(glob) => add_glob(glob),
+        Value::Array(values) => values.iter().for_each(|v| collect_glob_patterns(v, dir, patterns)),
+        Value::Concat((left, right)) => {
+            collect_glob_patterns(left, dir, patterns);
+            collect_glob_patterns(right, dir, patterns);
+        }
+        Value::Object(object) => object.fields.values().for_each(|v| collect_glob_patterns(v, dir, patterns)),
+        Value::Map(fields) => fields.values().for_each(|v| collect_glob_patterns(v, dir, patterns)),
+        Value::Select(select) | Value::MultiSelect(select) => {
+            select.filters.iter().for_each(|(_, v)| collect_glob_patterns(v, dir, patterns))
+        }
+        _ => (),
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl SnapshotFile {
+    pub fn new(path: Utf8PathBuf) -> anyhow::Result<SnapshotFile> {
+        let stamp = FileStamp::stat(&path).ok_or_else(|| anyhow_loc!("Failed to stat [{}]", path))?;
+        let hash = crate::action_cache::hash_file(&path)?;
+        Ok(SnapshotFile { path, stamp, hash })
+    }
+
+    /// True if the file still has the recorded contents. Only read when its stamp changed.
+    fn is_unchanged(&self) -> bool {
+        match FileStamp::stat(&self.path) {
+            Some(stamp) if stamp == self.stamp => true,
+            Some(_) => crate::action_cache::hash_file(&self.path).is_ok_and(|hash| hash == self.hash),
+            None => false,
+        }
+    }
+}
+
+impl BuildSnapshot {
+    /// Returns the reason the snapshot no longer holds, or None if the build it describes is still a no-op.
+    pub fn invalidation(&self, journal: &BuildJournal) -> Option<String> {
+        if self.executable != current_executable_stamp() {
+            return Some("anubis executable changed".to_owned());
+        }
+        if let Some(config) = self.configs.iter().find(|config| !config.is_unchanged()) {
+            return Some(format!("[{}] changed", config.path));
+        }
+        if let Some((pattern, _)) = self.globs.iter().find(|(pattern, hash)| hash_glob(pattern) != *hash) {
+            return Some(format!("glob [{}] matches changed", pattern));
+        }
+        let stale = |(output, hash): &&(Utf8PathBuf, u64)| !journal.is_up_to_date(output, *hash);
+        if let Some((output, _)) = self.outputs.iter().find(stale) {
+            return Some(format!("[{}] is out of date", output));
+        }
+        None
+    }
+}
+
+impl BuildSnapshots {
+    pub fn new(dir: Utf8PathBuf) -> BuildSnapshots {
+        BuildSnapshots { dir: Some(dir) }
+    }
+
+    pub fn load(&self, key: u64) -> Option<BuildSnapshot> {
+        let bytes = std::fs::read(self.path(key)?).ok()?;
+        decode_snapshot(&bytes)
+            .map_err(|e| tracing::debug!("Ignoring unreadable build snapshot [{:016x}]: {}", key, e))
+            .ok()
+    }
+
+    pub fn save(&self, key: u64, snapshot: &BuildSnapshot) -> anyhow::Result<()> {
+        let Some(path) = self.path(key) else {
+            return Ok(());
+        };
+        util::write_atomic(&path, &encode_snapshot(snapshot))
+    }
+
+    pub fn remove(&self, key: u64) {
+        if let Some(path) = self.path(key) {
+            let _ = std::fs::remove_file(path);
+        }
+    }
+
+    fn path(&self, key: u64) -> Option<Utf8PathBuf> {
+        Some(self.dir.as_ref()?.join(format!("{:016x}", key)))
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Serialization
+// ----------------------------------------------------------------------------
+// Layout (all integers little-endian):
+//   magic[4] version:u32
+//   has_exe:u8 exe_mtime:u64 exe_size:u64
+//   config_count:u32 { path:str mtime:u64 size:u64 hash:u64 }*
+//   glob_count:u32 { pattern:str hash:u64 }*
+//   output_count:u32 { path:str command_hash:u64 }*
+// where str is len:u32 bytes[len].
+
+fn encode_snapshot(snapshot: &BuildSnapshot) -> Vec<u8> {
+    let mut bytes: Vec<u8> = Default::default();
+    bytes.extend(SNAPSHOT_MAGIC);
+    bytes.extend(SNAPSHOT_VERSION.to_le_bytes());
+    let exe = snapshot.executable.unwrap_or_default();
+    bytes.push(snapshot.executable.is_some() as u8);
+    bytes.extend(exe.mtime_ns.to_le_bytes());
+    bytes.extend(exe.size.to_le_bytes());
+
+    bytes.extend((snapshot.configs.len() as u32).to_le_bytes());
+    for config in &snapshot.configs {
+        util::put_str(&mut bytes, config.path.as_str());
+        bytes.extend(config.stamp.mtime_ns.to_le_bytes());
+        bytes.extend(config.stamp.size.to_le_bytes());
+        bytes.extend(config.hash.to_le_bytes());
+    }
+    bytes.extend((snapshot.globs.len() as u32).to_le_bytes());
+    for (pattern, hash) in &snapshot.globs {
+        util::put_str(&mut bytes, pattern);
+        bytes.extend(hash.to_le_bytes());
+    }
+    bytes.extend((snapshot.outputs.len() as u32).to_le_bytes());
+    for (output, command_hash) in &snapshot.outputs {
+        util::put_str(&mut bytes, output.as_str());
+        bytes.extend(command_hash.to_le_bytes());
+    }
+    bytes
+}
+
+fn decode_snapshot(bytes: &[u8]) -> anyhow::Result<BuildSnapshot> {
+    let mut r = ByteReader::new(bytes, "build snapshot");
+    bail_loc_if!(r.take(4)? != SNAPSHOT_MAGIC, "Bad build snapshot magic");
+    let version = r.u32()?;
+    bail_loc_if!(version != SNAPSHOT_VERSION, "Unsupported build snapshot version [{}]", version);
+
+    let has_exe = r.flag()?;
+    let exe = FileStamp {
+        mtime_ns: r.u64()?,
+        size: r.u64()?,
+    };
+    let mut snapshot = BuildSnapshot {
+        executable: has_exe.then_some(exe),
+        ..Default::default()
+    };
+    for _ in 0..r.u32()? {
+        let path = Utf8PathBuf::from(r.str()?);
+        let stamp = FileStamp {
+            mtime_ns: r.u64()?,
+            size: r.u64()?,
+        };
+        snapshot.configs.push(SnapshotFile {
+            path,
+            stamp,
+            hash: r.u64()?,
+        });
+    }
+    for _ in 0..r.u32()? {
+        let pattern = r.str()?.to_owned();
+        snapshot.globs.push((pattern, r.u64()?));
+    }
+    for _ in 0..r.u32()? {
+        let output = Utf8PathBuf::from(r.str()?);
+        snapshot.outputs.push((output, r.u64()?));
+    }
+    r.finish()?;
+    Ok(snapshot)
+}
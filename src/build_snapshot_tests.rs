@@ -0,0 +1,186 @@
+//! Tests and benchmarks for build_snapshot.rs
+
+use std::time::Instant;
+
+use crate::anubis::{Anubis, AnubisTarget};
+use crate::build_journal::BuildJournal;
+use crate::build_snapshot::*;
+use crate::toolchain::Mode;
+use crate::test_utils::{input, scratch_dir, write_backdated};
+
+#[test]
+fn snapshot_roundtrips_and_detects_changes() -> anyhow::Result<()> {
+    let dir = scratch_dir("build_snapshot_tests", "changes");
+    std::fs::create_dir_all(dir.join("src"))?;
+    let config = dir.join("ANUBIS");
+    let source = dir.join("src/main.c");
+    let object = dir.join("main.o");
+    write_backdated(&config, "rule(name = \"main\")");
+    write_backdated(&source, "int main() {}");
+    write_backdated(&object, "object");
+
+    let journal = BuildJournal::new(dir.join(".journal"));
+    journal.record(&object, 7, &[input(&source)]);
+    let pattern = dir.join("src/*.c").to_string();
+    let snapshot = BuildSnapshot {
+        executable: current_executable_stamp(),
+        configs: vec![SnapshotFile::new(config.clone())?],
+        globs: vec![(pattern.clone(), hash_glob(&pattern))],
+        outputs: journal.checked_outputs(),
+    };
+
+    let snapshots = BuildSnapshots::new(dir.join(".graph"));
+    snapshots.save(1, &snapshot)?;
+    assert_eq!(snapshots.load(1), Some(snapshot.clone()));
+    assert_eq!(snapshots.load(2), None);
+    assert_eq!(snapshot.invalidation(&journal), None);
+
+    // A new file matching a glob
+    std::fs::write(dir.join("src/extra.c"), "")?;
+    assert!(snapshot.invalidation(&journal).unwrap().contains("glob"));
+    std::fs::remove_file(dir.join("src/extra.c"))?;
+    assert_eq!(snapshot.invalidation(&journal), None);
+
+    // Touched but identical config, then an edited one
+    std::fs::write(&config, "rule(name = \"main\")")?;
+    assert_eq!(snapshot.invalidation(&journal), None);
+    std::fs::write(&config, "rule(name = \"other\")")?;
+    assert!(snapshot.invalidation(&journal).unwrap().contains("ANUBIS"));
+    write_backdated(&config, "rule(name = \"main\")");
+
+    // An edited source
+    std::fs::write(&source, "int main() { return 1; }")?;
+    assert!(snapshot.invalidation(&journal).unwrap().contains("main.o"));
+
+    snapshots.remove(1);
+    assert_eq!(snapshots.load(1), None);
+    assert_eq!(BuildSnapshots::default().load(1), None);
+
+    let _ = std::fs::remove_dir_all(&dir);
+    Ok(())
+}
+
+#[test]
+fn snapshot_key_ignores_target_order() -> anyhow::Result<()> {
+    let mode = AnubisTarget::new("//mode:linux_dev")?;
+    let toolchain = AnubisTarget::new("//toolchains:default")?;
+    let a = AnubisTarget::new("//pkg:a")?;
+    let b = AnubisTarget::new("//pkg:b")?;
+
+    let key = snapshot_key(&mode, &toolchain, &[a.clone(), b.clone()], false);
+    assert_eq!(key, snapshot_key(&mode, &toolchain, &[b.clone(), a.clone()], false));
+    assert_ne!(key, snapshot_key(&mode, &toolchain, &[a.clone()], false));
+    assert_ne!(key, snapshot_key(&mode, &toolchain, &[a, b], true));
+    Ok(())
+}
+
+#[test]
+fn anubis_snapshot_collects_configs_globs_and_outputs() -> anyhow::Result<()> {
+    let root = scratch_dir("build_snapshot_tests", "collect");
+    std::fs::create_dir_all(root.join("pkg"))?;
+    std::fs::write(root.join("pkg/main.c"), "")?;
+    std::fs::write(
+        root.join("pkg/ANUBIS"),
+        r#"
+        test_rule(
+            name = "app",
+            srcs = glob(["*.c"]),
+            win_srcs = select(
+                (platform) => {
+                    (windows) = glob(["win/*.c"]),
+                    default = [],
+                }
+            ),
+        )
+        test_rule(
+            name = "unused",
+            srcs = glob(["unused/*.c"]),
+        )
+        "#,
+    )?;
+
+    let anubis = Anubis {
+        root: root.clone(),
+        ..Default::default()
+    };
+    let mode = Mode {
+        name: "linux".to_owned(),
+        vars: [("platform".to_owned(), "linux".to_owned())].into(),
+        target: AnubisTarget::new("//mode:linux")?,
+    };
+    anubis.get_resolved_object(&AnubisTarget::new("//pkg:app")?, &mode)?;
+    let object = root.join("app.o");
+    std::fs::write(&object, "object")?;
+    anubis.build_journal.record(&object, 3, &[input(&root.join("pkg/main.c"))]);
+
+    let snapshot = anubis.build_snapshot()?;
+    assert_eq!(snapshot.configs.len(), 1);
+    assert_eq!(snapshot.configs[0].path, root.join("pkg/ANUBIS"));
+    let patterns: Vec<&str> = snapshot.globs.iter().map(|(pattern, _)| pattern.as_str()).collect();
+    let pkg = root.join("pkg");
+    assert_eq!(patterns, [pkg.join("*.c").as_str(), pkg.join("win/*.c").as_str()]);
+    assert_eq!(snapshot.outputs, [(object, 3)]);
+    assert_eq!(snapshot.invalidation(&anubis.build_journal), None);
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+/// Benchmark: validating the snapshot of a no-op build over a 10k-source tree.
+/// Run with: cargo test --release bench_snapshot_validation -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_snapshot_validation() -> anyhow::Result<()> {
+    const LIBRARIES: usize = 500;
+    const FILES_PER_LIBRARY: usize = 20;
+
+    let root = scratch_dir("build_snapshot_tests", "bench");
+    let journal = BuildJournal::new(root.join(".journal"));
+    let mut configs = Vec::new();
+    let mut globs = Vec::new();
+    for lib in 0..LIBRARIES {
+        let dir = root.join(format!("lib{}", lib));
+        std::fs::create_dir_all(dir.join("src"))?;
+        let header = dir.join("lib.h");
+        std::fs::write(&header, "int f();")?;
+        for file in 0..FILES_PER_LIBRARY {
+            let source = dir.join(format!("src/file{}.c", file));
+            let object = dir.join(format!("file{}.o", file));
+            std::fs::write(&source, "int f() { return 0; }")?;
+            std::fs::write(&object, "object")?;
+            journal.record(&object, 1, &[input(&source), input(&header)]);
+        }
+        let config = dir.join("ANUBIS");
+        std::fs::write(&config, "cc_static_library(name = \"lib\", srcs = glob([\"src/*.c\"]))")?;
+        configs.push(SnapshotFile::new(config)?);
+        let pattern = dir.join("src/*.c").to_string();
+        globs.push((pattern.clone(), hash_glob(&pattern)));
+    }
+    let snapshot = BuildSnapshot {
+        executable: current_executable_stamp(),
+        configs,
+        globs,
+        outputs: journal.checked_outputs(),
+    };
+    journal.save()?;
+    let snapshots = BuildSnapshots::new(root.join(".graph"));
+    snapshots.save(1, &snapshot)?;
+
+    // What a fresh no-op invocation does: load both files and revalidate
+    let start = Instant::now();
+    let journal = BuildJournal::new(root.join(".journal"));
+    let loaded = snapshots.load(1).unwrap();
+    assert_eq!(loaded.invalidation(&journal), None);
+    let elapsed = start.elapsed();
+
+    println!(
+        "{} sources, {} configs, {} globs: no-op validation took {:?}",
+        LIBRARIES * FILES_PER_LIBRARY,
+        loaded.configs.len(),
+        loaded.globs.len(),
+        elapsed
+    );
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
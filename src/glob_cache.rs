@@ -0,0 +1,422 @@
+//! Expansion of Papyrus `glob()` values.
+//!
+//! `glob::glob` walks the filesystem for each include pattern separately, so overlapping globs like
+//! `glob(["**/*.c"])` in neighbouring targets list the same directories again and again. `GlobCache`
+//! lists each directory at most once per build and shares that listing with every glob that visits
+//! it. The first `**` under a directory lists its whole subtree in one parallel jwalk walk.
+//!
+//! All includes and excludes of a glob are compiled into one `GlobMatcher`. Expanded globs are cached
+//! by (root, glob), so a target resolved in several modes expands its globs once, and
+//! `expand_all` expands independent globs on several threads.
+//!
+//! Patterns use the glob crate's syntax: `?`, `*`, `[abc]` and `[!a-z]` within a path component,
+//! and `**` as a whole component for any number of directories. As with `glob::Pattern`, a `*` in
+//! an exclude also matches across `/`.
+
+use crate::anubis::{ArcResult, OnceMap};
+use crate::papyrus::Glob;
+use crate::{bail_loc, bail_loc_if, function_name};
+use anyhow::Context;
+use camino::{Utf8Path, Utf8PathBuf};
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Arc;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+/// Per-build cache of directory listings and expanded globs.
+#[derive(Debug, Default)]
+pub struct GlobCache {
+    listings: OnceMap<Utf8PathBuf, [DirEntry]>,
+    walked_trees: OnceMap<Utf8PathBuf, ()>,
+    expanded: OnceMap<(Utf8PathBuf, Glob), [Utf8PathBuf]>,
+}
+
+/// The includes and excludes of one glob, compiled against its root directory.
+#[derive(Debug)]
+pub struct GlobMatcher {
+    includes: Vec<IncludePattern>,
+    excludes: Vec<Vec<PatternToken>>,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug)]
+struct DirEntry {
+    name: String,
+    is_dir: bool,
+}
+
+/// An include pattern split into the directory it starts listing from and the components below it.
+#[derive(Debug)]
+struct IncludePattern {
+    base: String,
+    components: Vec<Component>,
+}
+
+#[derive(Debug)]
+enum Component {
+    Literal(String),
+    Wildcard(Vec<PatternToken>),
+    AnyDirs,
+}
+
+#[derive(Debug, PartialEq)]
+enum PatternToken {
+    Char(char),
+    AnyChar,
+    AnySequence,
+    /// `**/` in an exclude: zero or more whole directories.
+    AnyDirs,
+    Class { negated: bool, ranges: Vec<(char, char)> },
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl GlobCache {
+    /// Returns the sorted paths `glob` matches under `root`. Only the first call per (root, glob) touches
+    /// the filesystem.
+    pub fn expand(&self, root: &Utf8Path, glob: &Glob) -> ArcResult<[Utf8PathBuf]> {
+        let key = (root.to_owned(), glob.clone());
+        self.expanded.get_or_init(&key, || {
+            let matcher = GlobMatcher::new(root, glob)?;
+            Ok(matcher.expand(self)?.into())
+        })
+    }
+
+    /// Expands every glob in `globs`, spread over the available cores. Results and errors are cached
+    /// for the `expand` calls that follow.
+    pub fn expand_all(&self, globs: &[(&Utf8Path, &Glob)]) {
+        let threads = std::thread::available_parallelism().map_or(1, |n| n.get()).min(globs.len());
+        if threads <= 1 {
+            globs.iter().for_each(|(root, glob)| drop(self.expand(root, glob)));
+            return;
+        }
+
+        let next = AtomicUsize::new(0);
+        std::thread::scope(|scope| {
+            for _ in 0..threads {
+                scope.spawn(|| {
+                    while let Some((root, glob)) = globs.get(next.fetch_add(1, Ordering::Relaxed)) {
+                        drop(self.expand(root, glob));
+                    }
+                });
+            }
+        });
+    }
+
+    /// Entries of `dir`. A directory that doesn't exist lists as empty.
+    fn listing(&self, dir: &str) -> ArcResult<[DirEntry]> {
+        self.listings.get_or_init(&listing_key(dir), || {
+            let read_dir = match std::fs::read_dir(dir_path(dir)) {
+                Ok(read_dir) => read_dir,
+                Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(Arc::new([])),
+                Err(e) => return Err(e).with_context(|| format!("Failed to list directory [{}]", dir)),
+            };
+            let mut entries = Vec::new();
+            for entry in read_dir {
+                let entry = entry.with_context(|| format!("Failed to list directory [{}]", dir))?;
+                let file_type = entry.file_type()?;
+                entries.push(DirEntry {
+                    name: entry.file_name().to_string_lossy().into_owned(),
+                    is_dir: file_type.is_dir() || (file_type.is_symlink() && entry.path().is_dir()),
+                });
+            }
+            Ok(entries.into())
+        })
+    }
+
+    /// Lists every directory under `dir` with one parallel walk, unless `dir` was already listed by an
+    /// earlier walk or glob. Directories the walk couldn't read are left for `listing` to report.
+    fn walk_tree(&self, dir: &str) {
+        if self.listings.contains(&listing_key(dir)) {
+            return;
+        }
+        let _ = self.walked_trees.get_or_init(&listing_key(dir), || {
+            let mut listings: HashMap<Utf8PathBuf, Vec<DirEntry>> = HashMap::new();
+            listings.insert(listing_key(dir), Vec::new());
+            let mut unreadable = Vec::new();
+            for entry in jwalk::WalkDir::new(dir_path(dir)).skip_hidden(false).follow_links(false) {
+                let entry = match entry {
+                    Ok(entry) => entry,
+                    Err(e) => {
+                        // Without a path the failed directory is unknown, so nothing from this walk is kept
+                        let Some(path) = e.path() else {
+                            return Ok(Arc::new(()));
+                        };
+                        unreadable.push(path.to_path_buf());
+                        continue;
+                    }
+                };
+                if entry.depth == 0 {
+                    continue;
+                }
+                let file_type = entry.file_type();
+                let is_dir = file_type.is_dir() || (file_type.is_symlink() && entry.path().is_dir());
+                if file_type.is_dir() {
+                    listings.entry(listing_key(&entry.path().to_string_lossy())).or_default();
+                }
+                let parent = listing_key(&entry.parent_path().to_string_lossy());
+                listings.entry(parent).or_default().push(DirEntry {
+                    name: entry.file_name().to_string_lossy().into_owned(),
+                    is_dir,
+                });
+            }
+            // The error is either for the directory itself or for one of its entries
+            for path in &unreadable {
+                listings.remove(&listing_key(&path.to_string_lossy()));
+                if let Some(parent) = path.parent() {
+                    listings.remove(&listing_key(&parent.to_string_lossy()));
+                }
+            }
+            for (dir, entries) in listings {
+                let _ = self.listings.get_or_init(&dir, || Ok(entries.into()));
+            }
+            Ok(Arc::new(()))
+        });
+    }
+}
+
+impl GlobMatcher {
+    pub fn new(root: &Utf8Path, glob: &Glob) -> anyhow::Result<GlobMatcher> {
+        let full_pattern = |pattern: &String| root.join(pattern).as_str().replace('\\', "/");
+        let includes = glob
+            .includes
+            .iter()
+            .map(|pattern| IncludePattern::new(&full_pattern(pattern)))
+            .collect::<anyhow::Result<Vec<_>>>()?;
+        let excludes = glob
+            .excludes
+            .iter()
+            .map(|pattern| parse_tokens(&full_pattern(pattern), true))
+            .collect::<anyhow::Result<Vec<_>>>()?;
+        Ok(GlobMatcher { includes, excludes })
+    }
+
+    /// True if `path` is removed by one of the excludes.
+    pub fn is_excluded(&self, path: &str) -> bool {
+        self.excludes.iter().any(|tokens| match_tokens(tokens, path))
+    }
+
+    /// Every path matched by an include and not removed by an exclude, sorted and deduplicated.
+    fn expand(&self, cache: &GlobCache) -> anyhow::Result<Vec<Utf8PathBuf>> {
+        let mut paths = Vec::new();
+        for include in &self.includes {
+            if include.components.is_empty() {
+                // Entirely literal pattern
+                if Utf8Path::new(&include.base).exists() {
+                    paths.push(include.base.clone());
+                }
+            } else {
+                expand_components(cache, &include.base, &include.components, &mut paths)?;
+            }
+        }
+        paths.retain(|path| !self.is_excluded(path));
+        paths.sort_unstable();
+        paths.dedup();
+        Ok(paths.into_iter().map(Utf8PathBuf::from).collect())
+    }
+}
+
+impl IncludePattern {
+    fn new(pattern: &str) -> anyhow::Result<IncludePattern> {
+        let parts: Vec<&str> = pattern.split('/').collect();
+        let literal_len = parts.iter().position(|part| has_wildcard(part)).unwrap_or(parts.len());
+        let base = match parts[..literal_len].join("/") {
+            base if base.is_empty() && pattern.starts_with('/') => "/".to_owned(),
+            base => base,
+        };
+        let components = parts[literal_len..]
+            .iter()
+            .filter(|part| !part.is_empty())
+            .map(|part| match *part {
+                "**" => Ok(Component::AnyDirs),
+                part if has_wildcard(part) => Ok(Component::Wildcard(parse_tokens(part, false)?)),
+                part => Ok(Component::Literal(part.to_owned())),
+            })
+            .collect::<anyhow::Result<Vec<_>>>()?;
+        Ok(IncludePattern { base, components })
+    }
+}
+
+impl PatternToken {
+    fn matches(&self, c: char) -> bool {
+        match self {
+            PatternToken::Char(expected) => *expected == c,
+            PatternToken::AnyChar => true,
+            PatternToken::Class { negated, ranges } => {
+                ranges.iter().any(|(lo, hi)| (*lo..=*hi).contains(&c)) != *negated
+            }
+            PatternToken::AnySequence | PatternToken::AnyDirs => false,
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Private functions
+// ----------------------------------------------------------------------------
+fn has_wildcard(part: &str) -> bool {
+    part.contains(['*', '?', '['])
+}
+
+/// Cache key for a directory, so `dir`, `./dir` and `dir\` share one listing.
+fn listing_key(dir: &str) -> Utf8PathBuf {
+    let dir = dir.replace('\\', "/");
+    let dir = dir.strip_prefix("./").unwrap_or(&dir);
+    match dir.trim_end_matches('/') {
+        "" if dir.starts_with('/') => Utf8PathBuf::from("/"),
+        "" => Utf8PathBuf::from("."),
+        trimmed => Utf8PathBuf::from(trimmed),
+    }
+}
+
+fn dir_path(dir: &str) -> &str {
+    if dir.is_empty() {
+        "."
+    } else {
+        dir
+    }
+}
+
+fn join(dir: &str, name: &str) -> String {
+    match dir {
+        "" => name.to_owned(),
+        dir if dir.ends_with('/') => format!("{}{}", dir, name),
+        dir => format!("{}/{}", dir, name),
+    }
+}
+
+/// Appends everything under `dir` that matches `components` to `paths`.
+fn expand_components(
+    cache: &GlobCache,
+    dir: &str,
+    components: &[Component],
+    paths: &mut Vec<String>,
+) -> anyhow::Result<()> {
+    let Some((component, rest)) = components.split_first() else {
+        return Ok(());
+    };
+
+    match component {
+        Component::AnyDirs => {
+            cache.walk_tree(dir);
+            expand_any_dirs(cache, dir, rest, paths)?;
+        }
+        Component::Literal(name) => {
+            let path = join(dir, name);
+            if name == "." || name == ".." {
+                expand_components(cache, &path, rest, paths)?;
+            } else if let Some(entry) = cache.listing(dir)?.iter().find(|entry| entry.name == *name) {
+                if rest.is_empty() {
+                    paths.push(path);
+                } else if entry.is_dir {
+                    expand_components(cache, &path, rest, paths)?;
+                }
+            }
+        }
+        Component::Wildcard(tokens) => {
+            for entry in cache.listing(dir)?.iter().filter(|entry| match_tokens(tokens, &entry.name)) {
+                if rest.is_empty() {
+                    paths.push(join(dir, &entry.name));
+                } else if entry.is_dir {
+                    expand_components(cache, &join(dir, &entry.name), rest, paths)?;
+                }
+            }
+        }
+    }
+    Ok(())
+}
+
+/// Matches `rest` in `dir` and every directory below it.
+fn expand_any_dirs(
+    cache: &GlobCache,
+    dir: &str,
+    rest: &[Component],
+    paths: &mut Vec<String>,
+) -> anyhow::Result<()> {
+    if rest.is_empty() {
+        // Trailing `**` matches the directory itself and every directory below it
+        paths.push(dir.trim_end_matches('/').to_owned());
+    } else {
+        expand_components(cache, dir, rest, paths)?;
+    }
+    for entry in cache.listing(dir)?.iter().filter(|entry| entry.is_dir) {
+        expand_any_dirs(cache, &join(dir, &entry.name), rest, paths)?;
+    }
+    Ok(())
+}
+
+/// Parses one pattern into tokens. `whole_path` patterns are matched against a full path, where `**/`
+/// stands for any number of directories.
+fn parse_tokens(pattern: &str, whole_path: bool) -> anyhow::Result<Vec<PatternToken>> {
+    let mut tokens = Vec::new();
+    let mut chars = pattern.chars().peekable();
+    while let Some(c) = chars.next() {
+        match c {
+            '?' => tokens.push(PatternToken::AnyChar),
+            '*' => {
+                let mut stars = 1;
+                while chars.next_if_eq(&'*').is_some() {
+                    stars += 1;
+                }
+                let at_component_start = matches!(tokens.last(), None | Some(PatternToken::Char('/')));
+                if whole_path && stars == 2 && at_component_start && chars.next_if_eq(&'/').is_some() {
+                    tokens.push(PatternToken::AnyDirs);
+                } else if tokens.last() != Some(&PatternToken::AnySequence) {
+                    tokens.push(PatternToken::AnySequence);
+                }
+            }
+            '[' => {
+                let negated = chars.next_if_eq(&'!').is_some();
+                let mut ranges = Vec::new();
+                loop {
+                    let Some(lo) = chars.next() else {
+                        bail_loc!("Unterminated character class in glob pattern [{}]", pattern);
+                    };
+                    if lo == ']' && !ranges.is_empty() {
+                        break;
+                    }
+                    let mut hi = lo;
+                    if chars.peek() == Some(&'-') {
+                        chars.next();
+                        match chars.next() {
+                            Some(']') => {
+                                ranges.push((lo, lo));
+                                ranges.push(('-', '-'));
+                                break;
+                            }
+                            Some(end) => hi = end,
+                            None => bail_loc!("Unterminated character class in glob pattern [{}]", pattern),
+                        }
+                    }
+                    bail_loc_if!(lo > hi, "Invalid range [{}-{}] in glob pattern [{}]", lo, hi, pattern);
+                    ranges.push((lo, hi));
+                }
+                tokens.push(PatternToken::Class { negated, ranges });
+            }
+            c => tokens.push(PatternToken::Char(c)),
+        }
+    }
+    Ok(tokens)
+}
+
+fn match_tokens(tokens: &[PatternToken], text: &str) -> bool {
+    match tokens.split_first() {
+        None => text.is_empty(),
+        Some((PatternToken::AnySequence, rest)) => {
+            let mut starts = text.char_indices().map(|(i, _)| i).chain([text.len()]);
+            rest.is_empty() || starts.any(|i| match_tokens(rest, &text[i..]))
+        }
+        Some((PatternToken::AnyDirs, rest)) => {
+            let mut starts = text.match_indices('/').map(|(i, _)| i + 1);
+            match_tokens(rest, text) || starts.any(|i| match_tokens(rest, &text[i..]))
+        }
+        Some((token, rest)) => {
+            let mut chars = text.chars();
+            chars.next().is_some_and(|c| token.matches(c)) && match_tokens(rest, chars.as_str())
+        }
+    }
+}
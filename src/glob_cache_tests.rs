@@ -0,0 +1,237 @@
+//! Tests and benchmarks for glob_cache.rs
+
+use camino::{Utf8Path, Utf8PathBuf};
+use std::collections::HashMap;
+use std::sync::Arc;
+use std::time::Instant;
+
+use crate::glob_cache::*;
+use crate::papyrus::{collect_globs, read_papyrus_str, Glob};
+use crate::test_utils::scratch_dir;
+
+fn touch(root: &Utf8Path, relpaths: &[&str]) {
+    for relpath in relpaths {
+        let path = root.join(relpath);
+        std::fs::create_dir_all(path.parent().unwrap()).unwrap();
+        std::fs::write(path, "").unwrap();
+    }
+}
+
+fn glob(includes: &[&str], excludes: &[&str]) -> Glob {
+    Glob {
+        includes: includes.iter().map(|s| s.to_string()).collect(),
+        excludes: excludes.iter().map(|s| s.to_string()).collect(),
+    }
+}
+
+/// Expands `glob` under `root` and returns the matches relative to `root`.
+fn expand(cache: &GlobCache, root: &Utf8Path, glob: &Glob) -> anyhow::Result<Vec<String>> {
+    let paths = cache.expand(root, glob)?;
+    Ok(paths.iter().map(|p| p.strip_prefix(root).unwrap().to_string()).collect())
+}
+
+#[test]
+fn glob_syntax_matches_glob_crate() -> anyhow::Result<()> {
+    let root = scratch_dir("glob_cache_tests", "syntax");
+    touch(&root, &["src/a.c", "src/b.c", "src/x1.c", "src/.hidden.c", "src/main.cpp"]);
+    touch(&root, &["src/sub/c.c", "src/sub/deep/d.c"]);
+    let cache = GlobCache::default();
+
+    let matched = expand(&cache, &root, &glob(&["src/*.c"], &[]))?;
+    assert_eq!(matched, ["src/.hidden.c", "src/a.c", "src/b.c", "src/x1.c"]);
+    let matched = expand(&cache, &root, &glob(&["src/[ab].c", "src/?1.c"], &[]))?;
+    assert_eq!(matched, ["src/a.c", "src/b.c", "src/x1.c"]);
+    assert_eq!(expand(&cache, &root, &glob(&["src/[!a-b.]*.c"], &[]))?, ["src/x1.c"]);
+    assert_eq!(
+        expand(&cache, &root, &glob(&["src/**/*.c"], &["src/.*"]))?,
+        ["src/a.c", "src/b.c", "src/sub/c.c", "src/sub/deep/d.c", "src/x1.c"]
+    );
+    assert_eq!(expand(&cache, &root, &glob(&["**/deep"], &[]))?, ["src/sub/deep"]);
+    assert_eq!(expand(&cache, &root, &glob(&["src/sub/c.c", "src/missing.c"], &[]))?, ["src/sub/c.c"]);
+
+    // Overlapping includes are deduplicated, and a `*` in an exclude also crosses directories
+    assert_eq!(
+        expand(&cache, &root, &glob(&["src/*/*.c", "src/sub/**/*.c"], &["src/sub/d*"]))?,
+        ["src/sub/c.c"]
+    );
+    assert!(expand(&cache, &root, &glob(&["src/**/*.c"], &["src/**/c.c", "src/*.c"]))?.is_empty());
+
+    assert!(cache.expand(&root, &glob(&["src/[ab.c"], &[])).is_err());
+    assert!(cache.expand(&root, &glob(&["src/*.c"], &["src/[z-a].c"])).is_err());
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+#[test]
+fn listings_and_results_are_shared_per_build() -> anyhow::Result<()> {
+    let root = scratch_dir("glob_cache_tests", "shared");
+    touch(&root, &["src/a.c", "src/a.h"]);
+    let cache = GlobCache::default();
+
+    let sources = glob(&["src/*.c"], &[]);
+    let first = cache.expand(&root, &sources)?;
+    assert!(Arc::ptr_eq(&first, &cache.expand(&root, &sources)?));
+
+    // A file added mid-build isn't seen by a different glob over the same directory
+    touch(&root, &["src/b.h"]);
+    assert_eq!(expand(&cache, &root, &glob(&["src/*.h"], &[]))?, ["src/a.h"]);
+    assert_eq!(expand(&GlobCache::default(), &root, &glob(&["src/*.h"], &[]))?, ["src/a.h", "src/b.h"]);
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+#[test]
+fn expand_all_matches_sequential_expansion() -> anyhow::Result<()> {
+    let root = scratch_dir("glob_cache_tests", "parallel");
+    for lib in 0..16 {
+        touch(&root, &[&format!("lib{}/src/a.c", lib), &format!("lib{}/src/nested/b.c", lib)]);
+    }
+    let globs: Vec<Glob> = (0..16)
+        .flat_map(|lib| {
+            [
+                glob(&[&format!("lib{}/src/*.c", lib)], &[]),
+                glob(&[&format!("lib{}/**/*.c", lib)], &[&format!("lib{}/src/a.c", lib)]),
+            ]
+        })
+        .chain([glob(&["**/*.c"], &[])])
+        .collect();
+
+    let cache = GlobCache::default();
+    let requests: Vec<(&Utf8Path, &Glob)> = globs.iter().map(|glob| (root.as_path(), glob)).collect();
+    cache.expand_all(&requests);
+
+    for glob in &globs {
+        assert_eq!(cache.expand(&root, glob)?, GlobCache::default().expand(&root, glob)?);
+    }
+    assert_eq!(cache.expand(&root, &globs[32])?.len(), 32);
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+#[cfg(unix)]
+#[test]
+fn unreadable_directories_fail_recursive_globs() -> anyhow::Result<()> {
+    use std::os::unix::fs::PermissionsExt;
+
+    let root = scratch_dir("glob_cache_tests", "unreadable");
+    touch(&root, &["src/a.c", "src/locked/b.c"]);
+    let locked = root.join("src/locked");
+    std::fs::set_permissions(&locked, std::fs::Permissions::from_mode(0o000))?;
+
+    // Root ignores permissions, so only check when the directory really is unreadable
+    if std::fs::read_dir(&locked).is_err() {
+        assert!(GlobCache::default().expand(&root, &glob(&["src/**/*.c"], &[])).is_err());
+        assert_eq!(expand(&GlobCache::default(), &root, &glob(&["src/*.c"], &[]))?, ["src/a.c"]);
+    }
+
+    std::fs::set_permissions(&locked, std::fs::Permissions::from_mode(0o755))?;
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
+
+#[test]
+fn collect_globs_follows_taken_branches() -> anyhow::Result<()> {
+    let config = read_papyrus_str(
+        r#"
+        rule(
+            name = "app",
+            srcs = glob(["*.c"]) + select(
+                (platform) => {
+                    (windows) = glob(["win/*.c"]),
+                    default = glob(["posix/*.c"]),
+                }
+            ),
+            extra = multi_select(
+                (platform, arch) => {
+                    (linux, _) = glob(["linux/*.c"]),
+                    (_, x64) = glob(["x64/*.c"]),
+                    (macos, _) = glob(["macos/*.c"]),
+                    default = glob(["other/*.c"]),
+                }
+            ),
+        )
+        "#,
+        "test",
+    )?;
+    let collect = |platform: &str, arch: &str| {
+        let vars: HashMap<String, String> =
+            [("platform".to_owned(), platform.to_owned()), ("arch".to_owned(), arch.to_owned())].into();
+        let mut globs = Vec::new();
+        collect_globs(&config, &vars, &mut globs);
+        let mut includes: Vec<String> = globs.iter().map(|glob| glob.includes[0].clone()).collect();
+        includes.sort();
+        includes
+    };
+
+    assert_eq!(collect("linux", "x64"), ["*.c", "linux/*.c", "posix/*.c", "x64/*.c"]);
+    assert_eq!(collect("windows", "arm64"), ["*.c", "other/*.c", "win/*.c"]);
+
+    // Missing vars leave the select to fail during resolution
+    let mut globs = Vec::new();
+    collect_globs(&config, &HashMap::new(), &mut globs);
+    assert_eq!(globs.len(), 1);
+    Ok(())
+}
+
+/// Benchmark: expanding the globs of 500 libraries in four modes, one `glob::glob` walk per include
+/// versus a shared `GlobCache` expanded in parallel.
+/// Run with: cargo test --release bench_glob_expansion -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_glob_expansion() -> anyhow::Result<()> {
+    const LIBRARIES: usize = 500;
+    const FILES_PER_LIBRARY: usize = 40;
+    const MODES: usize = 4;
+
+    let root = scratch_dir("glob_cache_tests", "bench");
+    for lib in 0..LIBRARIES {
+        let files: Vec<String> = (0..FILES_PER_LIBRARY)
+            .flat_map(|file| ["c", "h"].map(|ext| format!("lib{}/src/file{}.{}", lib, file, ext)))
+            .collect();
+        touch(&root, &files.iter().map(String::as_str).collect::<Vec<_>>());
+    }
+    let globs: Vec<Glob> = (0..LIBRARIES)
+        .map(|lib| glob(&[&format!("lib{}/src/*.c", lib), &format!("lib{}/src/*.h", lib)], &["*/src/file0.c"]))
+        .collect();
+
+    let start = Instant::now();
+    let mut walked = 0;
+    for _ in 0..MODES {
+        for glob in &globs {
+            let mut paths = std::collections::HashSet::new();
+            for include in &glob.includes {
+                for entry in glob::glob(root.join(include).as_str())? {
+                    paths.insert(entry?.to_string_lossy().replace('\\', "/"));
+                }
+            }
+            let excludes = glob.excludes.iter().map(|e| glob::Pattern::new(root.join(e).as_str()));
+            let excludes = excludes.collect::<Result<Vec<_>, _>>()?;
+            walked += paths.into_iter().filter(|p| !excludes.iter().any(|e| e.matches(p))).count();
+        }
+    }
+    let per_include = start.elapsed();
+
+    let start = Instant::now();
+    let cache = GlobCache::default();
+    let mut cached = 0;
+    for _ in 0..MODES {
+        let requests: Vec<(&Utf8Path, &Glob)> = globs.iter().map(|glob| (root.as_path(), glob)).collect();
+        cache.expand_all(&requests);
+        for glob in &globs {
+            cached += cache.expand(&root, glob)?.len();
+        }
+    }
+    let shared = start.elapsed();
+
+    assert_eq!(walked, cached);
+    println!("{} globs x {} modes, {} matches each pass", LIBRARIES, MODES, cached / MODES);
+    println!("  glob::glob per include:  {:?}", per_include);
+    println!("  shared GlobCache:        {:?}", shared);
+    println!("  speedup:                 {:.1}x", per_include.as_secs_f64() / shared.as_secs_f64());
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
@@ -0,0 +1,305 @@
+//! Historical job durations for critical-path-first scheduling.
+//!
+//! `JobHistory` remembers, per job description, how long the job took and how long the chain
+//! of work it gated took (its remaining critical path). The job system uses the remaining
+//! path as the priority of a queued job, so a slow translation unit that gates the final link
+//! starts before hundreds of quick ones instead of after them.
+//!
+//! `JobTimeline` records one run: which jobs each job waited for, when it started, and how long
+//! it ran. When the run succeeds it computes the actual critical path, logs it next to the
+//! prediction, and folds the new measurements into the history.
+//!
+//! The history is a small binary file at `{root}/.anubis-build/.job_history`. It is loaded on
+//! first use and written back once at the end of a build.
+
+use crate::job_system::JobId;
+use crate::util::{self, format_duration, ByteReader};
+use crate::{bail_loc_if, function_name};
+use camino::Utf8PathBuf;
+use dashmap::DashMap;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, OnceLock};
+use std::time::{Duration, Instant};
+
+const HISTORY_MAGIC: &[u8; 4] = b"ANBH";
+const HISTORY_VERSION: u32 = 1;
+
+/// Priority of a job with no history. Unmeasured jobs go first: they are the ones most likely
+/// to turn into an unexpected tail.
+pub const UNKNOWN_PRIORITY: u64 = u64::MAX >> 1;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug, Default)]
+pub struct JobHistory {
+    path: Utf8PathBuf,
+    entries: OnceLock<DashMap<u64, JobEstimate>>,
+    dirty: AtomicBool,
+}
+
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct JobEstimate {
+    /// How long the job itself runs.
+    pub duration: Duration,
+
+    /// How long from the job starting until everything that waits on it has finished.
+    pub remaining: Duration,
+}
+
+/// Dependency edges and durations of a single job system run.
+#[derive(Debug)]
+pub struct JobTimeline {
+    history: Arc<JobHistory>,
+    start: Instant,
+    preds: DashMap<JobId, JobPreds>,
+    finished: DashMap<JobId, FinishedJob>,
+
+    /// Deferred job -> the continuation whose completion finished it.
+    finished_by: DashMap<JobId, JobId>,
+}
+
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct CriticalPath {
+    /// The largest remaining path recorded for any of this run's root jobs, if all were known.
+    pub predicted: Option<Duration>,
+    pub actual: Duration,
+    pub jobs: Vec<String>,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Clone, Debug, Default)]
+struct JobPreds {
+    /// Jobs whose results this job waited for.
+    deps: Vec<JobId>,
+    /// The job that queued this one. Unlike a dep, only its start matters, not its (possibly deferred) result.
+    spawner: Option<JobId>,
+}
+
+#[derive(Debug)]
+struct FinishedJob {
+    desc: String,
+    started: Duration,
+    duration: Duration,
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl JobHistory {
+    pub fn new(path: Utf8PathBuf) -> JobHistory {
+        JobHistory {
+            path,
+            entries: Default::default(),
+            dirty: AtomicBool::new(false),
+        }
+    }
+
+    pub fn estimate(&self, desc: &str) -> Option<JobEstimate> {
+        self.entries().get(&history_key(desc)).map(|e| *e)
+    }
+
+    /// Folds a new measurement into the estimate for `desc`. Each field keeps the larger of the
+    /// new value and 7/8 of the old one, so no-op and cached builds slowly age an estimate
+    /// instead of erasing what a real rebuild costs.
+    pub fn update(&self, desc: &str, measured: JobEstimate) {
+        let decay = |old: Duration, new: Duration| new.max(old * 7 / 8);
+        let mut entry = self.entries().entry(history_key(desc)).or_insert(measured);
+        entry.duration = decay(entry.duration, measured.duration);
+        entry.remaining = decay(entry.remaining, measured.remaining);
+        self.dirty.store(true, Ordering::Relaxed);
+    }
+
+    /// Scheduling priority for a job: its remaining critical path in microseconds.
+    pub fn priority(&self, desc: &str) -> u64 {
+        self.estimate(desc).map_or(UNKNOWN_PRIORITY, |e| (e.remaining.as_micros() as u64).min(UNKNOWN_PRIORITY - 1))
+    }
+
+    /// Writes the history back to disk if anything changed since it was loaded.
+    pub fn save(&self) -> anyhow::Result<()> {
+        if !self.dirty.swap(false, Ordering::Relaxed) {
+            return Ok(());
+        }
+
+        let entries = self.entries();
+        let mut bytes: Vec<u8> = Vec::with_capacity(12 + entries.len() * 24);
+        bytes.extend(HISTORY_MAGIC);
+        bytes.extend(HISTORY_VERSION.to_le_bytes());
+        bytes.extend((entries.len() as u32).to_le_bytes());
+        for entry in entries.iter() {
+            bytes.extend(entry.key().to_le_bytes());
+            bytes.extend((entry.duration.as_micros() as u64).to_le_bytes());
+            bytes.extend((entry.remaining.as_micros() as u64).to_le_bytes());
+        }
+        util::write_atomic(&self.path, &bytes)
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries().len()
+    }
+
+    fn entries(&self) -> &DashMap<u64, JobEstimate> {
+        self.entries.get_or_init(|| match std::fs::read(&self.path) {
+            Ok(bytes) => decode_history(&bytes).unwrap_or_else(|e| {
+                tracing::warn!("Ignoring unreadable job history [{}]: {}", self.path, e);
+                Default::default()
+            }),
+            Err(_) => Default::default(),
+        })
+    }
+}
+
+impl JobTimeline {
+    pub fn new(history: Arc<JobHistory>) -> JobTimeline {
+        JobTimeline {
+            history,
+            start: Instant::now(),
+            preds: Default::default(),
+            finished: Default::default(),
+            finished_by: Default::default(),
+        }
+    }
+
+    pub fn priority(&self, desc: &str) -> u64 {
+        self.history.priority(desc)
+    }
+
+    /// Records that `job_id` can't start before `deps` finish and, if it was queued by a
+    /// running job, before `spawner` started.
+    pub fn add_job(&self, job_id: JobId, deps: &[JobId], spawner: Option<JobId>) {
+        self.preds.insert(job_id, JobPreds { deps: deps.to_vec(), spawner });
+    }
+
+    /// Records that a job's function ran, whether it succeeded or deferred.
+    pub fn job_ran(&self, job_id: JobId, desc: &str, started: Instant, duration: Duration) {
+        self.finished.insert(
+            job_id,
+            FinishedJob {
+                desc: desc.to_owned(),
+                started: started.saturating_duration_since(self.start),
+                duration,
+            },
+        );
+    }
+
+    /// Records that deferred job `job_id` got its result from `continuation_id`.
+    pub fn finished_by(&self, job_id: JobId, continuation_id: JobId) {
+        self.finished_by.insert(job_id, continuation_id);
+    }
+
+    /// Computes the critical path of this run and folds every job's measurements into the history.
+    pub fn finish(&self) -> CriticalPath {
+        // A job started after all of its preds, so visiting in reverse start order sees every
+        // successor before the job itself
+        let mut order: Vec<JobId> = self.finished.iter().map(|f| *f.key()).collect();
+        order.sort_by_key(|id| std::cmp::Reverse(self.finished.get(id).map(|f| f.started)));
+
+        let mut successors: HashMap<JobId, Vec<JobId>> = Default::default();
+        let mut roots: Vec<JobId> = Default::default();
+        for &job_id in &order {
+            let preds = self.preds.get(&job_id).map(|p| p.clone()).unwrap_or_default();
+            if preds.deps.is_empty() && preds.spawner.is_none() {
+                roots.push(job_id);
+            }
+            let deps = preds.deps.iter().map(|&dep| self.resolve(dep));
+            for pred in deps.chain(preds.spawner) {
+                successors.entry(pred).or_default().push(job_id);
+            }
+        }
+
+        // remaining[job] = (length of the longest chain starting at job, next job on that chain)
+        let mut remaining: HashMap<JobId, (Duration, Option<JobId>)> = Default::default();
+        for &job_id in &order {
+            let Some(job) = self.finished.get(&job_id) else {
+                continue;
+            };
+            let longest_successor = successors
+                .get(&job_id)
+                .into_iter()
+                .flatten()
+                .filter_map(|succ| remaining.get(succ).map(|(length, _)| (*length, *succ)))
+                .max();
+            let (tail, next) = longest_successor.map_or((Duration::ZERO, None), |(length, succ)| (length, Some(succ)));
+            remaining.insert(job_id, (job.duration + tail, next));
+        }
+
+        // Predict from the history as it was before this run
+        let predicted = roots
+            .iter()
+            .map(|root| self.finished.get(root).and_then(|f| self.history.estimate(&f.desc)).map(|e| e.remaining))
+            .try_fold(Duration::ZERO, |max, r| r.map(|r| max.max(r)));
+
+        let mut jobs = Vec::new();
+        let mut actual = Duration::ZERO;
+        let mut next = roots.iter().max_by_key(|root| remaining.get(root).map(|(length, _)| *length)).copied();
+        if let Some(root) = next {
+            actual = remaining[&root].0;
+        }
+        while let Some(job_id) = next {
+            jobs.push(self.finished.get(&job_id).map(|f| f.desc.clone()).unwrap_or_default());
+            next = remaining.get(&job_id).and_then(|(_, next)| *next);
+        }
+
+        for entry in self.finished.iter() {
+            let measured = JobEstimate {
+                duration: entry.duration,
+                remaining: remaining.get(entry.key()).map_or(entry.duration, |(length, _)| *length),
+            };
+            self.history.update(&entry.desc, measured);
+        }
+
+        CriticalPath { predicted, actual, jobs }
+    }
+
+    /// Follows a chain of deferrals to the job whose completion actually finished `job_id`.
+    fn resolve(&self, mut job_id: JobId) -> JobId {
+        while let Some(next) = self.finished_by.get(&job_id).map(|n| *n) {
+            job_id = next;
+        }
+        job_id
+    }
+}
+
+impl std::fmt::Display for CriticalPath {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        let predicted = self.predicted.map_or("unknown".to_owned(), format_duration);
+        write!(
+            f,
+            "predicted [{}], actual [{}] over [{}] jobs",
+            predicted,
+            format_duration(self.actual),
+            self.jobs.len()
+        )
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Private functions
+// ----------------------------------------------------------------------------
+fn history_key(desc: &str) -> u64 {
+    xxhash_rust::xxh3::xxh3_64(desc.as_bytes())
+}
+
+// Layout (all integers little-endian):
+//   magic[4] version:u32 count:u32 { key:u64 duration_us:u64 remaining_us:u64 }*
+fn decode_history(bytes: &[u8]) -> anyhow::Result<DashMap<u64, JobEstimate>> {
+    let mut r = ByteReader::new(bytes, "job history");
+    bail_loc_if!(r.take(4)? != HISTORY_MAGIC, "Bad job history magic");
+    let version = r.u32()?;
+    bail_loc_if!(version != HISTORY_VERSION, "Unsupported job history version [{}]", version);
+
+    let entries: DashMap<u64, JobEstimate> = Default::default();
+    for _ in 0..r.u32()? {
+        let key = r.u64()?;
+        let estimate = JobEstimate {
+            duration: Duration::from_micros(r.u64()?),
+            remaining: Duration::from_micros(r.u64()?),
+        };
+        entries.insert(key, estimate);
+    }
+    r.finish()?;
+    Ok(entries)
+}
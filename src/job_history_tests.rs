@@ -0,0 +1,95 @@
+//! Tests for job_history.rs
+
+use camino::Utf8PathBuf;
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+use crate::assert_ok;
+use crate::job_history::*;
+use crate::test_utils::scratch_dir;
+
+fn ms(n: u64) -> Duration {
+    Duration::from_millis(n)
+}
+
+fn estimate(duration: u64, remaining: u64) -> JobEstimate {
+    JobEstimate {
+        duration: ms(duration),
+        remaining: ms(remaining),
+    }
+}
+
+#[test]
+fn history_update_decays_towards_smaller_measurements() {
+    let history = JobHistory::new(Utf8PathBuf::from("unused"));
+    assert_eq!(history.estimate("compile foo.cpp"), None);
+    assert_eq!(history.priority("compile foo.cpp"), UNKNOWN_PRIORITY);
+
+    history.update("compile foo.cpp", estimate(800, 1600));
+    assert_eq!(history.estimate("compile foo.cpp"), Some(estimate(800, 1600)));
+    assert_eq!(history.priority("compile foo.cpp"), 1_600_000);
+
+    // A cached rebuild only ages the estimate
+    history.update("compile foo.cpp", estimate(1, 2));
+    assert_eq!(history.estimate("compile foo.cpp"), Some(estimate(700, 1400)));
+
+    // A slower build takes effect immediately
+    history.update("compile foo.cpp", estimate(2000, 3000));
+    assert_eq!(history.estimate("compile foo.cpp"), Some(estimate(2000, 3000)));
+}
+
+#[test]
+fn history_save_and_reload() {
+    let dir = scratch_dir("job_history_tests", "reload");
+    let path = dir.join(".job_history");
+
+    let history = JobHistory::new(path.clone());
+    history.update("a", estimate(10, 30));
+    history.update("b", estimate(20, 20));
+    assert_ok!(history.save());
+
+    let reloaded = JobHistory::new(path.clone());
+    assert_eq!(reloaded.len(), 2);
+    assert_eq!(reloaded.estimate("a"), Some(estimate(10, 30)));
+    assert_eq!(reloaded.estimate("b"), Some(estimate(20, 20)));
+
+    // A corrupt history is ignored rather than failing the build
+    std::fs::write(&path, "garbage").unwrap();
+    assert_eq!(JobHistory::new(path).len(), 0);
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn timeline_finds_critical_path_and_updates_history() {
+    let history = Arc::new(JobHistory::new(Utf8PathBuf::from("unused")));
+
+    // root spawns slow and fast, then defers to link which waits on both. install waits on root.
+    let timeline = JobTimeline::new(history.clone());
+    let t0 = Instant::now();
+    timeline.add_job(0, &[], None);
+    timeline.add_job(1, &[], Some(0));
+    timeline.add_job(2, &[], Some(0));
+    timeline.add_job(3, &[1, 2], Some(0));
+    timeline.add_job(4, &[0], None);
+    timeline.job_ran(0, "root", t0, ms(1));
+    timeline.job_ran(1, "slow", t0 + ms(1), ms(40));
+    timeline.job_ran(2, "fast", t0 + ms(1), ms(5));
+    timeline.job_ran(3, "link", t0 + ms(41), ms(10));
+    timeline.finished_by(0, 3);
+    timeline.job_ran(4, "install", t0 + ms(51), ms(2));
+
+    let critical_path = timeline.finish();
+    assert_eq!(critical_path.predicted, None);
+    assert_eq!(critical_path.actual, ms(53));
+    assert_eq!(critical_path.jobs, vec!["root", "slow", "link", "install"]);
+    assert_eq!(history.estimate("slow"), Some(estimate(40, 52)));
+    assert_eq!(history.estimate("fast"), Some(estimate(5, 17)));
+    assert_eq!(history.estimate("install"), Some(estimate(2, 2)));
+
+    // The next run predicts from the recorded root
+    let timeline = JobTimeline::new(history.clone());
+    timeline.add_job(0, &[], None);
+    timeline.job_ran(0, "root", Instant::now(), ms(1));
+    assert_eq!(timeline.finish().predicted, Some(ms(53)));
+}
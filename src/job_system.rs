@@ -1,20 +1,23 @@
 use anyhow::Context;
-use crossbeam::channel::RecvTimeoutError;
-use dashmap::DashMap;
 use downcast_rs::{impl_downcast, DowncastSync};
 use std::any::Any;
-use std::collections::{HashMap, HashSet};
+use std::cell::{Cell, RefCell};
+use std::collections::{BinaryHeap, HashMap};
 use std::fmt::Debug;
-use std::sync::atomic::{AtomicBool, AtomicI64, AtomicU8, AtomicUsize, Ordering};
-use std::sync::{Arc, Mutex};
-use std::time::Duration;
+use std::process::Command;
+use std::sync::atomic::{AtomicBool, AtomicI64, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
 
 use crate::anubis::ArcResult;
 use crate::function_name;
+use crate::job_history::{JobHistory, JobTimeline};
+use crate::job_tokens::{JobToken, JobTokens};
+use crate::memory_budget::{self, MemoryBudget};
+use crate::process_reactor::{self, ChildExit};
 use crate::progress::ProgressEvent;
-use crate::util::format_duration;
+use crate::util::{format_bytes, format_duration};
 use crate::{anubis, job_system, toolchain};
-use crate::{anyhow_loc, anyhow_with_context, bail_loc, bail_with_context, timed_span};
+use crate::{anyhow_loc, anyhow_with_context, bail_loc, bail_loc_if, bail_with_context, timed_span};
 
 // ----------------------------------------------------------------------------
 // Declarations
@@ -23,6 +26,9 @@ use crate::{anyhow_loc, anyhow_with_context, bail_loc, bail_with_context, timed_
 // ID for jobs
 pub type JobId = i64;
 
+/// Tracing target of per-job tool resource usage events. Recorded in profiles, kept off the console.
+pub const JOB_USAGE_TARGET: &str = "job_usage";
+
 // Function that does the actual work of a job
 pub type JobFn = dyn FnOnce(Job) -> anyhow::Result<JobOutcome> + Send + Sync + 'static;
 
@@ -68,37 +74,159 @@ pub struct Job {
     pub display: JobDisplayInfo,
     pub ctx: Arc<JobContext>,
     pub job_fn: Option<Box<JobFn>>,
+    /// Estimated peak memory in bytes, admitted against the job system's memory budget.
+    pub memory: u64,
+    /// Runs on the thread that finishes its last dep instead of going through a queue, and sends
+    /// no progress events. Only for jobs that do no real work, like markers and aggregations.
+    pub inline: bool,
+}
+
+/// A job whose own function returned an error.
+#[derive(Clone, Debug)]
+pub struct JobFailure {
+    pub job_id: JobId,
+    pub desc: String,
+    pub display: JobDisplayInfo,
+    pub error: String,
 }
 
 // Central hub for JobSystem
 pub struct JobSystem {
     pub next_id: Arc<AtomicI64>,
     pub(crate) abort_flag: AtomicBool,
-    pub(crate) blocked_jobs: DashMap<JobId, Job>,
-    job_graph: Arc<Mutex<JobGraph>>,
-    pub(crate) job_results: DashMap<JobId, anyhow::Result<Arc<dyn JobArtifact>>>,
-    /// Maps continuation job IDs to original job IDs for result propagation.
-    /// When a continuation job completes, its result is copied to the original job.
-    result_propagation: DashMap<JobId, JobId>,
-    tx: crossbeam::channel::Sender<Job>,
-    rx: crossbeam::channel::Receiver<Job>,
+    /// Per-job state indexed by id. Ids are handed out sequentially by `next_id`, so this stays dense.
+    slots: JobArena<JobSlot>,
+    /// Successor edges, linked into per-job lists starting at `JobSlot::successors`.
+    edges: JobArena<SuccessorEdge>,
+    next_edge: AtomicU64,
+    num_results: AtomicUsize,
+    num_blocked: AtomicUsize,
+    /// Jobs that failed, so error reporting doesn't have to visit every slot.
+    failed_jobs: Mutex<Vec<JobId>>,
+    /// Jobs whose own function failed, as opposed to jobs failed by a dep or by an abort.
+    failures: Mutex<Vec<JobFailure>>,
+    /// Keep-going: a failure only fails the jobs that depend on it instead of aborting the run.
+    keep_going: bool,
+    /// Keep-going: jobs that never ran because a dep failed.
+    num_skipped: AtomicUsize,
+    /// Jobs that are queued or running. Blocked jobs are not counted: they can only be queued
+    /// by a running job, so the run is over the moment this reaches zero.
+    active_jobs: AtomicUsize,
+    /// Set when the current run finishes or aborts so parked workers exit.
+    shutdown: AtomicBool,
+    parker: WorkerParker,
+    /// Seeds and jobs queued from outside a worker. Jobs queued by a running job go to that
+    /// worker's own queue instead, and idle workers steal from both.
+    injector: JobQueue,
+    /// Tie-breaker so equal-priority jobs run in the order they were queued.
+    next_seq: AtomicU64,
+    /// Present when built with history: orders jobs by remaining critical path and records this run.
+    timeline: Option<JobTimeline>,
+    /// Present when sharing a make jobserver: each running job holds one of its tokens.
+    tokens: Option<Arc<JobTokens>>,
+    /// Present when limiting memory: jobs only start while their estimates fit.
+    memory: Option<MemoryBudget>,
+    /// Tools started with `spawn_tool` that haven't been settled, with what they took over from
+    /// the job that started them.
+    tools: Mutex<HashMap<JobId, ToolHold>>,
+    /// Most tools in flight at once. Defaults to the number of workers of the run.
+    tool_limit: Option<usize>,
+    tool_slots: ToolSlots,
+}
+
+/// A tool's share of the worker resources of the job that started it.
+struct ToolHold {
+    token: Option<JobToken>,
+    memory: u64,
+    /// The job handing these over and the tool exiting. Whichever happens last releases them.
+    pending: u8,
+}
+
+/// Counts tools in flight against a limit, so deferring on tools can't start every compile at once.
+#[derive(Default)]
+struct ToolSlots {
+    limit: AtomicUsize,
+    running: Mutex<usize>,
+    cvar: Condvar,
+}
+
+/// Lets idle workers sleep until a job is queued or the run ends, instead of polling the queue.
+#[derive(Default)]
+struct WorkerParker {
+    sleepers: AtomicUsize,
+    lock: Mutex<()>,
+    cvar: Condvar,
+}
+
+/// Runnable jobs ordered by priority (estimated remaining critical path), highest first.
+/// `top` mirrors the best queued priority plus one (zero when empty) so idle workers can pick
+/// the most urgent queue without locking every one of them.
+#[derive(Default)]
+struct JobQueue {
+    heap: Mutex<BinaryHeap<QueuedJob>>,
+    top: AtomicU64,
+}
+
+struct QueuedJob {
+    priority: u64,
+    seq: u64,
+    job: Job,
 }
 
-// JobInfo: defines the "graph" of job dependencies
+/// A worker's own queue. Lives in a thread local so jobs spawned by a running job fn
+/// (e.g. compile jobs created by a binary rule) are queued without contending with other workers.
+struct LocalQueue {
+    owner: *const JobSystem,
+    queue: Arc<JobQueue>,
+    running: Cell<Option<JobId>>,
+    /// Tool started by the running job, whose token and memory it takes over when the job returns.
+    spawned_tool: Cell<Option<JobId>>,
+}
+
+thread_local! {
+    static LOCAL_QUEUE: RefCell<Option<LocalQueue>> = const { RefCell::new(None) };
+}
+
+/// Identifies the job system whose worker is running on this thread, or 0 off the worker pool.
+/// Child processes are tagged with it so an abort only kills its own run's tools.
+pub(crate) fn current_job_system() -> usize {
+    LOCAL_QUEUE.with(|local| local.borrow().as_ref().map_or(0, |l| l.owner as usize))
+}
+
+/// Append-only segmented vector indexed by job id. Segment `n` holds `1024 << n` entries and is
+/// allocated on first touch, so entries never move and a lookup is a few shifts and an index.
+struct JobArena<T> {
+    segments: [OnceLock<Box<[T]>>; ARENA_SEGMENTS],
+}
+
+const ARENA_FIRST_SEGMENT_BITS: u32 = 10;
+const ARENA_SEGMENTS: usize = 40;
+
+/// Everything the job system tracks about one job.
 #[derive(Default)]
-struct JobGraphNode {
-    job_id: JobId,
-    finished: bool,
-    depends_on: HashSet<JobId>,
-    blocks: HashSet<JobId>,
+struct JobSlot {
+    result: OnceLock<anyhow::Result<Arc<dyn JobArtifact>>>,
+    /// For a continuation: the original job id + 1, whose result is copied from this one. Zero if none.
+    propagate_to: AtomicI64,
+    /// The job itself while it waits for deps. Boxed to keep slots small.
+    blocked: Mutex<Option<Box<Job>>>,
+    /// Deps that haven't finished. Unblocking a dependent is a single `fetch_sub`.
+    pending: AtomicUsize,
+    /// Head of the lock-free list of jobs waiting on this one: zero when empty,
+    /// `SUCCESSORS_CLOSED` once the job finished, otherwise an index into `edges` + 1.
+    successors: AtomicU64,
+    /// The job that was running when this one was added, + 1. Zero for jobs added from outside a worker.
+    spawner: AtomicI64,
 }
 
 #[derive(Default)]
-struct JobGraph {
-    blocked_by: HashMap<JobId, HashSet<JobId>>,
-    blocks: HashMap<JobId, HashSet<JobId>>,
+struct SuccessorEdge {
+    job_id: AtomicI64,
+    next: AtomicU64,
 }
 
+const SUCCESSORS_CLOSED: u64 = u64::MAX;
+
 pub struct JobGraphEdge {
     pub blocked: JobId,
     pub blocker: JobId,
@@ -118,16 +246,11 @@ pub struct JobContext {
     pub toolchain: Option<Arc<toolchain::Toolchain>>,
 }
 
-// Context obj for workers
-#[derive(Clone)]
-pub struct WorkerContext {
-    pub sender: crossbeam::channel::Sender<Job>,
-    pub receiver: crossbeam::channel::Receiver<Job>,
-}
-
 // ----------------------------------------------------------------------------
 // Implementations
 // ----------------------------------------------------------------------------
+impl JobArtifact for ChildExit {}
+
 impl std::fmt::Debug for Job {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         f.debug_struct("Job").field("id", &self.id).field("desc", &self.desc).finish()
@@ -139,9 +262,11 @@ impl Job {
         Job {
             id,
             desc,
+            memory: memory_budget::estimate_for_verb(display.verb),
             display,
             ctx,
             job_fn: Some(job_fn),
+            inline: false,
         }
     }
 
@@ -165,6 +290,14 @@ impl JobContext {
         Job::new(self.get_next_id(), desc, display, self.clone(), f)
     }
 
+    /// Creates a job that runs inline when its deps finish. See `Job::inline`.
+    pub fn new_inline_job(self: &Arc<JobContext>, desc: String, display: JobDisplayInfo, f: Box<JobFn>) -> Job {
+        Job {
+            inline: true,
+            ..self.new_job(desc, display, f)
+        }
+    }
+
     pub fn new_job_with_id(self: &Arc<JobContext>, id: i64, desc: String, display: JobDisplayInfo, f: Box<JobFn>) -> Job {
         assert!(id < self.job_system.next_id.load(Ordering::SeqCst));
         Job::new(id, desc, display, self.clone(), f)
@@ -184,27 +317,221 @@ impl dyn JobArtifact {
     }
 }
 
+impl WorkerParker {
+    /// Wakes one parked worker, if any. Called after every enqueue.
+    fn notify_one(&self) {
+        // Pairs with the increment in `park_until`: either this load sees the sleeper,
+        // or the sleeper's re-check sees the newly queued job
+        std::sync::atomic::fence(Ordering::SeqCst);
+        if self.sleepers.load(Ordering::SeqCst) > 0 {
+            let _guard = self.lock.lock().unwrap();
+            self.cvar.notify_one();
+        }
+    }
+
+    fn notify_all(&self) {
+        let _guard = self.lock.lock().unwrap();
+        self.cvar.notify_all();
+    }
+
+    /// Parks the calling worker until `ready` returns true.
+    fn park_until(&self, ready: impl Fn() -> bool) {
+        let mut guard = self.lock.lock().unwrap();
+        self.sleepers.fetch_add(1, Ordering::SeqCst);
+        std::sync::atomic::fence(Ordering::SeqCst);
+        while !ready() {
+            guard = self.cvar.wait(guard).unwrap();
+        }
+        self.sleepers.fetch_sub(1, Ordering::SeqCst);
+    }
+}
+
+impl<T: Default> JobArena<T> {
+    /// Returns the entry at `index`, allocating its segment if needed.
+    fn get(&self, index: u64) -> &T {
+        let (segment, offset) = Self::locate(index);
+        let entries = self.segments[segment].get_or_init(|| {
+            let len = 1usize << (segment as u32 + ARENA_FIRST_SEGMENT_BITS);
+            (0..len).map(|_| T::default()).collect()
+        });
+        &entries[offset]
+    }
+
+    /// Returns the entry at `index` if its segment was ever touched.
+    fn try_get(&self, index: u64) -> Option<&T> {
+        let (segment, offset) = Self::locate(index);
+        self.segments.get(segment)?.get().map(|entries| &entries[offset])
+    }
+
+    /// Every allocated entry with its index.
+    fn iter(&self) -> impl Iterator<Item = (u64, &T)> {
+        self.segments.iter().enumerate().flat_map(|(segment, entries)| {
+            let first = (1u64 << (segment as u32 + ARENA_FIRST_SEGMENT_BITS)) - (1 << ARENA_FIRST_SEGMENT_BITS);
+            entries.get().into_iter().flat_map(move |e| e.iter().enumerate().map(move |(i, t)| (first + i as u64, t)))
+        })
+    }
+
+    fn locate(index: u64) -> (usize, usize) {
+        let biased = index + (1 << ARENA_FIRST_SEGMENT_BITS);
+        let segment = 63 - biased.leading_zeros() - ARENA_FIRST_SEGMENT_BITS;
+        (segment as usize, (biased - (1 << (segment + ARENA_FIRST_SEGMENT_BITS))) as usize)
+    }
+}
+
+impl<T> Default for JobArena<T> {
+    fn default() -> Self {
+        JobArena {
+            segments: std::array::from_fn(|_| OnceLock::new()),
+        }
+    }
+}
+
+impl ToolSlots {
+    /// Blocks until another tool may start. Fails if the run aborts while waiting.
+    fn acquire(&self, abort_flag: &AtomicBool) -> anyhow::Result<()> {
+        let mut running = self.running.lock().unwrap();
+        while *running >= self.limit.load(Ordering::SeqCst).max(1) {
+            bail_loc_if!(
+                abort_flag.load(Ordering::SeqCst),
+                "Job system aborted while waiting to start a tool"
+            );
+            running = self.cvar.wait(running).unwrap();
+        }
+        *running += 1;
+        Ok(())
+    }
+
+    fn release(&self) {
+        *self.running.lock().unwrap() -= 1;
+        self.cvar.notify_one();
+    }
+
+    /// Wakes every waiter so it can notice an abort.
+    fn notify_all(&self) {
+        let _guard = self.running.lock().unwrap();
+        self.cvar.notify_all();
+    }
+}
+
+impl JobQueue {
+    fn push(&self, queued: QueuedJob) {
+        let mut heap = self.heap.lock().unwrap();
+        heap.push(queued);
+        self.update_top(&heap);
+    }
+
+    fn pop(&self) -> Option<Job> {
+        let mut heap = self.heap.lock().unwrap();
+        let queued = heap.pop()?;
+        self.update_top(&heap);
+        Some(queued.job)
+    }
+
+    fn is_empty(&self) -> bool {
+        self.top.load(Ordering::SeqCst) == 0
+    }
+
+    fn update_top(&self, heap: &BinaryHeap<QueuedJob>) {
+        self.top.store(heap.peek().map_or(0, |q| q.priority + 1), Ordering::SeqCst);
+    }
+}
+
+// Highest priority first, then the job queued earliest
+impl Ord for QueuedJob {
+    fn cmp(&self, other: &Self) -> std::cmp::Ordering {
+        self.priority.cmp(&other.priority).then_with(|| other.seq.cmp(&self.seq))
+    }
+}
+
+impl PartialOrd for QueuedJob {
+    fn partial_cmp(&self, other: &Self) -> Option<std::cmp::Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl PartialEq for QueuedJob {
+    fn eq(&self, other: &Self) -> bool {
+        self.cmp(other) == std::cmp::Ordering::Equal
+    }
+}
+
+impl Eq for QueuedJob {}
+
 impl JobSystem {
     // ----------------------------------------------------
     // public methods
     // ----------------------------------------------------
     pub fn new() -> Self {
-        let (tx, rx) = crossbeam::channel::unbounded::<Job>();
         JobSystem {
             next_id: Default::default(),
             abort_flag: Default::default(),
-            blocked_jobs: Default::default(),
-            job_graph: Default::default(),
-            job_results: Default::default(),
-            result_propagation: Default::default(),
-            tx,
-            rx,
+            slots: Default::default(),
+            edges: Default::default(),
+            next_edge: Default::default(),
+            num_results: Default::default(),
+            num_blocked: Default::default(),
+            failed_jobs: Default::default(),
+            failures: Default::default(),
+            keep_going: false,
+            num_skipped: Default::default(),
+            active_jobs: Default::default(),
+            shutdown: Default::default(),
+            parker: Default::default(),
+            injector: Default::default(),
+            next_seq: Default::default(),
+            timeline: None,
+            tokens: None,
+            memory: None,
+            tools: Default::default(),
+            tool_limit: None,
+            tool_slots: Default::default(),
+        }
+    }
+
+    /// Creates a job system that schedules the longest remaining critical path first, using
+    /// durations from previous builds, and records this run's durations back into `history`.
+    pub fn with_history(history: Arc<JobHistory>) -> Self {
+        JobSystem {
+            timeline: Some(JobTimeline::new(history)),
+            ..JobSystem::new()
+        }
+    }
+
+    /// Limits running jobs to the tokens this process can get from a make jobserver.
+    pub fn with_tokens(self, tokens: Option<Arc<JobTokens>>) -> Self {
+        JobSystem { tokens, ..self }
+    }
+
+    /// Keeps running every job that doesn't depend on a failure, instead of aborting on the first one.
+    pub fn with_keep_going(self, keep_going: bool) -> Self {
+        JobSystem { keep_going, ..self }
+    }
+
+    /// Allows at most `tools` tools started with `spawn_tool` to run at once, instead of one per worker.
+    pub fn with_tool_limit(self, tools: usize) -> Self {
+        JobSystem {
+            tool_limit: Some(tools),
+            ..self
+        }
+    }
+
+    /// Only starts jobs while the memory estimates of all running jobs fit in `bytes`.
+    pub fn with_memory_budget(self, bytes: Option<u64>) -> Self {
+        JobSystem {
+            memory: bytes.map(MemoryBudget::new),
+            ..self
         }
     }
 
     pub fn add_job(&self, job: Job) -> anyhow::Result<()> {
         tracing::trace!("Adding job [{}] [{}]", job.id, &job.desc);
-        Ok(self.tx.send(job)?)
+        let spawner = self.running_job();
+        self.slot(job.id).spawner.store(spawner.map_or(0, |id| id + 1), Ordering::SeqCst);
+        if let Some(timeline) = &self.timeline {
+            timeline.add_job(job.id, &[], spawner);
+        }
+        self.enqueue(job);
+        Ok(())
     }
 
     pub fn add_job_with_deps(&self, job: Job, deps: &[JobId]) -> anyhow::Result<()> {
@@ -212,50 +539,54 @@ impl JobSystem {
 
         let job_id = job.id;
         let job_desc = job.desc.clone();
+        let spawner = self.running_job();
+        self.slot(job_id).spawner.store(spawner.map_or(0, |id| id + 1), Ordering::SeqCst);
+        if let Some(timeline) = &self.timeline {
+            timeline.add_job(job_id, deps, spawner);
+        }
 
-        // Update graph and insert into blocked_jobs atomically while holding the lock.
-        // This prevents a race condition where a completing dependency could try to
-        // unblock this job before it's been inserted into blocked_jobs.
-        let send_to_queue = {
-            let mut job_graph = self.job_graph.lock().unwrap();
-
-            let mut blocked = false;
-
-            // Update blocked_by
-            for &dep in deps {
-                // See if job we're blocked by has already finished
-                if let Some(dep_result) = self.job_results.get(&dep) {
-                    match dep_result.value() {
-                        Ok(_) => continue,
-                        Err(e) => bail_loc!(
-                            "Job [{}] can't be added because dep [{}] failed with [{}]",
-                            job_desc,
-                            dep,
-                            e
-                        ),
-                    }
+        // Reject the job up front if a dep already failed. With keep-going it's skipped instead,
+        // the same as if the dep had failed after the job was added.
+        for &dep in deps {
+            if let Some(Err(e)) = self.result(dep) {
+                if self.keep_going {
+                    self.skip_job(job, dep);
+                    return Ok(());
                 }
-
-                blocked = true;
-                job_graph.blocks.entry(dep).or_default().insert(job_id);
-                job_graph.blocked_by.entry(job_id).or_default().insert(dep);
+                bail_loc!("Job [{}] can't be added because dep [{}] failed with [{}]", job_desc, dep, e);
             }
+        }
 
-            // Insert into blocked_jobs BEFORE releasing the lock to prevent race condition
-            if blocked {
-                self.blocked_jobs.insert(job_id, job);
-                None
-            } else {
-                Some(job)
+        // Park the job before registering with any dep, and hold one extra count while
+        // registering, so a dep that completes concurrently can never release it early
+        let slot = self.slot(job_id);
+        slot.pending.fetch_add(1, Ordering::SeqCst);
+        *slot.blocked.lock().unwrap() = Some(Box::new(job));
+        self.num_blocked.fetch_add(1, Ordering::SeqCst);
+        let mut failed_dep = None;
+        for &dep in deps {
+            if matches!(self.result(dep), Some(Ok(_))) {
+                continue;
+            }
+            slot.pending.fetch_add(1, Ordering::SeqCst);
+            if !self.push_successor(dep, job_id) {
+                // Finished since the check above
+                slot.pending.fetch_sub(1, Ordering::SeqCst);
+                if matches!(self.result(dep), Some(Err(_))) {
+                    failed_dep = Some(dep);
+                }
             }
-        };
-
-        // Send job to work queue if not blocked (after releasing the lock to avoid
-        // unnecessary contention on the channel send)
-        if let Some(job) = send_to_queue {
-            self.tx.send(job)?;
         }
-        Ok(())
+        if let (Some(dep), true) = (failed_dep, self.keep_going) {
+            // Unless another failed dep already skipped it
+            let Some(job) = slot.blocked.lock().unwrap().take() else {
+                return Ok(());
+            };
+            self.num_blocked.fetch_sub(1, Ordering::SeqCst);
+            self.skip_job(*job, dep);
+            return Ok(());
+        }
+        self.release(job_id)
     }
 
     pub fn run_to_completion(
@@ -264,201 +595,183 @@ impl JobSystem {
         progress_tx: crossbeam::channel::Sender<ProgressEvent>,
     ) -> anyhow::Result<()> {
         tracing::debug!("Starting job system with {} workers", num_workers);
+        if let Some(budget) = &job_sys.memory {
+            tracing::debug!("Memory budget for running jobs: {}", format_bytes(budget.total()));
+        }
 
         let execution_start = std::time::Instant::now();
-        let (tx, rx) = (job_sys.tx.clone(), job_sys.rx.clone());
+        let queues: Vec<Arc<JobQueue>> = (0..num_workers).map(|_| Default::default()).collect();
+        job_sys.tool_slots.limit.store(job_sys.tool_limit.unwrap_or(num_workers), Ordering::SeqCst);
 
-        let worker_context = WorkerContext {
-            sender: tx.clone(),
-            receiver: rx.clone(),
-        };
-
-        let idle_workers = Arc::new(AtomicUsize::new(0));
+        // Nothing queued means nothing can ever run. Blocked jobs are reported below.
+        job_sys.shutdown.store(job_sys.active_jobs.load(Ordering::SeqCst) == 0, Ordering::SeqCst);
 
         // Create N workers
         std::thread::scope(|scope| {
             for worker_id in 0..num_workers {
-                let worker_context = worker_context.clone();
-                let idle_workers = idle_workers.clone();
+                let queues = &queues;
                 let job_sys = job_sys.clone();
                 let progress_tx = progress_tx.clone();
 
                 scope.spawn(move || {
                     let _worker_span = tracing::info_span!("worker", id = worker_id).entered();
+                    LOCAL_QUEUE.with(|local| {
+                        *local.borrow_mut() = Some(LocalQueue {
+                            owner: Arc::as_ptr(&job_sys),
+                            queue: queues[worker_id].clone(),
+                            running: Cell::new(None),
+                            spawned_tool: Cell::new(None),
+                        })
+                    });
+
                     let maybe_error = || -> anyhow::Result<()> {
                         let mut idle = false;
+                        let mut rng = 0x9E37_79B9_7F4A_7C15u64 ^ (worker_id as u64 + 1);
+                        let set_running = |job_id| {
+                            LOCAL_QUEUE.with(|local| local.borrow().as_ref().map(|l| l.running.set(job_id)))
+                        };
 
                         // Loop until complete or abort
-                        while !job_sys.abort_flag.load(Ordering::SeqCst) {
+                        while !job_sys.abort_flag.load(Ordering::SeqCst) && !job_sys.shutdown.load(Ordering::SeqCst) {
                             // Get next job
-                            match worker_context.receiver.recv_timeout(Duration::from_millis(100)) {
-                                Ok(mut job) => {
-                                    // Clear idle flag if set
-                                    if idle {
-                                        idle = false;
-                                        idle_workers.fetch_sub(1, Ordering::SeqCst);
+                            let mut job = match job_sys.find_job(worker_id, queues, &mut rng) {
+                                Some(job) => job,
+                                None => {
+                                    if !idle {
+                                        idle = true;
+
+                                        // Notify progress display that this worker is idle
+                                        let _ = progress_tx.send(ProgressEvent::WorkerIdle { worker_id });
                                     }
 
-                                    // Execute job and store result
-                                    let job_id = job.id;
-                                    let job_desc = job.desc.clone();
-                                    let job_display = job.display.clone();
-                                    let job_fn = job.job_fn.take().ok_or_else(|| {
-                                        anyhow_loc!("Job [{}:{}] missing job fn", job.id, job.desc)
-                                    })?;
+                                    // Sleep until there is work or the run is over
+                                    job_sys.parker.park_until(|| {
+                                        !job_sys.injector.is_empty()
+                                            || queues.iter().any(|q| !q.is_empty())
+                                            || job_sys.shutdown.load(Ordering::SeqCst)
+                                            || job_sys.abort_flag.load(Ordering::SeqCst)
+                                    });
+                                    continue;
+                                }
+                            };
+                            idle = false;
+
+                            // Set aside jobs that don't fit in the memory budget. They are requeued
+                            // when a running job frees its share.
+                            if let Some(budget) = job_sys.memory.as_ref().filter(|_| job.memory > 0) {
+                                match budget.admit(job) {
+                                    Some(admitted) => job = admitted,
+                                    None => continue,
+                                }
+                            }
+
+                            // Execute job and store result
+                            let job_id = job.id;
+                            let job_memory = job.memory;
+                            let job_desc = job.desc.clone();
+                            let job_display = job.display.clone();
+                            let job_fn = job.job_fn.take().ok_or_else(|| {
+                                anyhow_loc!("Job [{}:{}] missing job fn", job.id, job.desc)
+                            })?;
+
+                            // Wait for a jobserver token so the whole process tree stays within its job limit
+                            let token = job_sys.tokens.as_ref().map(|tokens| tokens.acquire());
+
+                            // Notify progress display that this worker started a job
+                            let _ = progress_tx.send(ProgressEvent::JobStarted {
+                                worker_id,
+                                job_id,
+                                display: job_display.clone(),
+                            });
+
+                            let job_start = std::time::Instant::now();
+                            set_running(Some(job_id));
+                            process_reactor::take_thread_usage();
+                            let job_span = tracing::info_span!("job", id = job_id, desc = %job_desc);
+                            let job_result = job_span.in_scope(|| {
+                                tracing::debug!("Running job: [{}] {}", job_id, job_desc);
+                                job_fn(job)
+                            });
+                            let job_duration = std::time::Instant::now() - job_start;
+                            let job_usage = process_reactor::take_thread_usage();
+                            if let Some(usage) = &job_usage {
+                                // Lands on the job's span in the chrome trace
+                                tracing::trace!(
+                                    target: JOB_USAGE_TARGET,
+                                    parent: &job_span,
+                                    user_ms = usage.user_time.as_millis() as u64,
+                                    sys_ms = usage.system_time.as_millis() as u64,
+                                    max_rss_kib = usage.max_rss / 1024,
+                                    read_blocks = usage.read_blocks,
+                                    written_blocks = usage.written_blocks,
+                                    "Tool resource usage"
+                                );
+                            }
+                            // A tool the job started keeps its token and memory until it exits
+                            let spawned_tool = LOCAL_QUEUE
+                                .with(|local| local.borrow().as_ref().and_then(|l| l.spawned_tool.take()));
+                            match spawned_tool {
+                                Some(tool_id) => job_sys.settle_tool(tool_id, Some((token, job_memory))),
+                                None => {
+                                    drop(token);
+                                    job_sys.release_memory(job_memory);
+                                }
+                            }
+                            if let (Some(timeline), Ok(_)) = (&job_sys.timeline, &job_result) {
+                                timeline.job_ran(job_id, &job_desc, job_start, job_duration);
+                            }
+
+                            match job_result {
+                                Ok(JobOutcome::Deferred(deferral)) => {
+                                    let continuation_id = deferral.continuation_job.id;
+                                    tracing::trace!(
+                                        "Job [{}] [{}] deferred to continuation [{}] [{}], waiting for: {:?}",
+                                        job_id, &job_desc,
+                                        continuation_id, &deferral.continuation_job.desc,
+                                        deferral.blocked_by
+                                    );
+
+                                    // Notify progress: worker is now free (deferred job spawned children)
+                                    let _ = progress_tx.send(ProgressEvent::WorkerIdle { worker_id });
+
+                                    job_sys.defer(job_id, deferral)?;
+                                    set_running(None);
+                                }
+                                Ok(JobOutcome::Success(result)) => {
+                                    set_running(None);
+                                    tracing::debug!("Job [{}] completed in [{}]: [{}]", job_id, format_duration(job_duration), &job_desc);
 
-                                    // Notify progress display that this worker started a job
-                                    let _ = progress_tx.send(ProgressEvent::JobStarted {
+                                    // Notify progress display
+                                    let _ = progress_tx.send(ProgressEvent::JobCompleted {
                                         worker_id,
                                         job_id,
                                         display: job_display.clone(),
+                                        duration: job_duration,
+                                        usage: job_usage,
                                     });
 
-                                    let job_start = std::time::Instant::now();
-                                    let job_result = {
-                                        let _job_span = tracing::info_span!("job", id = job_id, desc = %job_desc).entered();
-                                        tracing::debug!("Running job: [{}] {}", job_id, job_desc);
-                                        job_fn(job)
-                                    };
-                                    let job_duration = std::time::Instant::now() - job_start;
-
-                                    match job_result {
-                                        Ok(JobOutcome::Deferred(deferral)) => {
-                                            let continuation_id = deferral.continuation_job.id;
-                                            tracing::trace!(
-                                                "Job [{}] [{}] deferred to continuation [{}] [{}], waiting for: {:?}",
-                                                job_id, &job_desc,
-                                                continuation_id, &deferral.continuation_job.desc,
-                                                deferral.blocked_by
-                                            );
-
-                                            // Track that continuation's result should propagate to original job
-                                            job_sys.result_propagation.insert(continuation_id, job_id);
-
-                                            // Notify progress: worker is now free (deferred job spawned children)
-                                            let _ = progress_tx.send(ProgressEvent::WorkerIdle { worker_id });
-
-                                            job_sys.add_job_with_deps(
-                                                deferral.continuation_job,
-                                                &deferral.blocked_by,
-                                            )?;
-                                        }
-                                        Ok(JobOutcome::Success(result)) => {
-                                            tracing::debug!("Job [{}] completed in [{}]: [{}]", job_id, format_duration(job_duration), &job_desc);
-
-                                            // Notify progress display
-                                            let _ = progress_tx.send(ProgressEvent::JobCompleted {
-                                                worker_id,
-                                                job_id,
-                                                display: job_display.clone(),
-                                                duration: job_duration,
-                                            });
-
-                                            // Store result for this job
-                                            job_sys.job_results.insert(job_id, Ok(result.clone()));
-
-                                            // Collect all job IDs that need to have their dependents unblocked
-                                            // This includes the completing job and any jobs it propagates to
-                                            let mut jobs_to_unblock = vec![job_id];
-
-                                            // Propagate result through any chain of continuations
-                                            // (handles multi-level deferrals: A -> B -> C)
-                                            let mut current_id = job_id;
-                                            while let Some((_, original_job_id)) =
-                                                job_sys.result_propagation.remove(&current_id)
-                                            {
-                                                tracing::trace!(
-                                                    "Propagating result from continuation [{}] to original job [{}]",
-                                                    current_id, original_job_id
-                                                );
-                                                job_sys.job_results.insert(original_job_id, Ok(result.clone()));
-                                                jobs_to_unblock.push(original_job_id);
-                                                current_id = original_job_id;
-                                            }
-
-                                            // Notify blocked_jobs that all these jobs are complete
-                                            let mut graph = job_sys.job_graph.lock().unwrap();
-                                            for finished_job in jobs_to_unblock {
-                                                if let Some(blocked_jobs) = graph.blocks.remove(&finished_job) {
-                                                    for blocked_job in blocked_jobs {
-                                                        if let Some(blocked_by) =
-                                                            graph.blocked_by.get_mut(&blocked_job)
-                                                        {
-                                                            blocked_by.remove(&finished_job);
-                                                            if blocked_by.is_empty() {
-                                                                if let Some((_, unblocked_job)) =
-                                                                    job_sys.blocked_jobs.remove(&blocked_job)
-                                                                {
-                                                                    worker_context.sender.send(unblocked_job)?;
-                                                                }
-                                                            }
-                                                        }
-                                                    }
-                                                }
-                                            }
-                                        }
-                                        Err(e) => {
-                                            tracing::error!("Job failed: [{}] [{}]: {}", job_id, &job_desc, e);
-
-                                            // Notify progress display
-                                            let _ = progress_tx.send(ProgressEvent::JobFailed {
-                                                worker_id,
-                                                job_id,
-                                                display: job_display.clone(),
-                                                error_output: e.to_string(),
-                                            });
-
-                                            // Store error
-                                            let s = e.to_string();
-                                            let job_result: anyhow::Result<Arc<dyn JobArtifact>> = anyhow::Result::Err(e).context(format!(
-                                                "Job Failed:\n    Desc: {}\n    Err:{}",
-                                                job_desc, s
-                                            ));
-                                            job_sys.job_results.insert(job_id, job_result);
-
-                                            // Propagate error through any chain of continuations
-                                            // (handles multi-level deferrals: A -> B -> C)
-                                            let mut current_id = job_id;
-                                            while let Some((_, original_job_id)) =
-                                                job_sys.result_propagation.remove(&current_id)
-                                            {
-                                                tracing::error!(
-                                                    "Propagating error from continuation [{}] to original job [{}]",
-                                                    current_id, original_job_id
-                                                );
-                                                job_sys.job_results.insert(
-                                                    original_job_id,
-                                                    Err(anyhow_loc!(
-                                                        "Original job [{}] failed because continuation job [{}] failed",
-                                                        original_job_id, job_id
-                                                    ))
-                                                );
-                                                current_id = original_job_id;
-                                            }
-
-                                            // Abort everything
-                                            job_sys.abort_flag.store(true, Ordering::SeqCst);
-                                        }
-                                    }
+                                    // Store the result and release every job waiting on it
+                                    let inline_jobs = job_sys.complete(job_id, result);
+                                    job_sys.run_inline(inline_jobs)?;
                                 }
-                                Err(RecvTimeoutError::Timeout) => {
-                                    if !idle {
-                                        idle = true;
-                                        idle_workers.fetch_add(1, Ordering::SeqCst);
+                                Err(e) => {
+                                    set_running(None);
+                                    tracing::error!("Job failed: [{}] [{}]: {}", job_id, &job_desc, e);
 
-                                        // Notify progress display that this worker is idle
-                                        let _ = progress_tx.send(ProgressEvent::WorkerIdle { worker_id });
-                                    }
+                                    // Notify progress display
+                                    let _ = progress_tx.send(ProgressEvent::JobFailed {
+                                        worker_id,
+                                        job_id,
+                                        display: job_display.clone(),
+                                        error_output: e.to_string(),
+                                    });
 
-                                    // Timeout: check if jobsys is complete, otherwise loop and get a new job
-                                    if idle_workers.load(Ordering::SeqCst) == num_workers
-                                        && worker_context.receiver.is_empty()
-                                    {
-                                        break;
-                                    }
+                                    // Store the error and fail or abort whatever waits on it
+                                    job_sys.fail(job_id, &job_desc, &job_display, e);
                                 }
-                                Err(RecvTimeoutError::Disconnected) => break,
                             }
+
+                            job_sys.finish_active();
                         }
 
                         Ok(())
@@ -466,8 +779,11 @@ impl JobSystem {
 
                     if let Err(e) = maybe_error {
                         tracing::error!("JobSystem worker failed: [{}]", e);
-                        job_sys.abort_flag.store(true, Ordering::SeqCst);
+                        job_sys.abort();
                     }
+
+                    // Detach from this run's queues
+                    LOCAL_QUEUE.with(|local| local.borrow_mut().take());
                 });
             }
         });
@@ -478,54 +794,102 @@ impl JobSystem {
         // Calculate execution time for reporting
         let execution_duration = execution_start.elapsed();
         let formatted_time = format_duration(execution_duration);
-        let total_jobs = job_sys.job_results.len();
+        let total_jobs = job_sys.num_results();
 
         // Check for any errors
         if job_sys.abort_flag.load(Ordering::SeqCst) {
             bail_loc!("JobSystem failed with errors after {}.", formatted_time);
         }
+        if job_sys.keep_going && job_sys.any_errors() {
+            bail_loc!(
+                "JobSystem finished after {} with [{}] failed jobs; [{}] jobs were skipped because a dep failed.",
+                formatted_time,
+                job_sys.failures.lock().unwrap().len(),
+                job_sys.num_skipped.load(Ordering::SeqCst)
+            );
+        }
 
         // Sanity check: ensure all jobs actually completed
-        if !job_sys.blocked_jobs.is_empty() {
+        if job_sys.num_blocked() > 0 {
+            let blocked: Vec<String> = job_sys
+                .slots
+                .iter()
+                .filter_map(|(_, slot)| slot.blocked.lock().unwrap().as_ref().map(|job| format!("{:?}", job)))
+                .collect();
             bail_loc!(
-                "JobSystem finished after {formatted_time} but had [{}] jobs that weren't finished. [{:?}]",
-                job_sys.blocked_jobs.len(),
-                job_sys.blocked_jobs
+                "JobSystem finished after {formatted_time} but had [{}] jobs that weren't finished. [{}]",
+                job_sys.num_blocked(),
+                blocked.join(", ")
             );
         }
 
         // Success!
         tracing::info!("Job system execution completed successfully in {formatted_time}");
+        if let Some(timeline) = &job_sys.timeline {
+            let critical_path = timeline.finish();
+            tracing::info!("Critical path: {}", critical_path);
+            for desc in &critical_path.jobs {
+                tracing::debug!("  critical path job: [{}]", desc);
+            }
+        }
 
         Ok(())
     }
 
+    /// Starts `command` on behalf of the running job without holding its worker while the tool
+    /// runs. Returns the id of a job that finishes with the tool's `ChildExit` once it exits, for
+    /// the caller to defer on. The running job's jobserver token and memory reservation pass to
+    /// the tool until it exits. A job can start at most one tool this way.
+    pub fn spawn_tool(self: &Arc<Self>, command: &mut Command, desc: String) -> anyhow::Result<JobId> {
+        let spawner = self
+            .running_job()
+            .ok_or_else(|| anyhow_loc!("Tool [{}] must be started by a running job", desc))?;
+        let spawned = LOCAL_QUEUE.with(|local| local.borrow().as_ref().and_then(|l| l.spawned_tool.get()));
+        if let Some(tool_id) = spawned {
+            bail_loc!("Job [{}] already started tool [{}] and can't start [{}]", spawner, tool_id, desc);
+        }
+
+        self.tool_slots.acquire(&self.abort_flag)?;
+        let tool_id = self.next_id.fetch_add(1, Ordering::SeqCst);
+        self.slot(tool_id).spawner.store(spawner + 1, Ordering::SeqCst);
+        if let Some(timeline) = &self.timeline {
+            timeline.add_job(tool_id, &[], Some(spawner));
+        }
+        let hold = ToolHold {
+            token: None,
+            memory: 0,
+            pending: 2,
+        };
+        self.tools.lock().unwrap().insert(tool_id, hold);
+        self.active_jobs.fetch_add(1, Ordering::SeqCst);
+
+        let job_sys = self.clone();
+        let tool_desc = desc.clone();
+        let on_exit = Box::new(move |exit| job_sys.finish_tool(tool_id, &tool_desc, exit));
+        if let Err(e) = process_reactor::spawn(command, Arc::as_ptr(self) as usize, on_exit) {
+            self.tools.lock().unwrap().remove(&tool_id);
+            self.tool_slots.release();
+            self.active_jobs.fetch_sub(1, Ordering::SeqCst);
+            return Err(e).with_context(|| anyhow_loc!("Failed to start tool [{}]", desc));
+        }
+
+        LOCAL_QUEUE.with(|local| local.borrow().as_ref().map(|l| l.spawned_tool.set(Some(tool_id))));
+        tracing::trace!("Job [{}] started tool [{}] [{}]", spawner, tool_id, desc);
+        Ok(tool_id)
+    }
+
     pub fn get_result(&self, job_id: JobId) -> ArcResult<dyn JobArtifact> {
-        if let Some(kvp) = self.job_results.get(&job_id) {
-            let arc_result = kvp.as_ref().map_err(|e| anyhow_loc!("{}", e))?.clone();
-            Ok(arc_result)
-        } else {
-            let mut errors = Vec::new();
-            for entry in self.job_results.iter() {
-                if let Err(err) = entry.value() {
-                    errors.push(format!("Job id {}: {err}", entry.key()));
-                }
-            }
-            if errors.is_empty() {
-                Err(anyhow_loc!(
-                    "No job result found for job id {job_id} and no job errors recorded",
-                ))
-            } else {
-                Err(anyhow_loc!("Aggregated job errors: {}", errors.join("; ")))
-            }
+        match self.result(job_id) {
+            Some(result) => Ok(result.as_ref().map_err(|e| anyhow_loc!("{}", e))?.clone()),
+            None => Err(self.missing_result_error(job_id)),
         }
     }
 
     pub fn expect_result<T: JobArtifact>(&self, job_id: JobId) -> ArcResult<T> {
         let t_name = std::any::type_name::<T>();
 
-        if let Some(kvp) = self.job_results.get(&job_id) {
-            let arc_result = kvp.as_ref().map_err(|e| anyhow_loc!("{}", e))?.clone();
+        if let Some(result) = self.result(job_id) {
+            let arc_result = result.as_ref().map_err(|e| anyhow_loc!("{}", e))?.clone();
             arc_result.downcast_arc::<T>().map(|v| v.clone()).map_err(|v| {
                 anyhow_loc!(
                     "Job result for job id {job_id} could not be cast to {t_name}. Actual type was {}",
@@ -533,71 +897,486 @@ impl JobSystem {
                 )
             })
         } else {
-            let mut errors = Vec::new();
-            for entry in self.job_results.iter() {
-                if let Err(err) = entry.value() {
-                    errors.push(format!("Job id {}: {err}", entry.key()));
-                }
-            }
-            if errors.is_empty() {
-                Err(anyhow_loc!(
-                    "No job result found for job id {job_id} and no job errors recorded",
-                ))
-            } else {
-                Err(anyhow_loc!("Aggregated job errors: {}", errors.join("; ")))
-            }
+            Err(self.missing_result_error(job_id))
         }
     }
 
+    /// Number of jobs with a stored result, successful or not.
+    pub(crate) fn num_results(&self) -> usize {
+        self.num_results.load(Ordering::SeqCst)
+    }
+
+    /// Number of jobs still waiting for deps.
+    pub(crate) fn num_blocked(&self) -> usize {
+        self.num_blocked.load(Ordering::SeqCst)
+    }
+
+    /// Every stored result with its job id, in id order.
+    pub(crate) fn results(&self) -> impl Iterator<Item = (JobId, &anyhow::Result<Arc<dyn JobArtifact>>)> {
+        self.slots.iter().filter_map(|(index, slot)| slot.result.get().map(|r| (index as JobId, r)))
+    }
+
     // ----------------------------------------------------
     // private methods
     // ----------------------------------------------------
-    fn handle_new_jobs(
-        job_sys: &Arc<JobSystem>,
-        new_jobs: Vec<Job>,
-        new_edges: &[JobGraphEdge],
-        tx: &crossbeam::channel::Sender<Job>,
-    ) -> anyhow::Result<()> {
-        // Seed jobs
-        let mut graph = job_sys.job_graph.lock().unwrap();
 
-        // Insert edges
-        for edge in new_edges {
-            let already_finished = job_sys.job_results.get(&edge.blocker).is_some();
+    /// Queues a runnable job and wakes a parked worker. Jobs queued from one of this system's
+    /// workers go to that worker's queue, everything else goes to the injector.
+    fn enqueue(&self, job: Job) {
+        self.active_jobs.fetch_add(1, Ordering::SeqCst);
+        let queued = self.prioritize(job);
+        let queued = LOCAL_QUEUE.with(|local| match &*local.borrow() {
+            Some(local) if std::ptr::eq(local.owner, self) => {
+                local.queue.push(queued);
+                None
+            }
+            _ => Some(queued),
+        });
+        if let Some(queued) = queued {
+            self.injector.push(queued);
+        }
+        self.parker.notify_one();
+    }
+
+    /// Drops one queued or running job from the count. Every job a job queued was counted first,
+    /// so zero means nothing is left to run.
+    fn finish_active(&self) {
+        if self.active_jobs.fetch_sub(1, Ordering::SeqCst) == 1 {
+            self.shutdown.store(true, Ordering::SeqCst);
+            self.parker.notify_all();
+        }
+    }
+
+    /// Returns a finished job's memory reservation and requeues the jobs it let fit.
+    fn release_memory(&self, bytes: u64) {
+        if let Some(budget) = self.memory.as_ref().filter(|_| bytes > 0) {
+            for waiting in budget.release(bytes) {
+                self.requeue(waiting);
+            }
+        }
+    }
+
+    /// Settles one side of a tool's hold: the job that started it handing over its token and
+    /// memory, or the tool exiting. The second one releases them.
+    fn settle_tool(&self, tool_id: JobId, handed_over: Option<(Option<JobToken>, u64)>) {
+        let mut tools = self.tools.lock().unwrap();
+        let Some(hold) = tools.get_mut(&tool_id) else {
+            return;
+        };
+        if let Some((token, memory)) = handed_over {
+            hold.token = token;
+            hold.memory = memory;
+        }
+        hold.pending -= 1;
+        if hold.pending > 0 {
+            return;
+        }
+        let hold = tools.remove(&tool_id).unwrap();
+        drop(tools);
+        drop(hold.token);
+        self.release_memory(hold.memory);
+    }
+
+    /// Reactor callback for a tool started with `spawn_tool`. Stores its exit as the tool job's
+    /// result, whatever the exit status, and releases everything waiting on it.
+    fn finish_tool(&self, tool_id: JobId, desc: &str, exit: std::io::Result<ChildExit>) {
+        self.tool_slots.release();
+        self.settle_tool(tool_id, None);
+        match exit {
+            Ok(exit) => {
+                tracing::trace!("Tool [{}] [{}] exited with [{}]", tool_id, desc, exit.output.status);
+                if let Some(timeline) = &self.timeline {
+                    let started = std::time::Instant::now() - exit.duration;
+                    timeline.job_ran(tool_id, desc, started, exit.duration);
+                }
+                let inline_jobs = self.complete(tool_id, Arc::new(exit));
+                if let Err(e) = self.run_inline(inline_jobs) {
+                    tracing::error!("Failed to run jobs released by tool [{}]: [{}]", desc, e);
+                    self.abort();
+                }
+            }
+            Err(e) => {
+                let e = anyhow_loc!("Failed to wait for tool [{}]: {}", desc, e);
+                self.fail(tool_id, desc, &JobDisplayInfo::from_desc(desc), e);
+            }
+        }
+        self.finish_active();
+    }
+
+    /// Queues a job that was already counted as active, such as one set aside for memory.
+    fn requeue(&self, job: Job) {
+        self.injector.push(self.prioritize(job));
+        self.parker.notify_one();
+    }
+
+    fn prioritize(&self, job: Job) -> QueuedJob {
+        QueuedJob {
+            priority: self.timeline.as_ref().map_or(0, |t| t.priority(&job.desc)),
+            seq: self.next_seq.fetch_add(1, Ordering::Relaxed),
+            job,
+        }
+    }
+
+    /// Finds the next job for a worker: the highest priority job across its own queue, the
+    /// injector, and its peers. Ties go to the worker's own queue, then the injector, then
+    /// a peer picked at random so thieves don't pile onto worker 0.
+    fn find_job(&self, worker_id: usize, queues: &[Arc<JobQueue>], rng: &mut u64) -> Option<Job> {
+        loop {
+            // xorshift64
+            *rng ^= *rng << 13;
+            *rng ^= *rng >> 7;
+            *rng ^= *rng << 17;
+            let start = (*rng % queues.len() as u64) as usize;
+            let peers = (0..queues.len())
+                .map(|i| (start + i) % queues.len())
+                .filter(|&i| i != worker_id)
+                .map(|i| &*queues[i]);
+
+            let mut best: Option<&JobQueue> = None;
+            let mut best_top = 0;
+            for queue in [&*queues[worker_id], &self.injector].into_iter().chain(peers) {
+                let top = queue.top.load(Ordering::SeqCst);
+                if top > best_top {
+                    best = Some(queue);
+                    best_top = top;
+                }
+            }
 
-            // don't insert edge if blocker is already finished
-            if !already_finished {
-                graph.blocked_by.entry(edge.blocked).or_default().insert(edge.blocker);
-                graph.blocks.entry(edge.blocker).or_default().insert(edge.blocked);
+            // Nothing queued anywhere. Otherwise retry if another worker took the job first.
+            if let Some(job) = best?.pop() {
+                return Some(job);
             }
         }
+    }
 
-        // Push initial_jobs into either blocked_job or work queue
+    /// The job running on the calling worker thread, if it belongs to this job system.
+    fn running_job(&self) -> Option<JobId> {
+        LOCAL_QUEUE.with(|local| match &*local.borrow() {
+            Some(local) if std::ptr::eq(local.owner, self) => local.running.get(),
+            _ => None,
+        })
+    }
+
+    /// Stops the current run, kills the tools its jobs are waiting on, and wakes every parked
+    /// worker so it can exit.
+    fn abort(&self) {
+        self.abort_flag.store(true, Ordering::SeqCst);
+        process_reactor::kill_group(self as *const JobSystem as usize);
+        self.tool_slots.notify_all();
+        self.parker.notify_all();
+    }
+
+    fn slot(&self, job_id: JobId) -> &JobSlot {
+        self.slots.get(job_id as u64)
+    }
+
+    fn try_slot(&self, job_id: JobId) -> Option<&JobSlot> {
+        self.slots.try_get(u64::try_from(job_id).ok()?)
+    }
+
+    fn result(&self, job_id: JobId) -> Option<&anyhow::Result<Arc<dyn JobArtifact>>> {
+        self.try_slot(job_id)?.result.get()
+    }
+
+    /// Stores a job's result. A job's result is only ever set once; later sets are ignored.
+    fn store_result(&self, job_id: JobId, result: anyhow::Result<Arc<dyn JobArtifact>>) {
+        let slot = self.slot(job_id);
+        let failed = result.is_err();
+        if slot.result.set(result).is_ok() {
+            self.num_results.fetch_add(1, Ordering::SeqCst);
+            if failed {
+                self.failed_jobs.lock().unwrap().push(job_id);
+            }
+        }
+    }
+
+    /// Returns the original job a finished continuation propagates its result to, if any.
+    fn take_propagation(&self, continuation_id: JobId) -> Option<JobId> {
+        match self.try_slot(continuation_id)?.propagate_to.swap(0, Ordering::SeqCst) {
+            0 => None,
+            original_id => Some(original_id - 1),
+        }
+    }
+
+    /// Error for a job with no stored result, listing the failures that likely explain it.
+    fn missing_result_error(&self, job_id: JobId) -> anyhow::Error {
+        let errors: Vec<String> = self
+            .failed_jobs
+            .lock()
+            .unwrap()
+            .iter()
+            .filter_map(|&failed| match self.result(failed) {
+                Some(Err(err)) => Some(format!("Job id {}: {err}", failed)),
+                _ => None,
+            })
+            .collect();
+        if errors.is_empty() {
+            anyhow_loc!("No job result found for job id {job_id} and no job errors recorded")
+        } else {
+            anyhow_loc!("Aggregated job errors: {}", errors.join("; "))
+        }
+    }
+
+    /// Adds `job_id` to the jobs waiting on `dep`. Returns false if `dep` already finished.
+    fn push_successor(&self, dep: JobId, job_id: JobId) -> bool {
+        let edge_index = self.next_edge.fetch_add(1, Ordering::Relaxed);
+        let edge = self.edges.get(edge_index);
+        edge.job_id.store(job_id, Ordering::Relaxed);
+
+        let head = &self.slot(dep).successors;
+        let mut current = head.load(Ordering::Acquire);
+        loop {
+            // The edge is left unused; edges are never reclaimed individually
+            if current == SUCCESSORS_CLOSED {
+                return false;
+            }
+            edge.next.store(current, Ordering::Relaxed);
+            match head.compare_exchange_weak(current, edge_index + 1, Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => return true,
+                Err(actual) => current = actual,
+            }
+        }
+    }
+
+    /// Marks `job_id` finished for dependency purposes and returns every job waiting on it.
+    fn close_successors(&self, job_id: JobId) -> Vec<JobId> {
+        let mut next = self.slot(job_id).successors.swap(SUCCESSORS_CLOSED, Ordering::AcqRel);
+        let mut successors = Vec::new();
+        while next != 0 && next != SUCCESSORS_CLOSED {
+            let edge = self.edges.get(next - 1);
+            successors.push(edge.job_id.load(Ordering::Relaxed));
+            next = edge.next.load(Ordering::Relaxed);
+        }
+        successors
+    }
+
+    /// Drops one pending count from a blocked job and runs or queues it if that was the last one.
+    fn release(&self, job_id: JobId) -> anyhow::Result<()> {
+        match self.unblock(job_id) {
+            Some(job) if job.inline => self.run_inline(vec![job]),
+            Some(job) => {
+                self.enqueue(job);
+                Ok(())
+            }
+            None => Ok(()),
+        }
+    }
+
+    /// Drops one pending count from a blocked job and returns it if that was the last one.
+    fn unblock(&self, job_id: JobId) -> Option<Job> {
+        let slot = self.slot(job_id);
+        if slot.pending.fetch_sub(1, Ordering::SeqCst) != 1 {
+            return None;
+        }
+        let job = slot.blocked.lock().unwrap().take()?;
+        self.num_blocked.fetch_sub(1, Ordering::SeqCst);
+        Some(*job)
+    }
+
+    /// Waits for `deferral.blocked_by`, then runs the continuation, whose result becomes `job_id`'s.
+    fn defer(&self, job_id: JobId, deferral: JobDeferral) -> anyhow::Result<()> {
+        self.slot(deferral.continuation_job.id).propagate_to.store(job_id + 1, Ordering::SeqCst);
+        self.add_job_with_deps(deferral.continuation_job, &deferral.blocked_by)
+    }
+
+    /// Stores a successful result, propagates it to the jobs this one is a continuation of, and
+    /// releases everything waiting on them. Queues released jobs, except inline jobs, which are
+    /// returned for the caller to run.
+    fn complete(&self, job_id: JobId, result: Arc<dyn JobArtifact>) -> Vec<Job> {
+        self.store_result(job_id, Ok(result.clone()));
+
+        // Collect all job IDs that need to have their dependents unblocked
+        // This includes the completing job and any jobs it propagates to
+        let mut jobs_to_unblock = vec![job_id];
+
+        // Propagate result through any chain of continuations
+        // (handles multi-level deferrals: A -> B -> C)
+        let mut current_id = job_id;
+        while let Some(original_job_id) = self.take_propagation(current_id) {
+            tracing::trace!(
+                "Propagating result from continuation [{}] to original job [{}]",
+                current_id, original_job_id
+            );
+            self.store_result(original_job_id, Ok(result.clone()));
+            if let Some(timeline) = &self.timeline {
+                timeline.finished_by(original_job_id, current_id);
+            }
+            jobs_to_unblock.push(original_job_id);
+            current_id = original_job_id;
+        }
+
+        // Release every job waiting on these jobs
+        let mut inline_jobs = Vec::new();
+        for finished_job in jobs_to_unblock {
+            for blocked_job in self.close_successors(finished_job) {
+                match self.unblock(blocked_job) {
+                    Some(job) if job.inline => inline_jobs.push(job),
+                    Some(job) => self.enqueue(job),
+                    None => {}
+                }
+            }
+        }
+        inline_jobs
+    }
+
+    /// Stores a job's error and propagates it to the jobs this one is a continuation of. Then
+    /// fails everything waiting on them with keep-going, or aborts the run without.
+    fn fail(&self, job_id: JobId, job_desc: &str, job_display: &JobDisplayInfo, e: anyhow::Error) {
+        // Store error
+        let s = e.to_string();
+        let job_result: anyhow::Result<Arc<dyn JobArtifact>> =
+            anyhow::Result::Err(e).context(format!("Job Failed:\n    Desc: {}\n    Err:{}", job_desc, s));
+        self.store_result(job_id, job_result);
+
+        // Failures caused by an abort (e.g. a killed compiler) aren't worth reporting
+        if !self.abort_flag.load(Ordering::SeqCst) {
+            self.failures.lock().unwrap().push(JobFailure {
+                job_id,
+                desc: job_desc.to_owned(),
+                display: job_display.clone(),
+                error: s,
+            });
+        }
+
+        // Propagate error through any chain of continuations
+        // (handles multi-level deferrals: A -> B -> C)
+        let mut failed = vec![job_id];
+        let mut current_id = job_id;
+        while let Some(original_job_id) = self.take_propagation(current_id) {
+            tracing::error!(
+                "Propagating error from continuation [{}] to original job [{}]",
+                current_id, original_job_id
+            );
+            self.store_result(
+                original_job_id,
+                Err(anyhow_loc!(
+                    "Original job [{}] failed because continuation job [{}] failed",
+                    original_job_id, job_id
+                )),
+            );
+            failed.push(original_job_id);
+            current_id = original_job_id;
+        }
+
+        if self.keep_going {
+            // Fail only what depends on this job and let everything else finish
+            self.skip_dependents(failed);
+        } else {
+            // Abort everything
+            self.abort();
+        }
+    }
+
+    /// Runs inline jobs on the calling thread, along with any inline jobs they release in turn.
+    /// No queue, token, memory reservation, or progress event is involved.
+    fn run_inline(&self, mut jobs: Vec<Job>) -> anyhow::Result<()> {
+        while let Some(mut job) = jobs.pop() {
+            if self.abort_flag.load(Ordering::SeqCst) {
+                return Ok(());
+            }
+
+            let job_id = job.id;
+            let job_fn =
+                job.job_fn.take().ok_or_else(|| anyhow_loc!("Job [{}:{}] missing job fn", job.id, job.desc))?;
+            let job_desc = job.desc.clone();
+            let job_display = job.display.clone();
+            tracing::trace!("Running inline job: [{}] {}", job_id, job_desc);
+
+            let job_start = std::time::Instant::now();
+            let job_result = job_fn(job);
+            if let (Some(timeline), Ok(_)) = (&self.timeline, &job_result) {
+                timeline.job_ran(job_id, &job_desc, job_start, job_start.elapsed());
+            }
+
+            match job_result {
+                Ok(JobOutcome::Success(result)) => jobs.extend(self.complete(job_id, result)),
+                Ok(JobOutcome::Deferred(deferral)) => self.defer(job_id, deferral)?,
+                Err(e) => {
+                    tracing::error!("Job failed: [{}] [{}]: {}", job_id, &job_desc, e);
+                    self.fail(job_id, &job_desc, &job_display, e);
+                }
+            }
+        }
+        Ok(())
+    }
+
+    fn handle_new_jobs(job_sys: &Arc<JobSystem>, new_jobs: Vec<Job>, new_edges: &[JobGraphEdge]) -> anyhow::Result<()> {
         for job in new_jobs {
             if job.job_fn.is_none() {
                 bail_loc!("Job [{}:{}] had no job fn", job.id, job.desc);
             }
+            let deps: Vec<JobId> = new_edges.iter().filter(|e| e.blocked == job.id).map(|e| e.blocker).collect();
+            job_sys.add_job_with_deps(job, &deps)?;
+        }
 
-            // Determine if blocked
-            let is_blocked = if let Some(blocked_by) = graph.blocked_by.get(&job.id) {
-                !blocked_by.is_empty()
-            } else {
-                false
-            };
+        Ok(())
+    }
 
-            if is_blocked {
-                // Store in blocked list
-                job_sys.blocked_jobs.insert(job.id, job);
-            } else {
-                // Insert into work queue
-                tx.send(job)?;
+    /// Keep-going: fails every job waiting on `failed`, transitively, without running it.
+    fn skip_dependents(&self, mut failed: Vec<JobId>) {
+        while let Some(failed_id) = failed.pop() {
+            for dependent in self.close_successors(failed_id) {
+                // A job waiting on several failed deps is skipped by the first one
+                let Some(job) = self.slot(dependent).blocked.lock().unwrap().take() else {
+                    continue;
+                };
+                self.num_blocked.fetch_sub(1, Ordering::SeqCst);
+                self.mark_skipped(dependent, &job.desc, failed_id, &mut failed);
             }
         }
+    }
 
-        Ok(())
+    /// Keep-going: fails `job`, which was never queued, because `failed_dep` failed. Whatever
+    /// waits on it, or on the jobs it's a continuation of, is skipped too.
+    fn skip_job(&self, job: Job, failed_dep: JobId) {
+        let mut failed = Vec::new();
+        self.mark_skipped(job.id, &job.desc, failed_dep, &mut failed);
+        self.skip_dependents(failed);
+    }
+
+    /// Stores a skipped job's error and propagates it to the jobs it's a continuation of. Every
+    /// job that now has an error is pushed onto `failed`.
+    fn mark_skipped(&self, job_id: JobId, job_desc: &str, failed_dep: JobId, failed: &mut Vec<JobId>) {
+        self.num_skipped.fetch_add(1, Ordering::SeqCst);
+        tracing::debug!("Skipping job [{}] [{}] because dep [{}] failed", job_id, job_desc, failed_dep);
+        self.store_result(
+            job_id,
+            Err(anyhow_loc!("Job [{}] skipped because dep [{}] failed", job_desc, failed_dep)),
+        );
+        failed.push(job_id);
+
+        let mut current_id = job_id;
+        while let Some(original_id) = self.take_propagation(current_id) {
+            self.store_result(
+                original_id,
+                Err(anyhow_loc!(
+                    "Original job [{}] failed because continuation job [{}] was skipped",
+                    original_id, job_id
+                )),
+            );
+            failed.push(original_id);
+            current_id = original_id;
+        }
+    }
+
+    /// Jobs whose own function failed during the last run, in the order they failed.
+    pub fn failures(&self) -> Vec<JobFailure> {
+        self.failures.lock().unwrap().clone()
+    }
+
+    pub fn num_skipped(&self) -> usize {
+        self.num_skipped.load(Ordering::SeqCst)
+    }
+
+    /// The job that was running when `job_id` was added, if any.
+    pub fn spawner(&self, job_id: JobId) -> Option<JobId> {
+        match self.try_slot(job_id)?.spawner.load(Ordering::SeqCst) {
+            0 => None,
+            spawner => Some(spawner - 1),
+        }
     }
 
     pub(crate) fn any_errors(&self) -> bool {
-        self.job_results.iter().any(|r| r.is_err())
+        !self.failed_jobs.lock().unwrap().is_empty()
     }
 }
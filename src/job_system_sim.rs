@@ -0,0 +1,345 @@
+//! Synthetic build graphs for measuring the job system without real compilers.
+//!
+//! `SyntheticGraph::generate` lays out a project the way the C++ rules see one: libraries in
+//! layers, each library a set of compile jobs feeding an archive, each compile waiting on the
+//! archives of the libraries it depends on, and one link waiting on every archive. Job durations
+//! are drawn from a `DurationModel`, which can be a fixed value, a random distribution, or the
+//! job durations of a real build replayed from a `--profile` trace.
+//!
+//! `simulate` runs a graph through `JobSystem::run_to_completion`, with each job sleeping for
+//! its duration, and reports the makespan against the ideal lower bound, worker utilization,
+//! and the scheduling overhead per job measured on the same graph with zero-length jobs.
+//!
+//! Only built for tests. The benchmarks live in `job_system_sim_tests.rs` as ignored tests.
+
+use crate::job_history::{JobEstimate, JobHistory};
+use crate::job_system::*;
+use crate::util::format_duration;
+use crate::{anyhow_loc, bail_loc_if, function_name};
+use anyhow::Context;
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+/// Shape of a generated project.
+#[derive(Clone, Debug)]
+pub struct GraphSpec {
+    pub libraries: usize,
+    pub files_per_library: usize,
+    /// Number of library layers. Libraries only depend on the layer directly below them.
+    pub depth: usize,
+    /// How many libraries of the layer below each library depends on.
+    pub fan_out: usize,
+    pub durations: DurationModel,
+    pub seed: u64,
+}
+
+/// Where job durations come from.
+#[derive(Clone, Debug)]
+pub enum DurationModel {
+    Fixed(Duration),
+    Uniform { min: Duration, max: Duration },
+    /// Long-tailed, like real translation units: most are quick, a few take far longer.
+    LogNormal { median: Duration, sigma: f64 },
+    /// Samples from a list of measured durations, e.g. from `durations_from_chrome_trace`.
+    Replay(Vec<Duration>),
+}
+
+#[derive(Clone, Debug)]
+pub struct SimJob {
+    pub desc: String,
+    pub deps: Vec<usize>,
+    pub duration: Duration,
+}
+
+/// Jobs in dependency order: every job's deps come before it.
+#[derive(Clone, Debug, Default)]
+pub struct SyntheticGraph {
+    pub jobs: Vec<SimJob>,
+}
+
+#[derive(Clone, Debug)]
+pub struct SimReport {
+    pub jobs: usize,
+    pub workers: usize,
+    pub makespan: Duration,
+    pub critical_path: Duration,
+    pub total_work: Duration,
+    /// Fraction of worker time spent running jobs.
+    pub utilization: f64,
+    /// Wall time per job of the same graph with zero-length jobs.
+    pub overhead_per_job: Duration,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+/// SplitMix64. Deterministic per seed, which is all a benchmark needs.
+struct Rng(u64);
+
+#[derive(Debug)]
+struct SimResult;
+impl JobArtifact for SimResult {}
+
+// ----------------------------------------------------------------------------
+// Public functions
+// ----------------------------------------------------------------------------
+/// Runs `graph` on `num_workers` workers. With `use_history` the job system is primed with the
+/// exact duration and remaining path of every job, as a perfectly trained `JobHistory` would be.
+pub fn simulate(graph: &SyntheticGraph, num_workers: usize, use_history: bool) -> anyhow::Result<SimReport> {
+    let (makespan, busy) = run_graph(graph, num_workers, use_history, |job| job.duration)?;
+    let (overhead_makespan, _) = run_graph(graph, num_workers, use_history, |_| Duration::ZERO)?;
+
+    let jobs = graph.jobs.len().max(1);
+    Ok(SimReport {
+        jobs: graph.jobs.len(),
+        workers: num_workers,
+        makespan,
+        critical_path: graph.critical_path(),
+        total_work: graph.total_work(),
+        utilization: busy.as_secs_f64() / (makespan.as_secs_f64() * num_workers as f64).max(f64::EPSILON),
+        overhead_per_job: overhead_makespan / jobs as u32,
+    })
+}
+
+/// Durations of every job span in a Chrome trace written by `--profile`.
+pub fn durations_from_chrome_trace(trace: &str) -> anyhow::Result<Vec<Duration>> {
+    // A trace cut short by a crash lacks the closing bracket
+    let trace = trace.trim_end().trim_end_matches(',');
+    let events: Vec<serde_json::Value> = match serde_json::from_str(trace) {
+        Ok(events) => events,
+        Err(_) => serde_json::from_str(&format!("{}]", trace))
+            .with_context(|| anyhow_loc!("Failed to parse chrome trace"))?,
+    };
+
+    let micros = |event: &serde_json::Value, field: &str| event.get(field).and_then(|v| v.as_f64());
+    let mut open: HashMap<(u64, u64), Vec<f64>> = HashMap::new();
+    let mut durations = Vec::new();
+    for event in &events {
+        if event.get("name").and_then(|n| n.as_str()) != Some("job") {
+            continue;
+        }
+        let thread = (
+            event.get("pid").and_then(|v| v.as_u64()).unwrap_or(0),
+            event.get("tid").and_then(|v| v.as_u64()).unwrap_or(0),
+        );
+        match (event.get("ph").and_then(|p| p.as_str()), micros(event, "ts")) {
+            (Some("X"), _) => durations.extend(micros(event, "dur")),
+            (Some("B"), Some(ts)) => open.entry(thread).or_default().push(ts),
+            (Some("E"), Some(ts)) => {
+                if let Some(start) = open.get_mut(&thread).and_then(|starts| starts.pop()) {
+                    durations.push(ts - start);
+                }
+            }
+            _ => {}
+        }
+    }
+
+    let durations: Vec<Duration> =
+        durations.into_iter().map(|us| Duration::from_secs_f64(us.max(0.0) / 1e6)).collect();
+    bail_loc_if!(durations.is_empty(), "Chrome trace contains no job spans");
+    Ok(durations)
+}
+
+// ----------------------------------------------------------------------------
+// Private functions
+// ----------------------------------------------------------------------------
+/// Runs the graph once, returning the makespan and the summed time jobs spent running.
+fn run_graph(
+    graph: &SyntheticGraph,
+    num_workers: usize,
+    use_history: bool,
+    duration_of: impl Fn(&SimJob) -> Duration,
+) -> anyhow::Result<(Duration, Duration)> {
+    let jobsys: Arc<JobSystem> = if use_history {
+        let history = Arc::new(JobHistory::new(Default::default()));
+        let remaining = graph.remaining_paths();
+        for (job, remaining) in graph.jobs.iter().zip(remaining) {
+            history.update(
+                &job.desc,
+                JobEstimate {
+                    duration: job.duration,
+                    remaining,
+                },
+            );
+        }
+        JobSystem::with_history(history).into()
+    } else {
+        JobSystem::new().into()
+    };
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let busy = Arc::new(Mutex::new(Duration::ZERO));
+
+    let mut ids: Vec<JobId> = Vec::with_capacity(graph.jobs.len());
+    for job in &graph.jobs {
+        let duration = duration_of(job);
+        let busy = busy.clone();
+        let sim_job = ctx.new_job(
+            job.desc.clone(),
+            JobDisplayInfo::from_desc(&job.desc),
+            Box::new(move |_| {
+                let start = Instant::now();
+                if !duration.is_zero() {
+                    std::thread::sleep(duration);
+                }
+                *busy.lock().unwrap() += start.elapsed();
+                Ok(JobOutcome::Success(Arc::new(SimResult)))
+            }),
+        );
+        ids.push(sim_job.id);
+        let deps: Vec<JobId> = job.deps.iter().map(|&dep| ids[dep]).collect();
+        jobsys.add_job_with_deps(sim_job, &deps)?;
+    }
+
+    let (progress_tx, _progress_rx) = crossbeam::channel::unbounded();
+    let start = Instant::now();
+    JobSystem::run_to_completion(jobsys, num_workers, progress_tx)?;
+    let makespan = start.elapsed();
+    let busy = *busy.lock().unwrap();
+    Ok((makespan, busy))
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl SyntheticGraph {
+    pub fn generate(spec: &GraphSpec) -> SyntheticGraph {
+        let mut rng = Rng(spec.seed);
+        let depth = spec.depth.clamp(1, spec.libraries.max(1));
+        let mut graph = SyntheticGraph::default();
+
+        // Spread libraries over the layers as evenly as possible, bottom layer first
+        let layers: Vec<Vec<usize>> = (0..depth)
+            .map(|layer| (0..spec.libraries).filter(|lib| lib * depth / spec.libraries == layer).collect())
+            .collect();
+
+        let mut archives: Vec<usize> = vec![0; spec.libraries];
+        for (layer, libs) in layers.iter().enumerate() {
+            for &lib in libs {
+                let mut lib_deps: Vec<usize> = Vec::new();
+                if layer > 0 {
+                    let below = &layers[layer - 1];
+                    while lib_deps.len() < spec.fan_out.min(below.len()) {
+                        let dep = archives[below[rng.below(below.len())]];
+                        if !lib_deps.contains(&dep) {
+                            lib_deps.push(dep);
+                        }
+                    }
+                }
+
+                let compiles: Vec<usize> = (0..spec.files_per_library)
+                    .map(|file| {
+                        let desc = format!("Compiling lib{}/file{}.cpp", lib, file);
+                        graph.push(desc, lib_deps.clone(), &spec.durations, &mut rng)
+                    })
+                    .collect();
+                let desc = format!("Archiving lib{}", lib);
+                archives[lib] = graph.push(desc, compiles, &spec.durations, &mut rng);
+            }
+        }
+
+        graph.push("Linking app".to_owned(), archives, &spec.durations, &mut rng);
+        graph
+    }
+
+    /// Multiplies every duration by `factor`, e.g. to replay a minutes-long build in seconds.
+    pub fn scale_durations(&mut self, factor: f64) {
+        for job in &mut self.jobs {
+            job.duration = job.duration.mul_f64(factor);
+        }
+    }
+
+    pub fn total_work(&self) -> Duration {
+        self.jobs.iter().map(|job| job.duration).sum()
+    }
+
+    /// Longest chain of job durations. No schedule on any number of workers can beat it.
+    pub fn critical_path(&self) -> Duration {
+        self.remaining_paths().into_iter().max().unwrap_or_default()
+    }
+
+    /// For each job, its duration plus the longest chain of jobs that wait on it.
+    fn remaining_paths(&self) -> Vec<Duration> {
+        let mut remaining: Vec<Duration> = self.jobs.iter().map(|job| job.duration).collect();
+        for (index, job) in self.jobs.iter().enumerate().rev() {
+            for &dep in &job.deps {
+                remaining[dep] = remaining[dep].max(self.jobs[dep].duration + remaining[index]);
+            }
+        }
+        remaining
+    }
+
+    fn push(&mut self, desc: String, deps: Vec<usize>, durations: &DurationModel, rng: &mut Rng) -> usize {
+        self.jobs.push(SimJob {
+            desc,
+            deps,
+            duration: durations.sample(rng),
+        });
+        self.jobs.len() - 1
+    }
+}
+
+impl DurationModel {
+    fn sample(&self, rng: &mut Rng) -> Duration {
+        match self {
+            DurationModel::Fixed(duration) => *duration,
+            DurationModel::Uniform { min, max } => *min + (*max - *min).mul_f64(rng.unit()),
+            DurationModel::LogNormal { median, sigma } => median.mul_f64((sigma * rng.normal()).exp()),
+            DurationModel::Replay(durations) if durations.is_empty() => Duration::ZERO,
+            DurationModel::Replay(durations) => durations[rng.below(durations.len())],
+        }
+    }
+}
+
+impl SimReport {
+    /// Lower bound on the makespan: the critical path, or the total work spread over every worker.
+    pub fn ideal_makespan(&self) -> Duration {
+        self.critical_path.max(self.total_work / self.workers.max(1) as u32)
+    }
+}
+
+impl std::fmt::Display for SimReport {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(
+            f,
+            "{} jobs, {} workers: makespan {} (ideal {}, {:.2}x), critical path {}, \
+             utilization {:.0}%, overhead {:?}/job",
+            self.jobs,
+            self.workers,
+            format_duration(self.makespan),
+            format_duration(self.ideal_makespan()),
+            self.makespan.as_secs_f64() / self.ideal_makespan().as_secs_f64().max(f64::EPSILON),
+            format_duration(self.critical_path),
+            self.utilization * 100.0,
+            self.overhead_per_job
+        )
+    }
+}
+
+impl Rng {
+    fn next(&mut self) -> u64 {
+        self.0 = self.0.wrapping_add(0x9E37_79B9_7F4A_7C15);
+        let mut z = self.0;
+        z = (z ^ (z >> 30)).wrapping_mul(0xBF58_476D_1CE4_E5B9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94D0_49BB_1331_11EB);
+        z ^ (z >> 31)
+    }
+
+    /// Uniform in [0, 1).
+    fn unit(&mut self) -> f64 {
+        (self.next() >> 11) as f64 / (1u64 << 53) as f64
+    }
+
+    fn below(&mut self, n: usize) -> usize {
+        (self.next() % n as u64) as usize
+    }
+
+    /// Standard normal, by Box-Muller.
+    fn normal(&mut self) -> f64 {
+        let u = 1.0 - self.unit();
+        (-2.0 * u.ln()).sqrt() * (std::f64::consts::TAU * self.unit()).cos()
+    }
+}
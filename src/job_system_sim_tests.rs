@@ -0,0 +1,155 @@
+//! Tests and benchmarks for job_system_sim.rs
+
+use crate::job_system_sim::*;
+use std::time::Duration;
+
+fn spec(durations: DurationModel) -> GraphSpec {
+    GraphSpec {
+        libraries: 12,
+        files_per_library: 5,
+        depth: 4,
+        fan_out: 2,
+        durations,
+        seed: 7,
+    }
+}
+
+#[test]
+fn generated_graph_has_expected_shape() {
+    let graph = SyntheticGraph::generate(&spec(DurationModel::Fixed(Duration::from_millis(1))));
+
+    // One compile per file, one archive per library, one link
+    assert_eq!(graph.jobs.len(), 12 * 5 + 12 + 1);
+    for (index, job) in graph.jobs.iter().enumerate() {
+        assert!(job.deps.iter().all(|&dep| dep < index), "{} depends on a later job", job.desc);
+    }
+    let link = graph.jobs.last().unwrap();
+    assert_eq!(link.desc, "Linking app");
+    assert_eq!(link.deps.len(), 12);
+
+    // Compiles in the bottom layer wait on nothing, above it on `fan_out` archives
+    let compile_deps: Vec<usize> =
+        graph.jobs.iter().filter(|job| job.desc.starts_with("Compiling")).map(|job| job.deps.len()).collect();
+    assert_eq!(compile_deps.iter().filter(|&&n| n == 0).count(), 3 * 5);
+    assert_eq!(compile_deps.iter().filter(|&&n| n == 2).count(), 9 * 5);
+
+    // Four layers of compile + archive, then the link
+    assert_eq!(graph.critical_path(), Duration::from_millis(4 * 2 + 1));
+    assert_eq!(graph.total_work(), Duration::from_millis(73));
+}
+
+#[test]
+fn generation_is_deterministic_per_seed() {
+    let model = DurationModel::LogNormal {
+        median: Duration::from_millis(10),
+        sigma: 1.0,
+    };
+    let a = SyntheticGraph::generate(&spec(model.clone()));
+    let b = SyntheticGraph::generate(&spec(model.clone()));
+    let c = SyntheticGraph::generate(&GraphSpec { seed: 8, ..spec(model) });
+
+    let durations = |g: &SyntheticGraph| g.jobs.iter().map(|job| job.duration).collect::<Vec<_>>();
+    assert_eq!(durations(&a), durations(&b));
+    assert_ne!(durations(&a), durations(&c));
+}
+
+#[test]
+fn chrome_trace_job_durations() -> anyhow::Result<()> {
+    let trace = r#"[
+        {"ph":"B","pid":1,"tid":2,"ts":100.0,"name":"worker"},
+        {"ph":"B","pid":1,"tid":2,"ts":110.0,"name":"job","args":{"desc":"a"}},
+        {"ph":"B","pid":1,"tid":3,"ts":120.0,"name":"job","args":{"desc":"b"}},
+        {"ph":"E","pid":1,"tid":2,"ts":1110.0,"name":"job"},
+        {"ph":"X","pid":1,"tid":4,"ts":0.0,"dur":250.0,"name":"job"},
+        {"ph":"E","pid":1,"tid":3,"ts":5120.0,"name":"job"},"#;
+
+    let mut durations = durations_from_chrome_trace(trace)?;
+    durations.sort();
+    assert_eq!(
+        durations,
+        [Duration::from_micros(250), Duration::from_micros(1000), Duration::from_micros(5000)]
+    );
+
+    assert!(durations_from_chrome_trace(r#"[{"ph":"B","name":"worker","ts":1}]"#).is_err());
+    Ok(())
+}
+
+#[test]
+fn simulation_report_is_consistent() -> anyhow::Result<()> {
+    let graph = SyntheticGraph::generate(&spec(DurationModel::Fixed(Duration::from_millis(2))));
+    let report = simulate(&graph, 4, false)?;
+
+    assert_eq!(report.jobs, graph.jobs.len());
+    assert_eq!(report.ideal_makespan(), graph.critical_path().max(graph.total_work() / 4));
+    assert!(report.makespan >= report.ideal_makespan());
+    assert!(report.utilization > 0.0 && report.utilization <= 1.0);
+    Ok(())
+}
+
+/// Benchmark: makespan, utilization, and per-job overhead over a range of project shapes,
+/// with and without critical-path priorities.
+/// Run with: cargo test --release bench_synthetic_graphs -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_synthetic_graphs() -> anyhow::Result<()> {
+    let num_workers = std::thread::available_parallelism().map_or(8, |n| n.get());
+    let tails = DurationModel::LogNormal {
+        median: Duration::from_millis(2),
+        sigma: 1.2,
+    };
+    let shapes = [
+        ("wide", 64, 20, 2, 4),
+        ("deep", 64, 20, 16, 2),
+        ("chain", 16, 4, 16, 1),
+    ];
+
+    for (name, libraries, files_per_library, depth, fan_out) in shapes {
+        let graph = SyntheticGraph::generate(&GraphSpec {
+            libraries,
+            files_per_library,
+            depth,
+            fan_out,
+            durations: tails.clone(),
+            seed: 1,
+        });
+        for use_history in [false, true] {
+            let report = simulate(&graph, num_workers, use_history)?;
+            let order = if use_history { "critical path" } else { "fifo" };
+            println!("{:>5} {:>13}: {}", name, order, report);
+        }
+    }
+
+    Ok(())
+}
+
+/// Benchmark: replays the job durations of a real build over a synthetic graph.
+/// Run with: ANUBIS_SIM_TRACE=path/to/profile.json cargo test --release bench_replayed_trace -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_replayed_trace() -> anyhow::Result<()> {
+    let Ok(trace_path) = std::env::var("ANUBIS_SIM_TRACE") else {
+        println!("Set ANUBIS_SIM_TRACE to a --profile trace to replay");
+        return Ok(());
+    };
+    let durations = durations_from_chrome_trace(&std::fs::read_to_string(&trace_path)?)?;
+    let num_workers = std::thread::available_parallelism().map_or(8, |n| n.get());
+
+    let mut graph = SyntheticGraph::generate(&GraphSpec {
+        libraries: 32,
+        files_per_library: (durations.len() / 32).max(1),
+        depth: 6,
+        fan_out: 3,
+        durations: DurationModel::Replay(durations),
+        seed: 1,
+    });
+    // Keep the replay to a few seconds however long the original build was
+    let target = Duration::from_secs(2) * num_workers as u32;
+    graph.scale_durations((target.as_secs_f64() / graph.total_work().as_secs_f64().max(f64::EPSILON)).min(1.0));
+
+    for use_history in [false, true] {
+        let report = simulate(&graph, num_workers, use_history)?;
+        println!("{}: {}", if use_history { "critical path" } else { "fifo" }, report);
+    }
+
+    Ok(())
+}
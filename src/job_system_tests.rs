@@ -3,6 +3,7 @@
 use crate::bail_loc;
 use crate::function_name;
 use crate::job_system::*;
+use crate::process_reactor::ChildExit;
 use crate::progress::ProgressEvent;
 use std::sync::atomic::{AtomicBool, AtomicI64, AtomicU8, AtomicUsize, Ordering};
 use std::sync::{Arc, Mutex};
@@ -636,7 +637,7 @@ fn empty_job_system() -> anyhow::Result<()> {
     );
 
     // Verify no results or errors
-    assert_eq!(jobsys.job_results.len(), 0);
+    assert_eq!(jobsys.num_results(), 0);
     assert!(!jobsys.abort_flag.load(Ordering::SeqCst));
 
     Ok(())
@@ -970,10 +971,10 @@ fn rapid_job_addition() -> anyhow::Result<()> {
     assert!(elapsed < std::time::Duration::from_secs(2));
 
     // Verify all 100 jobs completed (4 threads * 25 jobs each)
-    assert_eq!(jobsys.job_results.len(), 100);
+    assert_eq!(jobsys.num_results(), 100);
 
     // Verify no jobs are blocked
-    assert!(jobsys.blocked_jobs.is_empty());
+    assert_eq!(jobsys.num_blocked(), 0);
 
     Ok(())
 }
@@ -1084,8 +1085,8 @@ fn graceful_shutdown() -> anyhow::Result<()> {
     assert!(elapsed < std::time::Duration::from_millis(500));
 
     // All jobs should have completed
-    assert_eq!(jobsys.job_results.len(), 5);
-    assert!(jobsys.blocked_jobs.is_empty());
+    assert_eq!(jobsys.num_results(), 5);
+    assert_eq!(jobsys.num_blocked(), 0);
     assert!(!jobsys.abort_flag.load(Ordering::SeqCst));
 
     // Verify all results
@@ -1155,9 +1156,7 @@ fn jobs_creating_jobs() -> anyhow::Result<()> {
     // Verify all child jobs completed - they should all be done by now
     // since run_to_completion should wait for all jobs to finish
     let mut found_children = 0;
-    for entry in jobsys.job_results.iter() {
-        let job_id = *entry.key();
-        let result = entry.value();
+    for (job_id, result) in jobsys.results() {
         if job_id != parent_id {
             let result = result.as_ref().unwrap();
             let trivial_result = result.downcast_ref::<TrivialResult>().unwrap();
@@ -1175,6 +1174,134 @@ fn jobs_creating_jobs() -> anyhow::Result<()> {
     Ok(())
 }
 
+#[test]
+fn spawned_jobs_are_stolen_by_idle_workers() -> anyhow::Result<()> {
+    // Children added by a running job go to that worker's local deque.
+    // Parked workers must wake up and steal them rather than leave them to the parent's worker.
+
+    let jobsys: Arc<JobSystem> = JobSystem::new().into();
+    let ctx: Arc<JobContext> = Arc::new(JobContext {
+        anubis: Default::default(),
+        job_system: jobsys.clone(),
+        mode: None,
+        toolchain: None,
+    });
+    let threads = Arc::new(Mutex::new(std::collections::HashSet::new()));
+
+    let parent_threads = threads.clone();
+    let parent_job = make_test_job(
+        ctx.get_next_id(),
+        "parent".to_owned(),
+        ctx.clone(),
+        Box::new(move |job| {
+            for i in 0..16 {
+                let child_threads = parent_threads.clone();
+                let child_job = make_ctx_job(
+                    &job.ctx,
+                    format!("child_{}", i),
+                    Box::new(move |_| {
+                        child_threads.lock().unwrap().insert(std::thread::current().id());
+                        std::thread::sleep(std::time::Duration::from_millis(10));
+                        Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))
+                    }),
+                );
+                job.ctx.job_system.add_job(child_job)?;
+            }
+            Ok(JobOutcome::Success(Arc::new(TrivialResult(-1))))
+        }),
+    );
+    jobsys.add_job(parent_job)?;
+
+    JobSystem::run_to_completion(jobsys.clone(), 4, dummy_progress_tx())?;
+
+    assert_eq!(jobsys.num_results(), 17);
+    assert!(threads.lock().unwrap().len() > 1, "Children should be spread across workers");
+
+    Ok(())
+}
+
+#[test]
+fn dependents_race_with_completing_deps() -> anyhow::Result<()> {
+    // Each leaf adds a dependent on an earlier leaf that may be queued, running, or finished,
+    // exercising the race between registering a successor and its dep completing
+
+    let jobsys: Arc<JobSystem> = JobSystem::new().into();
+    let ctx: Arc<JobContext> = Arc::new(JobContext {
+        anubis: Default::default(),
+        job_system: jobsys.clone(),
+        mode: None,
+        toolchain: None,
+    });
+    let dependents_run = Arc::new(AtomicUsize::new(0));
+
+    let num_leaves = 500;
+    let first_leaf = ctx.get_next_id();
+    for _ in 1..num_leaves {
+        ctx.get_next_id();
+    }
+    for i in 0..num_leaves {
+        let dependents_run = dependents_run.clone();
+        let leaf = make_test_job(
+            first_leaf + i,
+            format!("leaf_{}", i),
+            ctx.clone(),
+            Box::new(move |job| {
+                let dependents_run = dependents_run.clone();
+                let dependent = make_ctx_job(
+                    &job.ctx,
+                    format!("dependent_{}", i),
+                    Box::new(move |_| {
+                        dependents_run.fetch_add(1, Ordering::SeqCst);
+                        Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))
+                    }),
+                );
+                job.ctx.job_system.add_job_with_deps(dependent, &[first_leaf + i / 2])?;
+                Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))
+            }),
+        );
+        jobsys.add_job(leaf)?;
+    }
+
+    JobSystem::run_to_completion(jobsys.clone(), 8, dummy_progress_tx())?;
+
+    assert_eq!(dependents_run.load(Ordering::SeqCst), num_leaves as usize);
+    assert_eq!(jobsys.num_blocked(), 0);
+
+    Ok(())
+}
+
+#[test]
+fn results_stored_by_sparse_ids() -> anyhow::Result<()> {
+    // Job state lives in an arena indexed by id. Ids on either side of segment boundaries,
+    // and far past anything allocated, must all round-trip.
+
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().into();
+    let ids: [JobId; 6] = [0, 1023, 1024, 3071, 3072, 100_000];
+
+    for &id in &ids {
+        let job = make_test_job(
+            id,
+            format!("job_{}", id),
+            ctx.clone(),
+            Box::new(move |_| Ok(JobOutcome::Success(Arc::new(TrivialResult(id))))),
+        );
+        jobsys.add_job_with_deps(job, if id == 0 { &[] } else { &[0] })?;
+    }
+
+    JobSystem::run_to_completion(jobsys.clone(), 2, dummy_progress_tx())?;
+
+    let stored: Vec<JobId> = jobsys.results().map(|(job_id, _)| job_id).collect();
+    assert_eq!(stored, ids);
+    for &id in &ids {
+        assert_eq!(jobsys.expect_result::<TrivialResult>(id)?.0, id);
+    }
+    assert!(jobsys.get_result(5).is_err());
+    assert!(jobsys.get_result(i64::MAX).is_err());
+
+    Ok(())
+}
+
 // Test jobs creating jobs with dependencies
 #[test]
 fn jobs_creating_dependent_jobs() -> anyhow::Result<()> {
@@ -1255,12 +1382,10 @@ fn jobs_creating_dependent_jobs() -> anyhow::Result<()> {
     // Verify child jobs executed in order
     // Filter out parent job and continuation job (which has value 777)
     let mut child_results: Vec<(JobId, i64)> = jobsys
-        .job_results
-        .iter()
-        .filter(|entry| *entry.key() != parent_id)
-        .map(|entry| {
-            let job_id = *entry.key();
-            let result = entry.value().as_ref().unwrap();
+        .results()
+        .filter(|(job_id, _)| *job_id != parent_id)
+        .map(|(job_id, result)| {
+            let result = result.as_ref().unwrap();
             let trivial_result = result.downcast_ref::<TrivialResult>().unwrap();
             (job_id, trivial_result.0)
         })
@@ -1602,9 +1727,7 @@ fn complex_job_creation_and_deferral() -> anyhow::Result<()> {
 
     // Verify all compilation jobs completed
     let mut found_compile_jobs = 0;
-    for entry in jobsys.job_results.iter() {
-        let job_id = *entry.key();
-        let result = entry.value();
+    for (job_id, result) in jobsys.results() {
         if job_id != main_id {
             let result = result.as_ref().unwrap();
             let trivial_result = result.downcast_ref::<TrivialResult>().unwrap();
@@ -1739,3 +1862,586 @@ fn job_deferral_multi_level() -> anyhow::Result<()> {
 
     Ok(())
 }
+
+/// Benchmark: wall time of `run_to_completion` for small graphs, where scheduler overhead
+/// rather than job work dominates. Each graph is a fan-in of trivial leaf jobs into a sink.
+/// Run with: cargo test --release bench_small_graph_tail_latency -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_small_graph_tail_latency() -> anyhow::Result<()> {
+    const ITERATIONS: usize = 200;
+
+    for (num_leaves, num_workers) in [(1, 4), (10, 4), (100, 16)] {
+        let mut samples = Vec::with_capacity(ITERATIONS);
+        for _ in 0..ITERATIONS {
+            let ctx: Arc<JobContext> = JobContext::new().into();
+            let jobsys: Arc<JobSystem> = JobSystem::new().into();
+
+            let mut leaves = Vec::with_capacity(num_leaves);
+            for i in 0..num_leaves {
+                let job = make_test_job(
+                    ctx.get_next_id(),
+                    format!("leaf_{}", i),
+                    ctx.clone(),
+                    Box::new(move |_| Ok(JobOutcome::Success(Arc::new(TrivialResult(i as i64))))),
+                );
+                leaves.push(job.id);
+                jobsys.add_job(job)?;
+            }
+            let sink = make_test_job(
+                ctx.get_next_id(),
+                "sink".to_owned(),
+                ctx.clone(),
+                Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(-1))))),
+            );
+            jobsys.add_job_with_deps(sink, &leaves)?;
+
+            let start = std::time::Instant::now();
+            JobSystem::run_to_completion(jobsys.clone(), num_workers, dummy_progress_tx())?;
+            samples.push(start.elapsed());
+        }
+
+        samples.sort();
+        let percentile = |p: usize| samples[(samples.len() - 1) * p / 100];
+        println!(
+            "{:>4} leaves, {:>2} workers: p50 {:?}  p99 {:?}  max {:?}",
+            num_leaves,
+            num_workers,
+            percentile(50),
+            percentile(99),
+            samples[samples.len() - 1]
+        );
+    }
+
+    Ok(())
+}
+
+/// Benchmark: 100k fine-grained jobs in layers of 1000, each waiting on 4 jobs of the previous
+/// layer, on every core. Measures contention in dependency bookkeeping rather than job work.
+/// Run with: cargo test --release bench_dependency_contention -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_dependency_contention() -> anyhow::Result<()> {
+    const LAYERS: i64 = 100;
+    const WIDTH: i64 = 1000;
+    const FAN_IN: i64 = 4;
+    let num_workers = std::thread::available_parallelism().map_or(8, |n| n.get());
+
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().into();
+
+    let add_start = std::time::Instant::now();
+    for layer in 0..LAYERS {
+        for i in 0..WIDTH {
+            let job = make_test_job(
+                ctx.get_next_id(),
+                format!("job_{}_{}", layer, i),
+                ctx.clone(),
+                Box::new(move |_| Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))),
+            );
+            if layer == 0 {
+                jobsys.add_job(job)?;
+            } else {
+                let prev_layer = (layer - 1) * WIDTH;
+                let deps: Vec<JobId> = (0..FAN_IN).map(|k| prev_layer + (i * 7 + k * 131) % WIDTH).collect();
+                jobsys.add_job_with_deps(job, &deps)?;
+            }
+        }
+    }
+    let add_duration = add_start.elapsed();
+
+    let run_start = std::time::Instant::now();
+    JobSystem::run_to_completion(jobsys.clone(), num_workers, dummy_progress_tx())?;
+    let run_duration = run_start.elapsed();
+
+    let total = (LAYERS * WIDTH) as f64;
+    assert_eq!(jobsys.num_results(), total as usize);
+    println!(
+        "{} jobs, {} workers: add {:?}, run {:?} ({:.0} jobs/s)",
+        total,
+        num_workers,
+        add_duration,
+        run_duration,
+        total / run_duration.as_secs_f64()
+    );
+
+    Ok(())
+}
+
+#[test]
+fn jobserver_tokens_limit_running_jobs() -> anyhow::Result<()> {
+    // One implicit token plus one in the pipe: at most two jobs may run at once
+    let client = jobserver::Client::new(1)?;
+    let tokens = Arc::new(crate::job_tokens::JobTokens::new(client)?);
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_tokens(Some(tokens)).into();
+
+    let running = Arc::new(AtomicUsize::new(0));
+    let max_running = Arc::new(AtomicUsize::new(0));
+    for i in 0..12 {
+        let running = running.clone();
+        let max_running = max_running.clone();
+        let job = make_ctx_job(
+            &ctx,
+            format!("token_job_{}", i),
+            Box::new(move |_| {
+                let now = running.fetch_add(1, Ordering::SeqCst) + 1;
+                max_running.fetch_max(now, Ordering::SeqCst);
+                std::thread::sleep(std::time::Duration::from_millis(5));
+                running.fetch_sub(1, Ordering::SeqCst);
+                Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))
+            }),
+        );
+        jobsys.add_job(job)?;
+    }
+
+    JobSystem::run_to_completion(jobsys.clone(), 6, dummy_progress_tx())?;
+
+    assert_eq!(jobsys.num_results(), 12);
+    assert!(max_running.load(Ordering::SeqCst) <= 2, "ran {} jobs at once", max_running.load(Ordering::SeqCst));
+    Ok(())
+}
+
+#[test]
+fn memory_budget_limits_heavy_jobs() -> anyhow::Result<()> {
+    // Two 6-byte "links" never fit together in 10 bytes, but 1-byte "compiles" fit beside one
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_memory_budget(Some(10)).into();
+
+    let heavy_running = Arc::new(AtomicUsize::new(0));
+    let max_heavy = Arc::new(AtomicUsize::new(0));
+    for i in 0..16 {
+        let heavy = i % 2 == 0;
+        let heavy_running = heavy_running.clone();
+        let max_heavy = max_heavy.clone();
+        let mut job = make_ctx_job(
+            &ctx,
+            format!("memory_job_{}", i),
+            Box::new(move |_| {
+                if heavy {
+                    let now = heavy_running.fetch_add(1, Ordering::SeqCst) + 1;
+                    max_heavy.fetch_max(now, Ordering::SeqCst);
+                }
+                std::thread::sleep(std::time::Duration::from_millis(2));
+                if heavy {
+                    heavy_running.fetch_sub(1, Ordering::SeqCst);
+                }
+                Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))
+            }),
+        );
+        job.memory = if heavy { 6 } else { 1 };
+        jobsys.add_job(job)?;
+    }
+
+    JobSystem::run_to_completion(jobsys.clone(), 4, dummy_progress_tx())?;
+
+    assert_eq!(jobsys.num_results(), 16);
+    assert_eq!(max_heavy.load(Ordering::SeqCst), 1);
+    Ok(())
+}
+
+#[cfg(unix)]
+#[test]
+fn abort_kills_child_processes() -> anyhow::Result<()> {
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().into();
+
+    let slow = make_ctx_job(
+        &ctx,
+        "slow_tool".to_owned(),
+        Box::new(|_| {
+            let output = crate::rules::rule_utils::run_command(
+                std::path::Path::new("sh"),
+                &["-c".to_owned(), "sleep 30".to_owned()],
+            )?;
+            if !output.status.success() {
+                bail_loc!("Tool exited with [{}]", output.status);
+            }
+            Ok(JobOutcome::Success(Arc::new(TrivialResult(0))))
+        }),
+    );
+    let failing = make_ctx_job(
+        &ctx,
+        "failing".to_owned(),
+        Box::new(|_| {
+            std::thread::sleep(std::time::Duration::from_millis(100));
+            bail_loc!("boom")
+        }),
+    );
+    jobsys.add_job(slow)?;
+    jobsys.add_job(failing)?;
+
+    let start = std::time::Instant::now();
+    assert!(JobSystem::run_to_completion(jobsys.clone(), 2, dummy_progress_tx()).is_err());
+    assert!(start.elapsed() < std::time::Duration::from_secs(10));
+    Ok(())
+}
+
+#[test]
+fn keep_going_skips_only_dependents() -> anyhow::Result<()> {
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_keep_going(true).into();
+    let ran = Arc::new(AtomicUsize::new(0));
+
+    // broken <- dependent <- grand_dependent, plus independent jobs that must still run
+    let broken = make_ctx_job(&ctx, "broken".to_owned(), Box::new(|_| bail_loc!("broken TU")));
+    let broken_id = broken.id;
+    jobsys.add_job(broken)?;
+
+    let counting_job = |desc: &str| {
+        let ran = ran.clone();
+        make_ctx_job(
+            &ctx,
+            desc.to_owned(),
+            Box::new(move |_| {
+                ran.fetch_add(1, Ordering::SeqCst);
+                Ok(JobOutcome::Success(Arc::new(TrivialResult(1))))
+            }),
+        )
+    };
+    let dependent = counting_job("dependent");
+    let dependent_id = dependent.id;
+    jobsys.add_job_with_deps(dependent, &[broken_id])?;
+    let grand_dependent = counting_job("grand_dependent");
+    let grand_dependent_id = grand_dependent.id;
+    jobsys.add_job_with_deps(grand_dependent, &[dependent_id])?;
+
+    let mut independent_ids = Vec::new();
+    for i in 0..10 {
+        let job = counting_job(&format!("independent_{}", i));
+        independent_ids.push(job.id);
+        jobsys.add_job(job)?;
+    }
+
+    let result = JobSystem::run_to_completion(jobsys.clone(), 3, dummy_progress_tx());
+    assert!(result.is_err());
+
+    assert_eq!(ran.load(Ordering::SeqCst), 10);
+    for id in independent_ids {
+        assert_eq!(jobsys.expect_result::<TrivialResult>(id)?.0, 1);
+    }
+    assert!(jobsys.get_result(dependent_id).is_err());
+    assert!(jobsys.get_result(grand_dependent_id).is_err());
+    assert_eq!(jobsys.num_skipped(), 2);
+    assert_eq!(jobsys.num_blocked(), 0);
+
+    let failures = jobsys.failures();
+    assert_eq!(failures.len(), 1);
+    assert_eq!(failures[0].job_id, broken_id);
+    Ok(())
+}
+
+#[test]
+fn keep_going_fails_deferred_parents() -> anyhow::Result<()> {
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_keep_going(true).into();
+    let ctx: Arc<JobContext> = Arc::new(JobContext {
+        anubis: Default::default(),
+        job_system: jobsys.clone(),
+        mode: None,
+        toolchain: None,
+    });
+
+    // A parent defers on a child that fails; whatever waits on the parent must be skipped too
+    let parent = make_ctx_job(
+        &ctx,
+        "parent".to_owned(),
+        Box::new(|job: Job| {
+            let child = make_ctx_job(&job.ctx, "failing_child".to_owned(), Box::new(|_| bail_loc!("child failed")));
+            let child_id = child.id;
+            job.ctx.job_system.add_job(child)?;
+            let continuation = make_ctx_job(
+                &job.ctx,
+                "parent_continuation".to_owned(),
+                Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(2))))),
+            );
+            Ok(JobOutcome::Deferred(JobDeferral {
+                blocked_by: vec![child_id],
+                continuation_job: continuation,
+            }))
+        }),
+    );
+    let parent_id = parent.id;
+    jobsys.add_job(parent)?;
+
+    let waiter = make_ctx_job(
+        &ctx,
+        "waiter".to_owned(),
+        Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(3))))),
+    );
+    let waiter_id = waiter.id;
+    jobsys.add_job_with_deps(waiter, &[parent_id])?;
+
+    assert!(JobSystem::run_to_completion(jobsys.clone(), 2, dummy_progress_tx()).is_err());
+    assert!(jobsys.get_result(parent_id).is_err());
+    assert!(jobsys.get_result(waiter_id).is_err());
+    assert_eq!(jobsys.num_blocked(), 0);
+    assert_eq!(jobsys.failures().len(), 1);
+    Ok(())
+}
+
+#[test]
+fn inline_jobs_skip_queue_and_progress() -> anyhow::Result<()> {
+    let jobsys: Arc<JobSystem> = JobSystem::new().into();
+    let ctx: Arc<JobContext> = Arc::new(JobContext {
+        anubis: Default::default(),
+        job_system: jobsys.clone(),
+        mode: None,
+        toolchain: None,
+    });
+
+    // leaves <- inline marker <- consumer, plus a parent deferring to an inline continuation
+    let mut leaf_ids = Vec::new();
+    for i in 0..8 {
+        let leaf = make_ctx_job(
+            &ctx,
+            format!("leaf_{}", i),
+            Box::new(move |_| Ok(JobOutcome::Success(Arc::new(TrivialResult(i))))),
+        );
+        leaf_ids.push(leaf.id);
+        jobsys.add_job(leaf)?;
+    }
+    let marker = ctx.new_inline_job(
+        "marker".to_owned(),
+        JobDisplayInfo::from_desc("marker"),
+        Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(100))))),
+    );
+    let marker_id = marker.id;
+    jobsys.add_job_with_deps(marker, &leaf_ids)?;
+
+    let marker_deps_done = Arc::new(AtomicBool::new(false));
+    let consumer = {
+        let leaf_ids = leaf_ids.clone();
+        let marker_deps_done = marker_deps_done.clone();
+        make_ctx_job(
+            &ctx,
+            "consumer".to_owned(),
+            Box::new(move |job: Job| {
+                let all_leaves = leaf_ids.iter().all(|&id| job.ctx.job_system.get_result(id).is_ok());
+                marker_deps_done.store(all_leaves, Ordering::SeqCst);
+                let marker = job.ctx.job_system.expect_result::<TrivialResult>(marker_id)?;
+                Ok(JobOutcome::Success(Arc::new(TrivialResult(marker.0 + 1))))
+            }),
+        )
+    };
+    let consumer_id = consumer.id;
+    jobsys.add_job_with_deps(consumer, &[marker_id])?;
+
+    let parent = make_ctx_job(
+        &ctx,
+        "parent".to_owned(),
+        Box::new(|job: Job| {
+            let child = make_ctx_job(
+                &job.ctx,
+                "child".to_owned(),
+                Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(7))))),
+            );
+            let child_id = child.id;
+            job.ctx.job_system.add_job(child)?;
+            let ctx = job.ctx.clone();
+            let continuation = job.ctx.new_inline_job(
+                "parent (aggregate)".to_owned(),
+                JobDisplayInfo::from_desc("parent (aggregate)"),
+                Box::new(move |_| {
+                    let child = ctx.job_system.expect_result::<TrivialResult>(child_id)?;
+                    Ok(JobOutcome::Success(Arc::new(TrivialResult(child.0 * 2))))
+                }),
+            );
+            Ok(JobOutcome::Deferred(JobDeferral {
+                blocked_by: vec![child_id],
+                continuation_job: continuation,
+            }))
+        }),
+    );
+    let parent_id = parent.id;
+    jobsys.add_job(parent)?;
+    let waiter = make_ctx_job(
+        &ctx,
+        "waiter".to_owned(),
+        Box::new(move |job: Job| {
+            let parent = job.ctx.job_system.expect_result::<TrivialResult>(parent_id)?;
+            Ok(JobOutcome::Success(Arc::new(TrivialResult(parent.0 + 1))))
+        }),
+    );
+    let waiter_id = waiter.id;
+    jobsys.add_job_with_deps(waiter, &[parent_id])?;
+
+    let (progress_tx, progress_rx) = crossbeam::channel::unbounded();
+    JobSystem::run_to_completion(jobsys.clone(), 3, progress_tx)?;
+
+    assert_eq!(jobsys.expect_result::<TrivialResult>(marker_id)?.0, 100);
+    assert_eq!(jobsys.expect_result::<TrivialResult>(consumer_id)?.0, 101);
+    assert!(marker_deps_done.load(Ordering::SeqCst));
+    assert_eq!(jobsys.expect_result::<TrivialResult>(parent_id)?.0, 14);
+    assert_eq!(jobsys.expect_result::<TrivialResult>(waiter_id)?.0, 15);
+    assert_eq!(jobsys.num_blocked(), 0);
+
+    // Only the queued jobs report progress: 8 leaves, consumer, parent's child, waiter
+    let completed: Vec<String> = progress_rx
+        .try_iter()
+        .filter_map(|event| match event {
+            ProgressEvent::JobCompleted { display, .. } => Some(display.short_name),
+            _ => None,
+        })
+        .collect();
+    assert_eq!(completed.len(), 11, "{:?}", completed);
+    assert!(!completed.iter().any(|name| name.contains("marker") || name.contains("aggregate")));
+    Ok(())
+}
+
+#[test]
+fn failing_inline_job_fails_dependents() -> anyhow::Result<()> {
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_keep_going(true).into();
+
+    let leaf = make_ctx_job(
+        &ctx,
+        "leaf".to_owned(),
+        Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(1))))),
+    );
+    let leaf_id = leaf.id;
+    jobsys.add_job(leaf)?;
+    let marker = ctx.new_inline_job(
+        "marker".to_owned(),
+        JobDisplayInfo::from_desc("marker"),
+        Box::new(|_| bail_loc!("marker failed")),
+    );
+    let marker_id = marker.id;
+    jobsys.add_job_with_deps(marker, &[leaf_id])?;
+    let dependent = make_ctx_job(
+        &ctx,
+        "dependent".to_owned(),
+        Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(2))))),
+    );
+    let dependent_id = dependent.id;
+    jobsys.add_job_with_deps(dependent, &[marker_id])?;
+
+    assert!(JobSystem::run_to_completion(jobsys.clone(), 2, dummy_progress_tx()).is_err());
+    assert!(jobsys.get_result(leaf_id).is_ok());
+    assert!(jobsys.get_result(marker_id).is_err());
+    assert!(jobsys.get_result(dependent_id).is_err());
+    assert_eq!(jobsys.num_skipped(), 1);
+    assert_eq!(jobsys.num_blocked(), 0);
+    assert_eq!(jobsys.failures()[0].job_id, marker_id);
+    Ok(())
+}
+
+#[cfg(unix)]
+#[test]
+fn tools_run_without_holding_a_worker() -> anyhow::Result<()> {
+    const TOOLS: i64 = 4;
+
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_tool_limit(TOOLS as usize).into();
+    let ctx: Arc<JobContext> = Arc::new(JobContext {
+        anubis: Default::default(),
+        job_system: jobsys.clone(),
+        mode: None,
+        toolchain: None,
+    });
+
+    let mut ids = Vec::new();
+    for i in 0..TOOLS {
+        let job = make_ctx_job(
+            &ctx,
+            format!("tool_{}", i),
+            Box::new(move |job| {
+                let mut command = std::process::Command::new("sh");
+                command.args(["-c", &format!("sleep 0.5; exit {}", i)]);
+                let tool_id = job.ctx.job_system.spawn_tool(&mut command, format!("sleep {}", i))?;
+                let finish = move |job: Job| {
+                    let exit = job.ctx.job_system.expect_result::<ChildExit>(tool_id)?;
+                    let code = exit.output.status.code().unwrap_or(-1) as i64;
+                    Ok(JobOutcome::Success(Arc::new(TrivialResult(code))))
+                };
+                Ok(JobOutcome::Deferred(JobDeferral {
+                    blocked_by: vec![tool_id],
+                    continuation_job: make_ctx_job(&job.ctx, format!("finish_{}", i), Box::new(finish)),
+                }))
+            }),
+        );
+        ids.push(job.id);
+        jobsys.add_job(job)?;
+    }
+
+    // One worker would take 2s if each tool held it until its child exited
+    let start = std::time::Instant::now();
+    JobSystem::run_to_completion(jobsys.clone(), 1, dummy_progress_tx())?;
+    assert!(start.elapsed() < std::time::Duration::from_millis(1500), "{:?}", start.elapsed());
+
+    for (i, id) in ids.into_iter().enumerate() {
+        assert_eq!(jobsys.expect_result::<TrivialResult>(id)?.0, i as i64);
+    }
+    assert_eq!(jobsys.num_blocked(), 0);
+    Ok(())
+}
+
+#[test]
+fn deferring_onto_a_failed_job_skips_the_continuation() -> anyhow::Result<()> {
+    let jobsys: Arc<JobSystem> = JobSystem::new().with_keep_going(true).into();
+    let ctx: Arc<JobContext> = Arc::new(JobContext {
+        anubis: Default::default(),
+        job_system: jobsys.clone(),
+        mode: None,
+        toolchain: None,
+    });
+
+    let failing = make_ctx_job(&ctx, "failing".to_owned(), Box::new(|_| bail_loc!("failing failed")));
+    let failing_id = failing.id;
+    jobsys.add_job(failing)?;
+
+    // Both wait for the failure to be stored, then defer onto the failed job
+    let defer_onto_failure = move |desc: &'static str| -> Box<JobFn> {
+        Box::new(move |job: Job| {
+            while job.ctx.job_system.get_result(failing_id).is_ok() {
+                std::thread::yield_now();
+            }
+            let continuation = make_ctx_job(
+                &job.ctx,
+                format!("{} continuation", desc),
+                Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(0))))),
+            );
+            Ok(JobOutcome::Deferred(JobDeferral {
+                blocked_by: vec![failing_id],
+                continuation_job: continuation,
+            }))
+        })
+    };
+    let deferring = make_ctx_job(&ctx, "deferring".to_owned(), defer_onto_failure("deferring"));
+    let deferring_id = deferring.id;
+    jobsys.add_job(deferring)?;
+
+    let leaf = make_ctx_job(
+        &ctx,
+        "leaf".to_owned(),
+        Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(1))))),
+    );
+    let leaf_id = leaf.id;
+    jobsys.add_job(leaf)?;
+    let inline = ctx.new_inline_job(
+        "inline".to_owned(),
+        JobDisplayInfo::from_desc("inline"),
+        defer_onto_failure("inline"),
+    );
+    let inline_id = inline.id;
+    jobsys.add_job_with_deps(inline, &[leaf_id])?;
+
+    let dependent = make_ctx_job(
+        &ctx,
+        "dependent".to_owned(),
+        Box::new(|_| Ok(JobOutcome::Success(Arc::new(TrivialResult(2))))),
+    );
+    let dependent_id = dependent.id;
+    jobsys.add_job_with_deps(dependent, &[deferring_id, inline_id])?;
+
+    assert!(JobSystem::run_to_completion(jobsys.clone(), 2, dummy_progress_tx()).is_err());
+    assert_eq!(jobsys.expect_result::<TrivialResult>(leaf_id)?.0, 1);
+    assert!(jobsys.get_result(deferring_id).is_err());
+    assert!(jobsys.get_result(inline_id).is_err());
+    assert!(jobsys.get_result(dependent_id).is_err());
+
+    // Both continuations and the dependent, which only the first of its failed deps skips
+    assert_eq!(jobsys.num_skipped(), 3);
+    assert_eq!(jobsys.num_blocked(), 0);
+    assert_eq!(jobsys.failures().len(), 1);
+    assert_eq!(jobsys.failures()[0].job_id, failing_id);
+    Ok(())
+}
@@ -0,0 +1,212 @@
+//! GNU make jobserver support.
+//!
+//! A jobserver is a pipe (or named FIFO) preloaded with one byte per job slot beyond the one
+//! every process implicitly owns. Make advertises it to children in `MAKEFLAGS` with
+//! `--jobserver-auth`. A process reads a byte before starting extra work and writes it back
+//! when that work is done.
+//!
+//! When anubis is started by make (or cargo, or another anubis) it joins that jobserver, and
+//! every worker takes a token before running a job, so the whole process tree stays within the
+//! outer `-j`. Otherwise anubis serves its own jobserver with one token per worker. Either way
+//! the jobserver is handed to every tool started by `run_command_verbose`, so tools that speak
+//! the protocol (LTO linkers, make, ninja, a nested anubis) draw from the same budget instead of
+//! oversubscribing the machine.
+
+use anyhow::Context;
+use std::process::Command;
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
+
+use crate::{anyhow_loc, function_name};
+
+/// What `capture_inherited` found in the environment, consumed by `init`.
+static INHERITED: Mutex<Option<jobserver::FromEnv>> = Mutex::new(None);
+
+/// The jobserver of this process once `init` has run.
+static JOB_TOKENS: OnceLock<Arc<JobTokens>> = OnceLock::new();
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+/// Hands out jobserver tokens to job system workers.
+pub struct JobTokens {
+    client: jobserver::Client,
+    shared: Arc<TokenState>,
+    /// Reads tokens from the jobserver on behalf of waiting workers. Blocking reads can't be
+    /// cancelled, so workers wait on `shared` instead of reading the pipe themselves.
+    helper: jobserver::HelperThread,
+}
+
+/// Permission to run one job. Returned to the pool on drop, which may outlive the job that took
+/// it (e.g. when handed to a tool the job started).
+pub struct JobToken {
+    shared: Arc<TokenState>,
+    held: HeldToken,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Default)]
+struct TokenState {
+    pool: Mutex<TokenPool>,
+    cvar: Condvar,
+}
+
+#[derive(Default)]
+struct TokenPool {
+    /// The token this process owns without reading the jobserver.
+    implicit_taken: bool,
+    /// Tokens read by the helper and not yet claimed by a worker.
+    acquired: Vec<jobserver::Acquired>,
+    waiting: usize,
+    requested: usize,
+    /// Set if the jobserver broke mid-build. Jobs then run without a limit rather than stalling.
+    unlimited: bool,
+}
+
+enum HeldToken {
+    Implicit,
+    Acquired(jobserver::Acquired),
+    Unlimited,
+}
+
+// ----------------------------------------------------------------------------
+// Public functions
+// ----------------------------------------------------------------------------
+/// Claims the jobserver advertised in `MAKEFLAGS`, if any. Must run first thing in `main`:
+/// the descriptors it names are only trustworthy before this process opens files of its own,
+/// and the variables are gone once `build` clears the environment.
+pub fn capture_inherited() {
+    // SAFETY: nothing has opened a file descriptor yet, so any descriptor named in MAKEFLAGS
+    // was inherited from the parent. `check_pipe` additionally rejects anything that isn't a pipe.
+    let from_env = unsafe { jobserver::Client::from_env_ext(true) };
+    *INHERITED.lock().unwrap() = Some(from_env);
+}
+
+/// Sets up this process's jobserver: the inherited one if `capture_inherited` found one,
+/// otherwise a new one with `num_workers` tokens. Returns `None` if neither is available.
+pub fn init(num_workers: usize) -> Option<Arc<JobTokens>> {
+    if let Some(tokens) = JOB_TOKENS.get() {
+        return Some(tokens.clone());
+    }
+
+    let client = match INHERITED.lock().unwrap().take().map(|from_env| from_env.client) {
+        Some(Ok(client)) => {
+            tracing::info!("Joining inherited make jobserver");
+            Ok(client)
+        }
+        inherited => {
+            if let Some(Err(e)) = inherited {
+                use jobserver::FromEnvErrorKind::*;
+                if !matches!(e.kind(), NoEnvVar | NoJobserver) {
+                    tracing::warn!("Ignoring inherited make jobserver: {}", e);
+                }
+            }
+            // The implicit token covers one worker, the pipe holds the rest
+            jobserver::Client::new(num_workers.saturating_sub(1))
+        }
+    };
+
+    match client.map_err(anyhow::Error::from).and_then(JobTokens::new) {
+        Ok(tokens) => Some(JOB_TOKENS.get_or_init(|| Arc::new(tokens)).clone()),
+        Err(e) => {
+            tracing::warn!("Running without a jobserver: {}", e);
+            None
+        }
+    }
+}
+
+/// This process's jobserver, if `init` set one up.
+pub fn get() -> Option<Arc<JobTokens>> {
+    JOB_TOKENS.get().cloned()
+}
+
+/// Passes this process's jobserver to a child through `MAKEFLAGS` and inherited descriptors.
+pub fn configure_command(cmd: &mut Command) {
+    if let Some(tokens) = JOB_TOKENS.get() {
+        tokens.configure(cmd);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl JobTokens {
+    pub fn new(client: jobserver::Client) -> anyhow::Result<JobTokens> {
+        let shared: Arc<TokenState> = Default::default();
+        let helper_state = shared.clone();
+        let helper = client
+            .clone()
+            .into_helper_thread(move |token| helper_state.token_arrived(token))
+            .with_context(|| anyhow_loc!("Failed to start jobserver helper thread"))?;
+        Ok(JobTokens { client, shared, helper })
+    }
+
+    /// Blocks until this process may run one more job.
+    pub fn acquire(&self) -> JobToken {
+        let mut pool = self.shared.pool.lock().unwrap();
+        pool.waiting += 1;
+        let held = loop {
+            if !pool.implicit_taken {
+                pool.implicit_taken = true;
+                break HeldToken::Implicit;
+            }
+            if let Some(acquired) = pool.acquired.pop() {
+                break HeldToken::Acquired(acquired);
+            }
+            if pool.unlimited {
+                break HeldToken::Unlimited;
+            }
+            if pool.requested < pool.waiting {
+                pool.requested += 1;
+                self.helper.request_token();
+            }
+            pool = self.shared.cvar.wait(pool).unwrap();
+        };
+        pool.waiting -= 1;
+        JobToken {
+            shared: self.shared.clone(),
+            held,
+        }
+    }
+
+    /// Lets `cmd` take tokens from this jobserver.
+    pub fn configure(&self, cmd: &mut Command) {
+        self.client.configure_make(cmd);
+    }
+}
+
+impl TokenState {
+    fn token_arrived(&self, token: std::io::Result<jobserver::Acquired>) {
+        let mut pool = self.pool.lock().unwrap();
+        pool.requested = pool.requested.saturating_sub(1);
+        match token {
+            // Nobody is waiting anymore: dropping the token writes it back to the jobserver
+            Ok(acquired) if pool.waiting == 0 => drop(acquired),
+            Ok(acquired) => {
+                pool.acquired.push(acquired);
+                self.cvar.notify_one();
+            }
+            Err(e) => {
+                tracing::warn!("Jobserver failed, running jobs without a limit: {}", e);
+                pool.unlimited = true;
+                self.cvar.notify_all();
+            }
+        }
+    }
+}
+
+impl Drop for JobToken {
+    fn drop(&mut self) {
+        let shared = &self.shared;
+        let mut pool = shared.pool.lock().unwrap();
+        match std::mem::replace(&mut self.held, HeldToken::Unlimited) {
+            HeldToken::Implicit => pool.implicit_taken = false,
+            // Hand the token straight to a waiting worker instead of bouncing it through the pipe
+            HeldToken::Acquired(acquired) if pool.waiting > 0 => pool.acquired.push(acquired),
+            HeldToken::Acquired(acquired) => drop(acquired),
+            HeldToken::Unlimited => return,
+        }
+        shared.cvar.notify_one();
+    }
+}
@@ -0,0 +1,66 @@
+//! Tests for job_tokens.rs
+
+use crate::job_tokens::*;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+
+#[test]
+fn tokens_are_shared_between_threads() -> anyhow::Result<()> {
+    // The implicit token plus two in the pipe
+    let tokens = Arc::new(JobTokens::new(jobserver::Client::new(2)?)?);
+    let running = Arc::new(AtomicUsize::new(0));
+    let max_running = Arc::new(AtomicUsize::new(0));
+
+    std::thread::scope(|scope| {
+        for _ in 0..8 {
+            let (tokens, running, max_running) = (&tokens, &running, &max_running);
+            scope.spawn(move || {
+                for _ in 0..4 {
+                    let _token = tokens.acquire();
+                    let now = running.fetch_add(1, Ordering::SeqCst) + 1;
+                    max_running.fetch_max(now, Ordering::SeqCst);
+                    std::thread::sleep(Duration::from_millis(2));
+                    running.fetch_sub(1, Ordering::SeqCst);
+                }
+            });
+        }
+    });
+
+    assert!(max_running.load(Ordering::SeqCst) <= 3);
+    Ok(())
+}
+
+#[test]
+fn released_tokens_return_to_the_jobserver() -> anyhow::Result<()> {
+    let client = jobserver::Client::new(2)?;
+    let tokens = JobTokens::new(client.clone())?;
+
+    {
+        let _a = tokens.acquire();
+        let _b = tokens.acquire();
+        let _c = tokens.acquire();
+    }
+
+    // Give the helper a moment to hand back any token it read after the last waiter left
+    let deadline = std::time::Instant::now() + Duration::from_secs(5);
+    while client.available()? != 2 && std::time::Instant::now() < deadline {
+        std::thread::sleep(Duration::from_millis(5));
+    }
+    assert_eq!(client.available()?, 2);
+    Ok(())
+}
+
+#[cfg(unix)]
+#[test]
+fn child_processes_see_the_jobserver() -> anyhow::Result<()> {
+    let tokens = JobTokens::new(jobserver::Client::new(1)?)?;
+    let mut cmd = std::process::Command::new("sh");
+    cmd.args(["-c", "echo \"$MAKEFLAGS\""]);
+    tokens.configure(&mut cmd);
+
+    let output = cmd.output()?;
+    let makeflags = String::from_utf8_lossy(&output.stdout);
+    assert!(makeflags.contains("--jobserver-auth="), "MAKEFLAGS was [{}]", makeflags.trim());
+    Ok(())
+}
@@ -1,3 +1,4 @@
+use crate::job_system::JOB_USAGE_TARGET;
 use crate::progress::ProgressEvent;
 use crate::{anyhow_loc, function_name};
 use anyhow::Result;
@@ -8,6 +9,7 @@ use std::path::PathBuf;
 use std::sync::Mutex;
 use tracing::{Event, Subscriber};
 use tracing_chrome::FlushGuard;
+use tracing_subscriber::filter::filter_fn;
 use tracing_subscriber::fmt::format::{self, FormatEvent, FormatFields};
 use tracing_subscriber::fmt::FmtContext;
 use tracing_subscriber::registry::LookupSpan;
@@ -300,7 +302,8 @@ pub fn init_logging(config: &LogConfig) -> Result<()> {
 /// Uses a custom format for console output that doesn't include span context,
 /// keeping logs clean while spans are captured for the profile.
 pub fn init_logging_with_profile(config: &LogConfig, trace_path: &PathBuf) -> Result<FlushGuard> {
-    let filter = EnvFilter::new(config.level.as_str());
+    let filter =
+        EnvFilter::new(config.level.as_str()).add_directive(format!("{}=trace", JOB_USAGE_TARGET).parse()?);
 
     // Create chrome tracing layer for profile output
     let (chrome_layer, guard) =
@@ -309,7 +312,11 @@ pub fn init_logging_with_profile(config: &LogConfig, trace_path: &PathBuf) -> Re
     // Create console layer with PlainEventFormat to avoid span context in output.
     // This keeps console logs looking like normal (e.g., "INFO Running job: [99] ...")
     // while the chrome layer captures full span hierarchy for profiling.
-    let console_layer = tracing_subscriber::fmt::layer().event_format(PlainEventFormat).boxed();
+    // Per-job tool usage is only meant for the profile, so the console drops it.
+    let console_layer = tracing_subscriber::fmt::layer()
+        .event_format(PlainEventFormat)
+        .with_filter(filter_fn(|meta| meta.target() != JOB_USAGE_TARGET))
+        .boxed();
 
     tracing_subscriber::registry().with(filter).with(console_layer).with(chrome_layer).init();
 
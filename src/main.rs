@@ -3,30 +3,65 @@
 #![allow(unused_imports)]
 #![allow(unused_mut)]
 
+mod action_cache;
 mod anubis;
+mod build_journal;
+mod build_snapshot;
 mod error;
+mod glob_cache;
 mod install_toolchains;
+mod job_history;
 mod job_system;
+mod job_tokens;
 mod logging;
+mod memory_budget;
 mod papyrus;
 mod papyrus_serde;
+mod papyrus_snapshot;
+mod process_reactor;
 mod progress;
+mod remote_cache;
 mod rules;
 mod toolchain;
 mod toolchain_db;
 mod util;
 
+#[cfg(test)]
+mod action_cache_tests;
 #[cfg(test)]
 mod anubis_tests;
 #[cfg(test)]
+mod build_journal_tests;
+#[cfg(test)]
+mod build_snapshot_tests;
+#[cfg(test)]
+mod glob_cache_tests;
+#[cfg(test)]
+mod job_history_tests;
+#[cfg(test)]
+mod job_system_sim;
+#[cfg(test)]
+mod job_system_sim_tests;
+#[cfg(test)]
 mod job_system_tests;
 #[cfg(test)]
+mod job_tokens_tests;
+#[cfg(test)]
+mod memory_budget_tests;
+#[cfg(test)]
+mod papyrus_snapshot_tests;
+#[cfg(test)]
 mod papyrus_tests;
 #[cfg(test)]
+mod process_reactor_tests;
+#[cfg(test)]
+mod remote_cache_tests;
+#[cfg(test)]
 mod test_utils;
 #[cfg(test)]
 mod util_tests;
 
+use action_cache::ActionCache;
 use anubis::*;
 use camino::Utf8PathBuf;
 use dashmap::DashMap;
@@ -35,6 +70,7 @@ use job_system::*;
 use logging::*;
 use logos::Logos;
 use papyrus::*;
+use remote_cache::{CacheServer, RemoteCache};
 use rules::*;
 use serde::Deserialize;
 use std::any;
@@ -66,6 +102,10 @@ struct Args {
     #[arg(short, long, global = true)]
     workers: Option<usize>,
 
+    /// Memory budget for running jobs, e.g. 64G (defaults to available memory, capped by the cgroup limit)
+    #[arg(long, global = true, value_parser = util::parse_byte_size)]
+    memory: Option<u64>,
+
     /// Disable live progress display; use plain scrolling output instead
     #[arg(long, global = true)]
     no_tui: bool,
@@ -84,6 +124,8 @@ enum Commands {
     Dump(DumpArgs),
     Run(RunArgs),
     InstallToolchains(InstallToolchainsArgs),
+    Cache(CacheArgs),
+    CacheServer(CacheServerArgs),
 }
 
 #[derive(Debug, Parser)]
@@ -97,6 +139,10 @@ struct RunArgs {
     /// Arguments to pass to the executable
     #[arg(last = true)]
     args: Vec<String>,
+
+    /// Remote cache shared between machines (e.g., http://cache.local:9092)
+    #[arg(long)]
+    remote_cache: Option<String>,
 }
 
 #[derive(Debug, Parser)]
@@ -106,6 +152,44 @@ struct BuildArgs {
 
     #[arg(short, long, required = true, visible_alias = "target", num_args = 1..)]
     targets: Vec<String>,
+
+    /// Remote cache shared between machines (e.g., http://cache.local:9092)
+    #[arg(long)]
+    remote_cache: Option<String>,
+
+    /// Keep building everything that doesn't depend on a failed job, then report all failures
+    #[arg(short, long)]
+    keep_going: bool,
+}
+
+#[derive(Debug, Parser)]
+struct CacheArgs {
+    #[command(subcommand)]
+    command: CacheCommands,
+}
+
+#[derive(Debug, Subcommand)]
+enum CacheCommands {
+    /// Evict least-recently-used entries from the shared cache (~/.anubis/cache)
+    Gc(CacheGcArgs),
+}
+
+#[derive(Debug, Parser)]
+struct CacheGcArgs {
+    /// Maximum size of the store after eviction (e.g., 512M, 20G)
+    #[arg(long, default_value = "20G", value_parser = util::parse_byte_size)]
+    max_size: u64,
+}
+
+#[derive(Debug, Parser)]
+struct CacheServerArgs {
+    /// Directory to serve (defaults to ~/.anubis/cache/server)
+    #[arg(long)]
+    dir: Option<Utf8PathBuf>,
+
+    /// Port to listen on (localhost only)
+    #[arg(long, default_value_t = 9092)]
+    port: u16,
 }
 
 #[derive(Debug, Parser)]
@@ -134,7 +218,7 @@ fn dump(args: &DumpArgs, verbose_tools: bool) -> anyhow::Result<()> {
         .to_owned();
 
     // Create anubis
-    let anubis = Anubis::new(project_root, verbose_tools)?;
+    let anubis = Anubis::new(project_root, util::get_global_cache_dir(), verbose_tools)?;
 
     // Parse mode and target
     let mode_target = AnubisTarget::new(&args.mode)?;
@@ -143,12 +227,8 @@ fn dump(args: &DumpArgs, verbose_tools: bool) -> anyhow::Result<()> {
     // Get mode
     let mode = anubis.get_mode(&mode_target)?;
 
-    // Get resolved config for the target
-    let config_relpath = target.get_config_relpath();
-    let resolved_config = anubis.get_resolved_config(&config_relpath, &mode)?;
-
-    // Find the specific target within the config
-    let target_value = resolved_config.get_named_object(target.target_name())?;
+    // Resolve just the target's object within its config
+    let target_value = anubis.get_resolved_object(&target, &mode)?;
 
     // Format and print the resolved target
     println!("# Resolved target: {} with mode: {}", args.target, args.mode);
@@ -157,14 +237,44 @@ fn dump(args: &DumpArgs, verbose_tools: bool) -> anyhow::Result<()> {
         println!("#   {} = {}", k, v);
     }
     println!();
-    println!("{}", papyrus::format_value(target_value, 0));
+    println!("{}", papyrus::format_value(&target_value, 0));
 
     Ok(())
 }
 
+fn cache(args: &CacheArgs) -> anyhow::Result<()> {
+    let action_cache = ActionCache::new(util::get_global_cache_dir());
+    match &args.command {
+        CacheCommands::Gc(gc) => {
+            tracing::info!(
+                "Collecting garbage in [{}] (max size {})",
+                action_cache.dir(),
+                util::format_bytes(gc.max_size)
+            );
+            let stats = action_cache.gc(gc.max_size)?;
+            tracing::info!(
+                "Evicted {} blobs ({}) and {} manifests; {} remaining",
+                stats.blobs_removed,
+                util::format_bytes(stats.bytes_removed),
+                stats.manifests_removed,
+                util::format_bytes(stats.bytes_remaining)
+            );
+        }
+    }
+    Ok(())
+}
+
+fn cache_server(args: &CacheServerArgs) -> anyhow::Result<()> {
+    let dir = args.dir.clone().unwrap_or_else(|| util::get_global_cache_dir().join("server"));
+    let server = CacheServer::bind(dir.clone(), &format!("127.0.0.1:{}", args.port))?;
+    tracing::info!("Serving remote cache [{}] on http://{}", dir, server.local_addr()?);
+    server.run()
+}
+
 fn build(
     args: &BuildArgs,
     workers: Option<usize>,
+    memory: Option<u64>,
     verbose_tools: bool,
     no_tui: bool,
     log_level: LogLevel,
@@ -172,6 +282,9 @@ fn build(
 ) -> anyhow::Result<()> {
     tracing::info!("Starting Anubis build command: [{:?}]", args);
 
+    // Resolve the shared cache before HOME/USERPROFILE are cleared below
+    let global_cache_dir = util::get_global_cache_dir();
+
     // Nuke environment variables to ensure clean build environment
     let keys: Vec<_> = std::env::vars_os().map(|(key, _)| key).collect();
     for key in keys {
@@ -195,7 +308,15 @@ fn build(
     tracing::debug!("Found project root: {:?}", project_root);
 
     // Create anubis with the discovered project root
-    let anubis = Arc::new(Anubis::new(project_root.clone(), verbose_tools)?);
+    let mut anubis = Anubis::new(project_root.clone(), global_cache_dir, verbose_tools)?;
+    anubis.action_cache.set_root(project_root.clone());
+    if let Some(url) = &args.remote_cache {
+        anubis.action_cache.set_remote(RemoteCache::new(url)?);
+    }
+    anubis.memory_budget = memory.or_else(memory_budget::detect_available_memory);
+    anubis.keep_going = args.keep_going;
+    process_reactor::set_capture_dir(project_root.join(".anubis-build").join("tmp").into_std_path_buf());
+    let anubis = Arc::new(anubis);
 
     // Expand any target patterns (e.g., "//samples/basic/..." -> all targets under samples/basic/)
     let expanded_targets = expand_targets(&args.targets, project_root.as_std_path(), &anubis.rule_typeinfos)?;
@@ -225,12 +346,14 @@ fn build(
     // Create progress display for live build output
     // Drop impl handles shutdown (prints summary, clears TUI) on both success and error paths.
     let num_workers = workers.unwrap_or_else(num_cpus::get_physical);
+    job_tokens::init(num_workers);
     let progress = progress::ProgressDisplay::new(num_workers, is_tty, no_tui, log_level);
 
     // Build all targets together with a shared JobSystem
     // This ensures job caches remain valid (job IDs are per-JobSystem)
     let _build_span = timed_span!(tracing::Level::INFO, "build_execution");
-    build_targets(anubis, &mode, &toolchain, &anubis_targets, num_workers, progress.sender())?;
+    let progress_tx = progress.sender();
+    build_targets_unless_up_to_date(anubis, &mode, &toolchain, &anubis_targets, num_workers, progress_tx)?;
 
     Ok(())
 }
@@ -265,6 +388,7 @@ fn expand_targets(
 fn run(
     args: &RunArgs,
     workers: Option<usize>,
+    memory: Option<u64>,
     verbose_tools: bool,
     no_tui: bool,
     log_level: LogLevel,
@@ -272,6 +396,9 @@ fn run(
 ) -> anyhow::Result<()> {
     tracing::info!("Starting Anubis run command: [{:?}]", args);
 
+    // Resolve the shared cache before HOME/USERPROFILE are cleared below
+    let global_cache_dir = util::get_global_cache_dir();
+
     // Nuke environment variables to ensure clean build environment
     let keys: Vec<_> = std::env::vars_os().map(|(key, _)| key).collect();
     for key in keys {
@@ -295,7 +422,14 @@ fn run(
     tracing::debug!("Found project root: {:?}", project_root);
 
     // Create anubis with the discovered project root
-    let anubis = Arc::new(Anubis::new(project_root.clone(), verbose_tools)?);
+    let mut anubis = Anubis::new(project_root.clone(), global_cache_dir, verbose_tools)?;
+    anubis.action_cache.set_root(project_root.clone());
+    if let Some(url) = &args.remote_cache {
+        anubis.action_cache.set_remote(RemoteCache::new(url)?);
+    }
+    anubis.memory_budget = memory.or_else(memory_budget::detect_available_memory);
+    process_reactor::set_capture_dir(project_root.join(".anubis-build").join("tmp").into_std_path_buf());
+    let anubis = Arc::new(anubis);
 
     // Build the target
     let mode = AnubisTarget::new(&args.mode)?;
@@ -307,6 +441,7 @@ fn run(
     // Build the target with a progress display.
     // progress is scoped so its Drop runs before we launch the executable.
     let num_workers = workers.unwrap_or_else(num_cpus::get_physical);
+    job_tokens::init(num_workers);
     let artifact = {
         let progress = progress::ProgressDisplay::new(num_workers, is_tty, no_tui, log_level);
         let _build_span = timed_span!(tracing::Level::INFO, "build_execution");
@@ -354,6 +489,9 @@ fn run(
 // Main
 // ----------------------------------------------------------------------------
 fn main() -> anyhow::Result<()> {
+    // Claim an inherited make jobserver before anything opens a file descriptor
+    job_tokens::capture_inherited();
+
     // Parse command-line arguments first to get the log level
     let args = Args::parse();
 
@@ -381,10 +519,12 @@ fn main() -> anyhow::Result<()> {
     let is_tty = std::io::IsTerminal::is_terminal(&std::io::stdout());
 
     let result = match args.command {
-        Commands::Build(b) => build(&b, args.workers, verbose_tools, args.no_tui, args.log_level, is_tty),
+        Commands::Build(b) => build(&b, args.workers, args.memory, verbose_tools, args.no_tui, args.log_level, is_tty),
         Commands::Dump(d) => dump(&d, verbose_tools),
-        Commands::Run(r) => run(&r, args.workers, verbose_tools, args.no_tui, args.log_level, is_tty),
+        Commands::Run(r) => run(&r, args.workers, args.memory, verbose_tools, args.no_tui, args.log_level, is_tty),
         Commands::InstallToolchains(t) => install_toolchains(&t),
+        Commands::Cache(c) => cache(&c),
+        Commands::CacheServer(c) => cache_server(&c),
     };
 
     match &result {
@@ -0,0 +1,139 @@
+//! Memory-aware admission of jobs.
+//!
+//! `--workers` caps how many jobs run at once, but jobs differ wildly in how much memory they
+//! need: a compile takes a few hundred megabytes while linking a large binary can take ten
+//! gigabytes. Each job carries a memory estimate, and the job system only starts a job while
+//! the estimates of everything running fit in the budget. A job that doesn't fit is set aside
+//! and requeued when a running job releases its share, so the worker moves on to other work
+//! instead of waiting.
+//!
+//! The budget defaults to the memory available when the build starts, capped by the cgroup
+//! limit when running in a container.
+
+use std::sync::Mutex;
+
+use crate::job_system::Job;
+
+// Default estimates by job verb. Deliberately generous: overestimating only costs parallelism.
+const COMPILE_MEMORY: u64 = 512 << 20;
+const LINK_MEMORY: u64 = 2 << 30;
+const ARCHIVE_MEMORY: u64 = 128 << 20;
+const ASSEMBLE_MEMORY: u64 = 128 << 20;
+
+/// cgroup v1 reports "no limit" as a huge page-aligned number rather than "max".
+const CGROUP_V1_UNLIMITED: u64 = 1 << 60;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug)]
+pub struct MemoryBudget {
+    total: u64,
+    state: Mutex<BudgetState>,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug, Default)]
+struct BudgetState {
+    reserved: u64,
+    /// Jobs that didn't fit when they were picked. Still counted as active by the job system.
+    waiting: Vec<Job>,
+}
+
+// ----------------------------------------------------------------------------
+// Public functions
+// ----------------------------------------------------------------------------
+/// Default memory estimate for a job, from the verb it is displayed with.
+pub fn estimate_for_verb(verb: &str) -> u64 {
+    match verb {
+        "Compiling" => COMPILE_MEMORY,
+        "Linking" => LINK_MEMORY,
+        "Archiving" => ARCHIVE_MEMORY,
+        "Assembling" => ASSEMBLE_MEMORY,
+        _ => 0,
+    }
+}
+
+/// Memory this process can use right now: available system memory, capped by the remaining
+/// headroom of its cgroup. `None` where neither can be read.
+pub fn detect_available_memory() -> Option<u64> {
+    let read = |path: &str| std::fs::read_to_string(path).ok();
+    let system = read("/proc/meminfo").and_then(|text| parse_meminfo_available(&text));
+
+    let cgroup_headroom = [
+        ("/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current"),
+        ("/sys/fs/cgroup/memory/memory.limit_in_bytes", "/sys/fs/cgroup/memory/memory.usage_in_bytes"),
+    ]
+    .iter()
+    .find_map(|(limit, usage)| {
+        let limit = parse_cgroup_limit(&read(limit)?)?;
+        let usage = read(usage).and_then(|u| u.trim().parse::<u64>().ok()).unwrap_or(0);
+        Some(limit.saturating_sub(usage))
+    });
+
+    match (system, cgroup_headroom) {
+        (Some(system), Some(cgroup)) => Some(system.min(cgroup)),
+        (system, cgroup) => system.or(cgroup),
+    }
+}
+
+/// Parses `MemAvailable` (falling back to `MemTotal` on old kernels) from `/proc/meminfo`.
+pub fn parse_meminfo_available(meminfo: &str) -> Option<u64> {
+    let field = |name: &str| {
+        meminfo.lines().find_map(|line| {
+            let rest = line.strip_prefix(name)?.strip_prefix(':')?;
+            let kib: u64 = rest.trim().trim_end_matches("kB").trim().parse().ok()?;
+            Some(kib * 1024)
+        })
+    };
+    field("MemAvailable").or_else(|| field("MemTotal"))
+}
+
+/// Parses a cgroup memory limit file. `None` when the cgroup is unlimited.
+pub fn parse_cgroup_limit(contents: &str) -> Option<u64> {
+    let limit: u64 = contents.trim().parse().ok()?;
+    (limit < CGROUP_V1_UNLIMITED).then_some(limit)
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl MemoryBudget {
+    pub fn new(total: u64) -> MemoryBudget {
+        MemoryBudget {
+            total,
+            state: Default::default(),
+        }
+    }
+
+    pub fn total(&self) -> u64 {
+        self.total
+    }
+
+    /// Reserves `job.memory` if it fits and returns the job to run. Otherwise keeps the job
+    /// until `release` frees memory. A job is always admitted when nothing else is reserved,
+    /// so one that is larger than the whole budget still runs, alone.
+    pub fn admit(&self, job: Job) -> Option<Job> {
+        let mut state = self.state.lock().unwrap();
+        if state.reserved == 0 || state.reserved + job.memory <= self.total {
+            state.reserved += job.memory;
+            Some(job)
+        } else {
+            state.waiting.push(job);
+            None
+        }
+    }
+
+    /// Returns `bytes` reserved by `admit`, handing back every job that was waiting for memory.
+    pub fn release(&self, bytes: u64) -> Vec<Job> {
+        let mut state = self.state.lock().unwrap();
+        state.reserved -= bytes;
+        std::mem::take(&mut state.waiting)
+    }
+
+    pub fn reserved(&self) -> u64 {
+        self.state.lock().unwrap().reserved
+    }
+}
@@ -0,0 +1,62 @@
+//! Tests for memory_budget.rs
+
+use crate::job_system::*;
+use crate::memory_budget::*;
+use std::sync::Arc;
+
+fn job_with_memory(ctx: &Arc<JobContext>, memory: u64) -> Job {
+    let mut job = ctx.new_job(
+        format!("job_{}", memory),
+        JobDisplayInfo::from_desc("job"),
+        Box::new(|_| anyhow::bail!("not run")),
+    );
+    job.memory = memory;
+    job
+}
+
+#[test]
+fn parse_meminfo() {
+    let meminfo = "MemTotal:       131072000 kB\nMemFree:         2048000 kB\nMemAvailable:   65536000 kB\n";
+    assert_eq!(parse_meminfo_available(meminfo), Some(65536000 * 1024));
+    assert_eq!(parse_meminfo_available("MemTotal:  1024 kB\n"), Some(1024 * 1024));
+    assert_eq!(parse_meminfo_available("garbage"), None);
+}
+
+#[test]
+fn parse_cgroup_limits() {
+    assert_eq!(parse_cgroup_limit("17179869184\n"), Some(16 << 30));
+    assert_eq!(parse_cgroup_limit("max\n"), None);
+    assert_eq!(parse_cgroup_limit("9223372036854771712\n"), None);
+}
+
+#[test]
+fn verbs_have_default_estimates() {
+    assert!(estimate_for_verb("Linking") > estimate_for_verb("Compiling"));
+    assert!(estimate_for_verb("Compiling") > 0);
+    assert_eq!(estimate_for_verb("Awaiting"), 0);
+}
+
+#[test]
+fn jobs_wait_for_memory() {
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let budget = MemoryBudget::new(10);
+
+    assert!(budget.admit(job_with_memory(&ctx, 6)).is_some());
+    assert!(budget.admit(job_with_memory(&ctx, 4)).is_some());
+    assert!(budget.admit(job_with_memory(&ctx, 3)).is_none());
+    assert_eq!(budget.reserved(), 10);
+
+    assert!(budget.release(4).iter().map(|job| job.memory).eq([3]));
+    assert!(budget.release(6).is_empty());
+    assert_eq!(budget.reserved(), 0);
+}
+
+#[test]
+fn oversized_job_runs_alone() {
+    let ctx: Arc<JobContext> = JobContext::new().into();
+    let budget = MemoryBudget::new(10);
+
+    assert!(budget.admit(job_with_memory(&ctx, 64)).is_some());
+    assert!(budget.admit(job_with_memory(&ctx, 1)).is_none());
+    assert_eq!(budget.release(64).len(), 1);
+}
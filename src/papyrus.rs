@@ -7,18 +7,19 @@ use anyhow::Context;
 use itertools::Itertools;
 use logos::{Lexer, Logos, Span};
 
-use camino::Utf8PathBuf;
+use camino::{Utf8Path, Utf8PathBuf};
 use std::collections::{HashMap, HashSet};
 use std::fs;
 use std::hash::DefaultHasher;
 use std::net::ToSocketAddrs;
 use std::path::{Path, PathBuf};
 use std::str::FromStr;
-use std::sync::LazyLock;
+use std::sync::{Arc, LazyLock, Mutex};
 
 use serde::Deserialize;
 
 use crate::anubis::AnubisTarget;
+use crate::glob_cache::GlobCache;
 use crate::papyrus_serde::ValueDeserializer;
 use crate::util::SlashFix;
 use crate::{anyhow_loc, bail_loc, function_name};
@@ -145,7 +146,7 @@ pub struct UnresolvedInfo {
 
 pub type ParseResult<T> = anyhow::Result<T>;
 
-#[derive(Clone, Debug, Default, Eq, PartialEq)]
+#[derive(Clone, Debug, Default, Eq, Hash, PartialEq)]
 pub struct Glob {
     pub includes: Vec<String>,
     pub excludes: Vec<String>,
@@ -160,6 +161,8 @@ pub struct SpannedError {
 pub struct PeekLexer<'source> {
     pub lexer: &'source mut Lexer<'source, Token<'source>>,
     pub peeked: Option<Option<Result<Token<'source>, ()>>>,
+    /// Identifiers seen so far in this parse. Dropped with the lexer.
+    pub identifiers: HashSet<Arc<str>>,
 }
 
 #[derive(Clone, Debug, Default, PartialEq)]
@@ -176,8 +179,16 @@ pub struct Select {
 
 pub type SelectFilter = Vec<Option<Vec<String>>>;
 
-#[derive(Clone, Debug, Deserialize, Eq, PartialEq)]
-pub struct Identifier(pub String);
+/// Object field or map key. Interned per parse, so every occurrence of a name in a file shares
+/// one allocation.
+#[derive(Clone, Debug, Eq, PartialEq)]
+pub struct Identifier(pub Arc<str>);
+
+impl Identifier {
+    pub fn new(name: &str) -> Identifier {
+        Identifier(name.into())
+    }
+}
 
 impl std::borrow::Borrow<str> for Identifier {
     fn borrow(&self) -> &str {
@@ -288,7 +299,7 @@ impl Value {
     }
 
     pub fn get_named_object(&self, object_name: &str) -> anyhow::Result<&Value> {
-        static NAME: LazyLock<Identifier> = LazyLock::new(|| Identifier("name".to_owned()));
+        static NAME: LazyLock<Identifier> = LazyLock::new(|| Identifier::new("name"));
 
         // TODO:
         //#error detect duplicates and error
@@ -337,7 +348,15 @@ impl Value {
     where
         T: serde::de::DeserializeOwned + PapyrusObjectType,
     {
-        let value = self.get_named_object(object_name)?;
+        self.get_named_object(object_name)?.deserialize_object(object_name)
+    }
+
+    /// Deserializes this object value, which must have `T`'s typename. `object_name` is only used in errors.
+    pub fn deserialize_object<T>(&self, object_name: &str) -> anyhow::Result<T>
+    where
+        T: serde::de::DeserializeOwned + PapyrusObjectType,
+    {
+        let value = self;
 
         // Verify the object has the correct type
         if let Value::Object(obj) = value {
@@ -369,6 +388,16 @@ impl<'source> PeekLexer<'source> {
     pub fn consume(&mut self) {
         self.peeked = None;
     }
+
+    /// Returns the identifier for `name`, sharing its allocation with earlier uses in this parse.
+    pub fn intern(&mut self, name: &str) -> Identifier {
+        if let Some(interned) = self.identifiers.get(name) {
+            return Identifier(interned.clone());
+        }
+        let interned: Arc<str> = name.into();
+        self.identifiers.insert(interned.clone());
+        Identifier(interned)
+    }
 }
 
 impl<'source> Iterator for PeekLexer<'source> {
@@ -387,33 +416,38 @@ impl<'source> Iterator for PeekLexer<'source> {
 // free standing functions
 // ----------------------------------------------------------------------------
 pub fn resolve_value(
-    value: Value,
+    value: &Value,
     value_root: &Path,
     vars: &HashMap<String, String>,
 ) -> anyhow::Result<Value> {
-    resolve_value_with_dir(value, value_root, vars, None)
+    resolve_value_with_dir(value, value_root, vars, None, &GlobCache::default())
 }
 
+/// Resolves `value` into a new tree. The input is borrowed so cached raw configs are never deep cloned;
+/// only the parts that survive resolution are copied into the result. Globs are expanded through `globs`,
+/// which is shared by every resolution in a build.
 pub fn resolve_value_with_dir(
-    value: Value,
+    value: &Value,
     value_root: &Path,
     vars: &HashMap<String, String>,
     dir_relpath: Option<&str>,
+    globs: &GlobCache,
 ) -> anyhow::Result<Value> {
     match value {
         Value::Array(values) => {
             let new_values = values
-                .into_iter()
-                .map(|v| resolve_value_with_dir(v, value_root, vars, dir_relpath))
+                .iter()
+                .map(|v| resolve_value_with_dir(v, value_root, vars, dir_relpath, globs))
                 .collect::<anyhow::Result<Vec<_>>>()?;
             Ok(Value::Array(new_values))
         }
         Value::Object(obj) => {
             let new_fields = obj
                 .fields
-                .into_iter()
+                .iter()
                 .map(|(k, v)| {
-                    resolve_value_with_dir(v, value_root, vars, dir_relpath).map(|new_value| (k, new_value))
+                    let new_value = resolve_value_with_dir(v, value_root, vars, dir_relpath, globs)?;
+                    Ok((k.clone(), new_value))
                 })
                 .collect::<anyhow::Result<HashMap<Identifier, Value>>>()?;
 
@@ -429,74 +463,41 @@ pub fn resolve_value_with_dir(
             }
 
             Ok(Value::Object(Object {
-                typename: obj.typename,
+                typename: obj.typename.clone(),
                 fields: new_fields,
             }))
         }
         Value::Map(map) => {
             let new_map = map
-                .into_iter()
+                .iter()
                 .map(|(k, v)| {
-                    resolve_value_with_dir(v, value_root, vars, dir_relpath).map(|new_value| (k, new_value))
+                    let new_value = resolve_value_with_dir(v, value_root, vars, dir_relpath, globs)?;
+                    Ok((k.clone(), new_value))
                 })
                 .collect::<anyhow::Result<HashMap<Identifier, Value>>>()?;
             Ok(Value::Map(new_map))
         }
         Value::Glob(glob) => {
-            let mut paths: HashSet<String> = Default::default();
-
-            // find includes
-            for pattern in &glob.includes {
-                let full_pattern = value_root.join(&pattern);
-                let pattern_str = full_pattern
-                    .to_str()
-                    .ok_or_else(|| anyhow_loc!("Invalid UTF-8 in glob pattern: {:?}", full_pattern))?;
-                for entry in glob::glob(pattern_str)
-                    .with_context(|| format!("Failed to parse glob pattern: {}", pattern_str))?
-                {
-                    match entry {
-                        Ok(path) => paths.insert(path.to_string_lossy().replace("\\", "/")),
-                        Err(e) => bail_loc!("Error matching glob pattern {}: {:?}", pattern_str, e),
-                    };
-                }
-            }
-
-            // build exclude pattern strings
-            let mut excludes: Vec<glob::Pattern> = Default::default();
-            for exclude in &glob.excludes {
-                let full_pattern = value_root.join(&exclude);
-                let pattern_str = full_pattern
-                    .to_str()
-                    .ok_or_else(|| anyhow_loc!("Invalid UTF-8 in glob pattern: {:?}", full_pattern))?;
-                let pattern = glob::Pattern::new(pattern_str)
-                    .with_context(|| format!("Failed to parse glob pattern: {}", pattern_str))?;
-                excludes.push(pattern);
-            }
-
-            // apply excludes
-            let paths: Vec<Utf8PathBuf> = paths
-                .into_iter()
-                .filter(|p| !excludes.iter().any(|e| e.matches(p)))
-                .map(|p| Utf8PathBuf::from(p))
-                .collect();
-
+            let root = Utf8Path::from_path(value_root)
+                .ok_or_else(|| anyhow_loc!("Invalid UTF-8 in glob root: {:?}", value_root))?;
+            let paths = globs.expand(root, glob)?;
             if paths.is_empty() {
                 bail_loc!(
                     "Glob [{:?}] failed to match anything. Root: [{:?}]",
-                    &glob,
+                    glob,
                     value_root
                 );
             } else {
-                tracing::trace!("Glob [{:?}] resolved: [{:?}]", &glob, &paths);
-                Ok(Value::Paths(paths))
+                tracing::trace!("Glob [{:?}] resolved: [{:?}]", glob, &paths);
+                Ok(Value::Paths(paths.to_vec()))
             }
         }
         Value::RelPath(rel_path) => {
             let value_root_str = value_root.to_string_lossy();
             let mut abs_path = Utf8PathBuf::from(value_root_str.as_ref());
-            abs_path.push(&rel_path);
+            abs_path.push(rel_path);
             let abs_path = abs_path.slash_fix();
-            tracing::trace!("Resolved RelPath [{:?}] -> [{:?}]", &rel_path, &abs_path);
+            tracing::trace!("Resolved RelPath [{:?}] -> [{:?}]", rel_path, &abs_path);
             Ok(Value::Path(abs_path))
         }
         Value::RelPaths(rel_paths) => {
@@ -504,14 +505,14 @@ pub fn resolve_value_with_dir(
             let mut abs_paths: Vec<Utf8PathBuf> = Default::default();
             for rel_path in rel_paths {
                 let mut abs_path = Utf8PathBuf::from(value_root_str.as_ref());
-                abs_path.push(&rel_path);
+                abs_path.push(rel_path);
                 let abs_path = abs_path.slash_fix();
-                tracing::trace!("Resolved RelPath [{:?}] -> [{:?}]", &rel_path, &abs_path);
+                tracing::trace!("Resolved RelPath [{:?}] -> [{:?}]", rel_path, &abs_path);
                 abs_paths.push(abs_path);
             }
             Ok(Value::Paths(abs_paths))
         }
-        Value::Select(mut s) => {
+        Value::Select(s) => {
             let resolved_input: Vec<&String> = s
                 .inputs
                 .iter()
@@ -525,19 +526,15 @@ pub fn resolve_value_with_dir(
             for i in 0..s.filters.len() {
                 if let Some(filter) = &s.filters[i].0 {
                     assert_eq!(s.inputs.len(), filter.len());
-                    let passes = resolved_input.iter().enumerate().all(|(idx, input)| match &filter[idx] {
-                        Some(valid_values) => valid_values.iter().any(|v| v == *input),
-                        None => true,
-                    });
-                    if passes {
-                        let v = s.filters.swap_remove(i).1;
-                        let resolved_v = resolve_value_with_dir(v, value_root, vars, dir_relpath)?;
+                    if filter_passes(filter, &resolved_input) {
+                        let v = &s.filters[i].1;
+                        let resolved_v = resolve_value_with_dir(v, value_root, vars, dir_relpath, globs)?;
                         return Ok(resolved_v);
                     }
                 } else {
                     // This is the default case
-                    let v = s.filters.swap_remove(i).1;
-                    let resolved_v = resolve_value_with_dir(v, value_root, vars, dir_relpath)?;
+                    let v = &s.filters[i].1;
+                    let resolved_v = resolve_value_with_dir(v, value_root, vars, dir_relpath, globs)?;
                     return Ok(resolved_v);
                 }
             }
@@ -592,22 +589,18 @@ pub fn resolve_value_with_dir(
                 .collect::<anyhow::Result<Vec<&String>>>()?;
 
             // Collect all matching filters (in order), storing default separately
-            let mut matched_values: Vec<Value> = Vec::new();
-            let mut default_value: Option<Value> = None;
+            let mut matched_values: Vec<&Value> = Vec::new();
+            let mut default_value: Option<&Value> = None;
 
             for (filter, value) in &s.filters {
                 if let Some(filter) = filter {
                     assert_eq!(s.inputs.len(), filter.len());
-                    let passes = resolved_input.iter().enumerate().all(|(idx, input)| match &filter[idx] {
-                        Some(valid_values) => valid_values.iter().any(|v| v == *input),
-                        None => true,
-                    });
-                    if passes {
-                        matched_values.push(value.clone());
+                    if filter_passes(filter, &resolved_input) {
+                        matched_values.push(value);
                     }
                 } else {
                     // This is the default case - save it but don't add yet
-                    default_value = Some(value.clone());
+                    default_value = Some(value);
                 }
             }
 
@@ -658,65 +651,81 @@ pub fn resolve_value_with_dir(
             }
 
             // Concatenate all matched values in order
-            let mut result = resolve_value(matched_values.remove(0), value_root, vars)?;
-            for next_value in matched_values {
-                let resolved_next = resolve_value(next_value, value_root, vars)?;
-                result = resolve_concat(result, resolved_next, value_root, vars)?;
+            let mut result = resolve_value_with_dir(matched_values[0], value_root, vars, None, globs)?;
+            for next_value in &matched_values[1..] {
+                let resolved_next = resolve_value_with_dir(next_value, value_root, vars, None, globs)?;
+                result = concat_resolved(result, resolved_next)?;
             }
 
             Ok(result)
         }
         Value::Concat(pair) => {
-            let left = resolve_value_with_dir(*pair.0, value_root, vars, dir_relpath)?;
-            let right = resolve_value_with_dir(*pair.1, value_root, vars, dir_relpath)?;
+            let left = resolve_value_with_dir(&pair.0, value_root, vars, dir_relpath, globs)?;
+            let right = resolve_value_with_dir(&pair.1, value_root, vars, dir_relpath, globs)?;
+            concat_resolved(left, right)
+        }
+        Value::Path(_) => Ok(value.clone()),
+        Value::Paths(_) => Ok(value.clone()),
+        Value::String(_) => Ok(value.clone()),
+        Value::Target(t) => match dir_relpath {
+            Some(dir) => Ok(Value::Target(t.resolve(dir))),
+            None => Ok(value.clone()),
+        },
+        Value::Targets(targets) => match dir_relpath {
+            Some(dir) => Ok(Value::Targets(targets.iter().map(|t| t.resolve(dir)).collect())),
+            None => Ok(value.clone()),
+        },
+        Value::Unresolved(_) => Ok(value.clone()), // Pass through unresolved values
+    }
+}
 
-            // If either side is unresolved, propagate the unresolved state
-            if let Some(info) = left.as_unresolved() {
-                return Ok(Value::Unresolved(info.clone()));
-            }
-            if let Some(info) = right.as_unresolved() {
-                return Ok(Value::Unresolved(info.clone()));
-            }
+/// True if the select `input` values satisfy every position of `filter`.
+fn filter_passes(filter: &SelectFilter, input: &[&String]) -> bool {
+    input.iter().zip(filter).all(|(input, valid_values)| match valid_values {
+        Some(valid_values) => valid_values.iter().any(|v| v == *input),
+        None => true,
+    })
+}
 
-            resolve_concat_with_dir(left, right, value_root, vars, dir_relpath)
+/// Appends every glob that resolving `value` with `vars` will expand, following only the `select` and
+/// `multi_select` branches `vars` pick. Used to expand them all in parallel before resolving.
+pub fn collect_globs<'a>(value: &'a Value, vars: &HashMap<String, String>, globs: &mut Vec<&'a Glob>) {
+    match value {
+        Value::Glob(glob) => globs.push(glob),
+        Value::Array(values) => values.iter().for_each(|v| collect_globs(v, vars, globs)),
+        Value::Concat((left, right)) => {
+            collect_globs(left, vars, globs);
+            collect_globs(right, vars, globs);
         }
-        Value::Path(_) => Ok(value),
-        Value::Paths(_) => Ok(value),
-        Value::String(_) => Ok(value),
-        Value::Target(ref t) => Ok(dir_relpath.map(|dir| Value::Target(t.resolve(dir))).unwrap_or(value)),
-        Value::Targets(mut targets) => {
-            if let Some(dir) = dir_relpath {
-                let resolved: Vec<AnubisTarget> =
-                    targets.into_iter().map(|t| dir_relpath.map(|dir| t.resolve(dir)).unwrap_or(t)).collect();
-                return Ok(Value::Targets(resolved));
-            } else {
-                Ok(Value::Targets(targets))
+        Value::Object(object) => object.fields.values().for_each(|v| collect_globs(v, vars, globs)),
+        Value::Map(fields) => fields.values().for_each(|v| collect_globs(v, vars, globs)),
+        Value::Select(select) | Value::MultiSelect(select) => {
+            let Some(input) = select.inputs.iter().map(|i| vars.get(i)).collect::<Option<Vec<_>>>() else {
+                return;
+            };
+            let passes =
+                |filter: &Option<SelectFilter>| filter.as_ref().is_some_and(|f| filter_passes(f, &input));
+            let mut taken: Vec<&Value> = match value {
+                // A select takes the first filter that passes, or the default if it comes first
+                Value::Select(_) => {
+                    let first = select.filters.iter().find(|(filter, _)| filter.is_none() || passes(filter));
+                    first.map(|(_, v)| v).into_iter().collect()
+                }
+                // A multi_select takes every filter that passes, or the default if none do
+                _ => select.filters.iter().filter(|(filter, _)| passes(filter)).map(|(_, v)| v).collect(),
+            };
+            if taken.is_empty() {
+                let default = select.filters.iter().find(|(filter, _)| filter.is_none());
+                taken.extend(default.map(|(_, v)| v));
             }
+            taken.into_iter().for_each(|v| collect_globs(v, vars, globs));
         }
-        Value::Unresolved(_) => Ok(value), // Pass through unresolved values
+        _ => (),
     }
 }
 
-fn resolve_concat(
-    left: Value,
-    right: Value,
-    value_root: &Path,
-    vars: &HashMap<String, String>,
-) -> anyhow::Result<Value> {
-    resolve_concat_with_dir(left, right, value_root, vars, None)
-}
-
-fn resolve_concat_with_dir(
-    left: Value,
-    right: Value,
-    value_root: &Path,
-    vars: &HashMap<String, String>,
-    dir_relpath: Option<&str>,
-) -> anyhow::Result<Value> {
-    // Resolve left and right
-    let mut left = resolve_value_with_dir(left, value_root, vars, dir_relpath)?;
-    let mut right = resolve_value_with_dir(right, value_root, vars, dir_relpath)?;
-
+/// Concatenates two values that have already been resolved.
+fn concat_resolved(mut left: Value, right: Value) -> anyhow::Result<Value> {
     // If either side is unresolved, propagate the unresolved state
     if let Some(info) = left.as_unresolved() {
         return Ok(Value::Unresolved(info.clone()));
@@ -747,13 +756,7 @@ fn resolve_concat_with_dir(
                 match left.fields.get_mut(&key) {
                     Some(l) => {
                         // key is in both left and right, concat
-                        *l = resolve_concat_with_dir(
-                            std::mem::replace(l, Value::Array(Vec::new())),
-                            r,
-                            value_root,
-                            vars,
-                            dir_relpath,
-                        )?;
+                        *l = concat_resolved(std::mem::replace(l, Value::Array(Vec::new())), r)?;
                     }
                     None => {
                         // key missing in left, just add it
@@ -784,7 +787,11 @@ fn resolve_concat_with_dir(
 
 pub fn parse_config<'src>(lexer: &'src mut Lexer<'src, Token<'src>>) -> anyhow::Result<Value, SpannedError> {
     let mut objects: Vec<Value> = Default::default();
-    let mut lexer = PeekLexer { lexer, peeked: None };
+    let mut lexer = PeekLexer {
+        lexer,
+        peeked: None,
+        identifiers: HashSet::new(),
+    };
     while lexer.peek() != &None {
         match parse_object(&mut lexer) {
             Ok(object) => objects.push(object),
@@ -957,7 +964,7 @@ pub fn parse_map<'src>(lexer: &mut PeekLexer<'src>) -> ParseResult<Value> {
             Some(Ok(Token::Identifier(key))) => {
                 expect_token(lexer, &Token::Equals)?;
                 let value = parse_value(lexer)?;
-                map.insert(Identifier(key.to_owned()), value);
+                map.insert(lexer.intern(key), value);
             }
             Some(Ok(t)) => bail_loc!("parse_map: Unexpected token [{:?}]", t),
             t => bail_loc!("parse_map: Unexpected token [{:?}]", t),
@@ -1132,7 +1139,7 @@ pub fn consume_token<'src>(lexer: &mut PeekLexer<'src>, token: &Token<'src>) ->
 pub fn expect_identifier<'src>(lexer: &mut PeekLexer<'src>) -> ParseResult<Identifier> {
     let token = lexer.next();
     match token {
-        Some(Ok(Token::Identifier(i))) => Ok(Identifier(i.to_owned())),
+        Some(Ok(Token::Identifier(i))) => Ok(lexer.intern(i)),
         Some(Ok(t)) => bail_loc!("expect_identifier: Unexpected token [{:?}]", t),
         t => bail_loc!("expect_identifier: Unexpected result [{:?}]", t),
     }
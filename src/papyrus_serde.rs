@@ -2,7 +2,7 @@
 
 use camino::Utf8PathBuf;
 use heck::ToUpperCamelCase;
-use serde::de::{self, Deserializer, MapAccess, SeqAccess, Visitor};
+use serde::de::{self, Deserializer, IntoDeserializer, MapAccess, SeqAccess, Visitor};
 use std::fmt;
 
 use crate::anubis::AnubisTarget;
@@ -79,16 +79,10 @@ impl<'de, 'a> Deserializer<'de> for ValueDeserializer<'a> {
         match self.value {
             Value::Path(p) => visitor.visit_string(p.to_string()),
             Value::String(s) => visitor.visit_str(s),
-            Value::Array(arr) => visitor.visit_seq(ArrayDeserializer {
-                iter: arr.clone().into_iter(),
-            }),
-            Value::Object(obj) => {
-                visitor.visit_map(ObjectDeserializer::new(obj.typename.clone(), obj.fields.clone()))
-            }
-            Value::Map(map) => visitor.visit_map(MapDeserializer::new(map.clone())),
-            Value::Paths(paths) => visitor.visit_seq(PathsSeqDeserializer {
-                iter: paths.clone().into_iter(),
-            }),
+            Value::Array(arr) => visitor.visit_seq(ArrayDeserializer { iter: arr.iter() }),
+            Value::Object(obj) => visitor.visit_map(ObjectDeserializer::new(&obj.typename, &obj.fields)),
+            Value::Map(map) => visitor.visit_map(MapDeserializer::new(map)),
+            Value::Paths(paths) => visitor.visit_seq(PathsSeqDeserializer { iter: paths.iter() }),
             Value::RelPath(p) => Err(DeserializeError::Unresolved(format!(
                 "Can't deserialize unresolved RelPath: {:?}",
                 p
@@ -114,9 +108,7 @@ impl<'de, 'a> Deserializer<'de> for ValueDeserializer<'a> {
                 c
             ))),
             Value::Target(target) => visitor.visit_str(target.target_path()),
-            Value::Targets(targets) => visitor.visit_seq(TargetsSeqDeserializer {
-                iter: targets.clone().into_iter(),
-            }),
+            Value::Targets(targets) => visitor.visit_seq(TargetsSeqDeserializer { iter: targets.iter() }),
             Value::Unresolved(info) => Err(DeserializeError::UnresolvedValue(info.clone())),
         }
     }
@@ -149,10 +141,10 @@ impl<'de, 'a> Deserializer<'de> for ValueDeserializer<'a> {
                         name, obj.typename
                     )))
                 } else {
-                    visitor.visit_map(ObjectDeserializer::new(obj.typename.clone(), obj.fields.clone()))
+                    visitor.visit_map(ObjectDeserializer::new(&obj.typename, &obj.fields))
                 }
             }
-            Value::Map(map) => visitor.visit_map(MapDeserializer::new(map.clone())),
+            Value::Map(map) => visitor.visit_map(MapDeserializer::new(map)),
             v => Err(DeserializeError::ExpectedMap(v.clone())),
         }
     }
@@ -190,11 +182,11 @@ impl<'de, 'a> Deserializer<'de> for ValueDeserializer<'a> {
     }
 }
 
-pub struct ArrayDeserializer {
-    iter: std::vec::IntoIter<Value>,
+pub struct ArrayDeserializer<'a> {
+    iter: std::slice::Iter<'a, Value>,
 }
 
-impl<'de> SeqAccess<'de> for ArrayDeserializer {
+impl<'de, 'a> SeqAccess<'de> for ArrayDeserializer<'a> {
     type Error = DeserializeError;
 
     fn next_element_seed<T>(&mut self, seed: T) -> Result<Option<T::Value>, Self::Error>
@@ -202,32 +194,29 @@ impl<'de> SeqAccess<'de> for ArrayDeserializer {
         T: de::DeserializeSeed<'de>,
     {
         match self.iter.next() {
-            Some(value) => {
-                let deserializer = ValueDeserializer::new(&value);
-                seed.deserialize(deserializer).map(Some)
-            }
+            Some(value) => seed.deserialize(ValueDeserializer::new(value)).map(Some),
             None => Ok(None),
         }
     }
 }
 
-pub struct ObjectDeserializer {
-    typename: String,
-    iter: std::collections::hash_map::IntoIter<Identifier, Value>,
-    next_value: Option<Value>,
+pub struct ObjectDeserializer<'a> {
+    typename: &'a str,
+    iter: std::collections::hash_map::Iter<'a, Identifier, Value>,
+    next_value: Option<&'a Value>,
 }
 
-impl ObjectDeserializer {
-    pub fn new(typename: String, map: HashMap<Identifier, Value>) -> Self {
+impl<'a> ObjectDeserializer<'a> {
+    pub fn new(typename: &'a str, map: &'a HashMap<Identifier, Value>) -> Self {
         ObjectDeserializer {
             typename,
-            iter: map.into_iter(),
+            iter: map.iter(),
             next_value: None,
         }
     }
 }
 
-impl<'de> MapAccess<'de> for ObjectDeserializer {
+impl<'de, 'a> MapAccess<'de> for ObjectDeserializer<'a> {
     type Error = DeserializeError;
 
     fn next_key_seed<K>(&mut self, seed: K) -> Result<Option<K::Value>, Self::Error>
@@ -237,9 +226,7 @@ impl<'de> MapAccess<'de> for ObjectDeserializer {
         match self.iter.next() {
             Some((key, value)) => {
                 self.next_value = Some(value);
-                let key_string = Value::String(key.0.clone());
-                let key_deserializer = ValueDeserializer::new(&key_string);
-                seed.deserialize(key_deserializer).map(Some)
+                seed.deserialize(key.0.as_ref().into_deserializer()).map(Some)
             }
             None => Ok(None),
         }
@@ -250,30 +237,27 @@ impl<'de> MapAccess<'de> for ObjectDeserializer {
         V: de::DeserializeSeed<'de>,
     {
         match self.next_value.take() {
-            Some(value) => {
-                let value_deserializer = ValueDeserializer::new(&value);
-                seed.deserialize(value_deserializer)
-            }
+            Some(value) => seed.deserialize(ValueDeserializer::new(value)),
             None => Err(DeserializeError::Custom("value missing".to_string())),
         }
     }
 }
 
-pub struct MapDeserializer {
-    iter: std::collections::hash_map::IntoIter<Identifier, Value>,
-    next_value: Option<Value>,
+pub struct MapDeserializer<'a> {
+    iter: std::collections::hash_map::Iter<'a, Identifier, Value>,
+    next_value: Option<&'a Value>,
 }
 
-impl MapDeserializer {
-    pub fn new(map: HashMap<Identifier, Value>) -> Self {
+impl<'a> MapDeserializer<'a> {
+    pub fn new(map: &'a HashMap<Identifier, Value>) -> Self {
         MapDeserializer {
-            iter: map.into_iter(),
+            iter: map.iter(),
             next_value: None,
         }
     }
 }
 
-impl<'de> MapAccess<'de> for MapDeserializer {
+impl<'de, 'a> MapAccess<'de> for MapDeserializer<'a> {
     type Error = DeserializeError;
 
     fn next_key_seed<K>(&mut self, seed: K) -> Result<Option<K::Value>, Self::Error>
@@ -283,9 +267,7 @@ impl<'de> MapAccess<'de> for MapDeserializer {
         match self.iter.next() {
             Some((key, value)) => {
                 self.next_value = Some(value);
-                let key_string = Value::String(key.0.clone());
-                let key_deserializer = ValueDeserializer::new(&key_string);
-                seed.deserialize(key_deserializer).map(Some)
+                seed.deserialize(key.0.as_ref().into_deserializer()).map(Some)
             }
             None => Ok(None),
         }
@@ -296,20 +278,17 @@ impl<'de> MapAccess<'de> for MapDeserializer {
         V: de::DeserializeSeed<'de>,
     {
         match self.next_value.take() {
-            Some(value) => {
-                let value_deserializer = ValueDeserializer::new(&value);
-                seed.deserialize(value_deserializer)
-            }
+            Some(value) => seed.deserialize(ValueDeserializer::new(value)),
             None => Err(DeserializeError::Custom("value missing".to_string())),
         }
     }
 }
 
-pub struct PathsSeqDeserializer {
-    iter: std::vec::IntoIter<Utf8PathBuf>,
+pub struct PathsSeqDeserializer<'a> {
+    iter: std::slice::Iter<'a, Utf8PathBuf>,
 }
 
-impl<'de> SeqAccess<'de> for PathsSeqDeserializer {
+impl<'de, 'a> SeqAccess<'de> for PathsSeqDeserializer<'a> {
     type Error = DeserializeError;
 
     fn next_element_seed<T>(&mut self, seed: T) -> Result<Option<T::Value>, Self::Error>
@@ -317,21 +296,17 @@ impl<'de> SeqAccess<'de> for PathsSeqDeserializer {
         T: de::DeserializeSeed<'de>,
     {
         match self.iter.next() {
-            Some(path) => {
-                let path_string = Value::String(path.to_string());
-                let deserializer = ValueDeserializer::new(&path_string);
-                seed.deserialize(deserializer).map(Some)
-            }
+            Some(path) => seed.deserialize(path.as_str().into_deserializer()).map(Some),
             None => Ok(None),
         }
     }
 }
 
-pub struct TargetsSeqDeserializer {
-    iter: std::vec::IntoIter<AnubisTarget>,
+pub struct TargetsSeqDeserializer<'a> {
+    iter: std::slice::Iter<'a, AnubisTarget>,
 }
 
-impl<'de> SeqAccess<'de> for TargetsSeqDeserializer {
+impl<'de, 'a> SeqAccess<'de> for TargetsSeqDeserializer<'a> {
     type Error = DeserializeError;
 
     fn next_element_seed<T>(&mut self, seed: T) -> Result<Option<T::Value>, Self::Error>
@@ -339,12 +314,37 @@ impl<'de> SeqAccess<'de> for TargetsSeqDeserializer {
         T: de::DeserializeSeed<'de>,
     {
         match self.iter.next() {
-            Some(target) => {
-                let target_value = Value::Target(target);
-                let deserializer = ValueDeserializer::new(&target_value);
-                seed.deserialize(deserializer).map(Some)
-            }
+            Some(target) => seed.deserialize(TargetDeserializer { target }).map(Some),
             None => Ok(None),
         }
     }
 }
+
+/// Deserializes one element of a `Targets` list without wrapping it back into a `Value`.
+struct TargetDeserializer<'a> {
+    target: &'a AnubisTarget,
+}
+
+impl<'de, 'a> Deserializer<'de> for TargetDeserializer<'a> {
+    type Error = DeserializeError;
+
+    fn deserialize_any<V>(self, visitor: V) -> Result<V::Value, Self::Error>
+    where
+        V: Visitor<'de>,
+    {
+        visitor.visit_str(self.target.target_path())
+    }
+
+    fn deserialize_option<V>(self, visitor: V) -> Result<V::Value, Self::Error>
+    where
+        V: Visitor<'de>,
+    {
+        visitor.visit_some(self)
+    }
+
+    serde::forward_to_deserialize_any! {
+        bool i8 i16 i32 i64 i128 u8 u16 u32 u64 u128 f32 f64 char str string
+        bytes byte_buf unit unit_struct newtype_struct seq tuple
+        tuple_struct map struct enum identifier ignored_any
+    }
+}
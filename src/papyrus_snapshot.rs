@@ -0,0 +1,291 @@
+//! Binary snapshots of parsed Papyrus files.
+//!
+//! Lexing and parsing every ANUBIS file on every invocation adds up for large configs. After a
+//! file is parsed its `Value` is written to `{root}/.anubis-build/.papyrus/{path_hash}` along with
+//! the xxh3 hash of the source it came from. The next load reads the source, hashes it, and if
+//! the hash matches decodes the snapshot in a single pass instead of parsing.
+//!
+//! There is one snapshot per source path, so editing a file replaces its snapshot rather than
+//! adding another. A missing, stale, or unreadable snapshot just means the file is parsed again.
+
+use crate::anubis::AnubisTarget;
+use crate::papyrus::{self, Glob, Identifier, Object, Select, UnresolvedInfo, Value};
+use crate::util::{self, ByteReader};
+use crate::{bail_loc, bail_loc_if, function_name};
+use camino::{Utf8Path, Utf8PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+const SNAPSHOT_MAGIC: &[u8; 4] = b"ANBP";
+const SNAPSHOT_VERSION: u32 = 1;
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+/// Reads Papyrus files through a directory of snapshots. The default has no directory and
+/// always parses.
+#[derive(Debug, Default)]
+pub struct PapyrusSnapshots {
+    dir: Option<Utf8PathBuf>,
+    hits: AtomicUsize,
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl PapyrusSnapshots {
+    pub fn new(dir: Utf8PathBuf) -> PapyrusSnapshots {
+        PapyrusSnapshots {
+            dir: Some(dir),
+            hits: AtomicUsize::new(0),
+        }
+    }
+
+    /// Parses the Papyrus file at `path`, or loads it from its snapshot if the source is unchanged.
+    pub fn read_papyrus_file(&self, path: &Utf8Path) -> anyhow::Result<Value> {
+        let src = match std::fs::read_to_string(path) {
+            Ok(src) => src,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => {
+                bail_loc!("read_papyrus failed because file didn't exist: [{}]", path)
+            }
+            Err(e) => bail_loc!("Failed to read papyrus file [{}]: {}", path, e),
+        };
+        let Some(dir) = &self.dir else {
+            return papyrus::read_papyrus_str(&src, path.as_str());
+        };
+
+        let source_hash = xxhash_rust::xxh3::xxh3_64(src.as_bytes());
+        let snapshot_path = dir.join(format!("{:016x}", util::quick_hash(&path.as_str())));
+        if let Ok(bytes) = std::fs::read(&snapshot_path) {
+            match decode_snapshot(&bytes, source_hash) {
+                Ok(Some(value)) => {
+                    self.hits.fetch_add(1, Ordering::Relaxed);
+                    return Ok(value);
+                }
+                Ok(None) => (),
+                Err(e) => tracing::debug!("Ignoring unreadable papyrus snapshot [{}]: {}", snapshot_path, e),
+            }
+        }
+
+        let value = papyrus::read_papyrus_str(&src, path.as_str())?;
+        if let Err(e) = util::write_atomic(&snapshot_path, &encode_snapshot(&value, source_hash)) {
+            tracing::debug!("Failed to write papyrus snapshot [{}]: {}", snapshot_path, e);
+        }
+        Ok(value)
+    }
+
+    /// Number of files loaded from a snapshot instead of parsed.
+    pub fn hits(&self) -> usize {
+        self.hits.load(Ordering::Relaxed)
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Serialization
+// ----------------------------------------------------------------------------
+// Layout (all integers little-endian):
+//   magic[4] version:u32 source_hash:u64 value
+// A value is a tag byte followed by its payload. Strings are len:u32 bytes[len] and lists are
+// count:u32 followed by their elements.
+
+const TAG_ARRAY: u8 = 0;
+const TAG_CONCAT: u8 = 1;
+const TAG_OBJECT: u8 = 2;
+const TAG_GLOB: u8 = 3;
+const TAG_MAP: u8 = 4;
+const TAG_REL_PATH: u8 = 5;
+const TAG_REL_PATHS: u8 = 6;
+const TAG_PATH: u8 = 7;
+const TAG_PATHS: u8 = 8;
+const TAG_SELECT: u8 = 9;
+const TAG_MULTI_SELECT: u8 = 10;
+const TAG_STRING: u8 = 11;
+const TAG_TARGET: u8 = 12;
+const TAG_TARGETS: u8 = 13;
+const TAG_UNRESOLVED: u8 = 14;
+
+fn encode_snapshot(value: &Value, source_hash: u64) -> Vec<u8> {
+    let mut bytes: Vec<u8> = Default::default();
+    bytes.extend(SNAPSHOT_MAGIC);
+    bytes.extend(SNAPSHOT_VERSION.to_le_bytes());
+    bytes.extend(source_hash.to_le_bytes());
+    encode_value(&mut bytes, value);
+    bytes
+}
+
+/// Decodes a snapshot, or returns None if it was taken from a different source or format version.
+fn decode_snapshot(bytes: &[u8], source_hash: u64) -> anyhow::Result<Option<Value>> {
+    let mut r = ByteReader::new(bytes, "papyrus snapshot");
+    bail_loc_if!(r.take(4)? != SNAPSHOT_MAGIC, "Bad papyrus snapshot magic");
+    if r.u32()? != SNAPSHOT_VERSION || r.u64()? != source_hash {
+        return Ok(None);
+    }
+    let value = decode_value(&mut r)?;
+    r.finish()?;
+    Ok(Some(value))
+}
+
+fn encode_value(out: &mut Vec<u8>, value: &Value) {
+    match value {
+        Value::Array(values) => {
+            out.push(TAG_ARRAY);
+            encode_list(out, values, encode_value);
+        }
+        Value::Concat((left, right)) => {
+            out.push(TAG_CONCAT);
+            encode_value(out, left);
+            encode_value(out, right);
+        }
+        Value::Object(object) => {
+            out.push(TAG_OBJECT);
+            util::put_str(out, &object.typename);
+            encode_fields(out, &object.fields);
+        }
+        Value::Glob(glob) => {
+            out.push(TAG_GLOB);
+            encode_list(out, &glob.includes, encode_string);
+            encode_list(out, &glob.excludes, encode_string);
+        }
+        Value::Map(fields) => {
+            out.push(TAG_MAP);
+            encode_fields(out, fields);
+        }
+        Value::RelPath(path) => {
+            out.push(TAG_REL_PATH);
+            util::put_str(out, path);
+        }
+        Value::RelPaths(paths) => {
+            out.push(TAG_REL_PATHS);
+            encode_list(out, paths, encode_string);
+        }
+        Value::Path(path) => {
+            out.push(TAG_PATH);
+            util::put_str(out, path.as_str());
+        }
+        Value::Paths(paths) => {
+            out.push(TAG_PATHS);
+            encode_list(out, paths, |out, path| util::put_str(out, path.as_str()));
+        }
+        Value::Select(select) => {
+            out.push(TAG_SELECT);
+            encode_select(out, select);
+        }
+        Value::MultiSelect(select) => {
+            out.push(TAG_MULTI_SELECT);
+            encode_select(out, select);
+        }
+        Value::String(s) => {
+            out.push(TAG_STRING);
+            util::put_str(out, s);
+        }
+        Value::Target(target) => {
+            out.push(TAG_TARGET);
+            util::put_str(out, target.target_path());
+        }
+        Value::Targets(targets) => {
+            out.push(TAG_TARGETS);
+            encode_list(out, targets, |out, target| util::put_str(out, target.target_path()));
+        }
+        Value::Unresolved(info) => {
+            out.push(TAG_UNRESOLVED);
+            util::put_str(out, &info.reason);
+            encode_list(out, &info.select_inputs, encode_string);
+            encode_list(out, &info.select_values, encode_string);
+            encode_list(out, &info.available_filters, encode_string);
+        }
+    }
+}
+
+fn encode_string(out: &mut Vec<u8>, s: &String) {
+    util::put_str(out, s);
+}
+
+fn encode_list<T>(out: &mut Vec<u8>, items: &[T], encode_item: impl Fn(&mut Vec<u8>, &T)) {
+    out.extend((items.len() as u32).to_le_bytes());
+    for item in items {
+        encode_item(out, item);
+    }
+}
+
+fn encode_fields(out: &mut Vec<u8>, fields: &std::collections::HashMap<Identifier, Value>) {
+    // Sorted so the same source always produces the same bytes
+    let mut fields: Vec<_> = fields.iter().collect();
+    fields.sort_unstable_by(|a, b| a.0 .0.cmp(&b.0 .0));
+    encode_list(out, &fields, |out, (key, value)| {
+        util::put_str(out, &key.0);
+        encode_value(out, value);
+    });
+}
+
+fn encode_select(out: &mut Vec<u8>, select: &Select) {
+    encode_list(out, &select.inputs, encode_string);
+    encode_list(out, &select.filters, |out, (filter, value)| {
+        out.push(filter.is_some() as u8);
+        if let Some(filter) = filter {
+            encode_list(out, filter, |out, options| {
+                out.push(options.is_some() as u8);
+                if let Some(options) = options {
+                    encode_list(out, options, encode_string);
+                }
+            });
+        }
+        encode_value(out, value);
+    });
+}
+
+fn decode_value(r: &mut ByteReader) -> anyhow::Result<Value> {
+    let tag = r.take(1)?[0];
+    Ok(match tag {
+        TAG_ARRAY => Value::Array(r.list(decode_value)?),
+        TAG_CONCAT => Value::Concat((Box::new(decode_value(r)?), Box::new(decode_value(r)?))),
+        TAG_OBJECT => Value::Object(Object {
+            typename: r.string()?,
+            fields: decode_fields(r)?,
+        }),
+        TAG_GLOB => Value::Glob(Glob {
+            includes: r.list(ByteReader::string)?,
+            excludes: r.list(ByteReader::string)?,
+        }),
+        TAG_MAP => Value::Map(decode_fields(r)?),
+        TAG_REL_PATH => Value::RelPath(r.string()?),
+        TAG_REL_PATHS => Value::RelPaths(r.list(ByteReader::string)?),
+        TAG_PATH => Value::Path(r.string()?.into()),
+        TAG_PATHS => Value::Paths(r.list(|r| Ok(r.string()?.into()))?),
+        TAG_SELECT => Value::Select(decode_select(r)?),
+        TAG_MULTI_SELECT => Value::MultiSelect(decode_select(r)?),
+        TAG_STRING => Value::String(r.string()?),
+        TAG_TARGET => Value::Target(AnubisTarget::new(r.str()?)?),
+        TAG_TARGETS => Value::Targets(r.list(|r| AnubisTarget::new(r.str()?))?),
+        TAG_UNRESOLVED => Value::Unresolved(UnresolvedInfo {
+            reason: r.string()?,
+            select_inputs: r.list(ByteReader::string)?,
+            select_values: r.list(ByteReader::string)?,
+            available_filters: r.list(ByteReader::string)?,
+        }),
+        _ => bail_loc!("Unknown papyrus snapshot tag [{}]", tag),
+    })
+}
+
+fn decode_fields(r: &mut ByteReader) -> anyhow::Result<std::collections::HashMap<Identifier, Value>> {
+    let count = r.u32()? as usize;
+    let mut fields = std::collections::HashMap::with_capacity(count);
+    for _ in 0..count {
+        let key = Identifier::new(r.str()?);
+        fields.insert(key, decode_value(r)?);
+    }
+    Ok(fields)
+}
+
+fn decode_select(r: &mut ByteReader) -> anyhow::Result<Select> {
+    let inputs = r.list(ByteReader::string)?;
+    let filters = r.list(|r| {
+        let filter = match r.flag()? {
+            true => Some(r.list(|r| match r.flag()? {
+                true => Ok(Some(r.list(ByteReader::string)?)),
+                false => Ok(None),
+            })?),
+            false => None,
+        };
+        Ok((filter, decode_value(r)?))
+    })?;
+    Ok(Select { inputs, filters })
+}
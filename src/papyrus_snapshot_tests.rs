@@ -0,0 +1,181 @@
+//! Tests and benchmarks for papyrus_snapshot.rs
+
+use camino::Utf8PathBuf;
+use std::time::Instant;
+
+use crate::papyrus::{read_papyrus_str, Value};
+use crate::papyrus_snapshot::*;
+use crate::test_utils::scratch_dir;
+
+const CONFIG: &str = r#"
+cc_binary(
+    name = "main",
+    lang = "cpp",
+    srcs = [ RelPath("src/main.cpp") ] + glob(includes = ["src/*.cpp"], excludes = ["src/skip.cpp"]),
+    deps = Targets([":util", "//other:lib"]),
+    defines = select(
+        (platform, arch) => {
+            (windows, x64) = ["WIN64"],
+            (linux | macos, _) = ["POSIX"],
+            default = [],
+        }
+    ),
+    flags = multi_select(
+        (platform) => {
+            (linux) = ["-pthread"],
+            (windows) = ["/MT"],
+        }
+    ),
+    env = { mode = "fast", level = "3" },
+    sysroot = "-isysroot=" + RelPath("./sysroot"),
+)
+"#;
+
+fn snapshot_files(dir: &Utf8PathBuf) -> usize {
+    std::fs::read_dir(dir).map_or(0, |entries| entries.count())
+}
+
+#[test]
+fn snapshot_roundtrips_parsed_value() -> anyhow::Result<()> {
+    let dir = scratch_dir("papyrus_snapshot_tests", "roundtrip");
+    let config = dir.join("ANUBIS");
+    std::fs::write(&config, CONFIG)?;
+    let expected = read_papyrus_str(CONFIG, "test")?;
+
+    // First read parses and writes the snapshot
+    let snapshots = PapyrusSnapshots::new(dir.join(".papyrus"));
+    assert_eq!(snapshots.read_papyrus_file(&config)?, expected);
+    assert_eq!(snapshots.hits(), 0);
+    assert_eq!(snapshot_files(&dir.join(".papyrus")), 1);
+
+    // A fresh process loads it instead of parsing
+    let snapshots = PapyrusSnapshots::new(dir.join(".papyrus"));
+    assert_eq!(snapshots.read_papyrus_file(&config)?, expected);
+    assert_eq!(snapshots.hits(), 1);
+
+    let _ = std::fs::remove_dir_all(&dir);
+    Ok(())
+}
+
+#[test]
+fn edited_source_replaces_snapshot() -> anyhow::Result<()> {
+    let dir = scratch_dir("papyrus_snapshot_tests", "edited");
+    let config = dir.join("ANUBIS");
+    std::fs::write(&config, r#"rule(name = "a")"#)?;
+
+    let snapshots = PapyrusSnapshots::new(dir.join(".papyrus"));
+    snapshots.read_papyrus_file(&config)?;
+    std::fs::write(&config, r#"rule(name = "b")"#)?;
+    let value = snapshots.read_papyrus_file(&config)?;
+
+    assert_eq!(value, read_papyrus_str(r#"rule(name = "b")"#, "test")?);
+    assert_eq!(snapshots.hits(), 0);
+    assert_eq!(snapshot_files(&dir.join(".papyrus")), 1);
+    snapshots.read_papyrus_file(&config)?;
+    assert_eq!(snapshots.hits(), 1);
+
+    let _ = std::fs::remove_dir_all(&dir);
+    Ok(())
+}
+
+#[test]
+fn unreadable_snapshot_is_reparsed() -> anyhow::Result<()> {
+    let dir = scratch_dir("papyrus_snapshot_tests", "unreadable");
+    let config = dir.join("ANUBIS");
+    std::fs::write(&config, CONFIG)?;
+
+    let snapshots = PapyrusSnapshots::new(dir.join(".papyrus"));
+    snapshots.read_papyrus_file(&config)?;
+    let snapshot = std::fs::read_dir(dir.join(".papyrus"))?.next().unwrap()?.path();
+    let bytes = std::fs::read(&snapshot)?;
+    std::fs::write(&snapshot, &bytes[..bytes.len() / 2])?;
+
+    assert_eq!(snapshots.read_papyrus_file(&config)?, read_papyrus_str(CONFIG, "test")?);
+    assert_eq!(snapshots.hits(), 0);
+    assert_eq!(std::fs::read(&snapshot)?, bytes);
+
+    // Parse errors are reported, not snapshotted
+    std::fs::write(&config, "rule(name = ")?;
+    assert!(snapshots.read_papyrus_file(&config).is_err());
+    assert!(snapshots.read_papyrus_file(&dir.join("missing/ANUBIS")).is_err());
+
+    let _ = std::fs::remove_dir_all(&dir);
+    Ok(())
+}
+
+/// Writes `count` ANUBIS files shaped like a library-per-directory monorepo.
+fn generate_monorepo(root: &Utf8PathBuf, count: usize) -> anyhow::Result<Vec<Utf8PathBuf>> {
+    let mut files = Vec::with_capacity(count);
+    for i in 0..count {
+        let dir = root.join(format!("lib{}", i));
+        std::fs::create_dir_all(&dir)?;
+        let mut config = String::new();
+        for j in 0..8usize {
+            let srcs: Vec<String> = (0..12).map(|k| format!("RelPath(\"src/file{}_{}.c\")", j, k)).collect();
+            config += &format!(
+                r#"
+cc_static_library(
+    name = "lib{i}_{j}",
+    lang = "c",
+    srcs = [ {srcs} ] + glob(["gen/*.c"]),
+    public_include_dirs = [ RelPath("include") ],
+    deps = Targets([":lib{i}_{prev}", "//lib{dep}:lib{dep}_0"]),
+    compiler_defines = select(
+        (platform, arch) => {{
+            (windows, x64) = ["LIB{i}_WIN64", "HAVE_THREADS=1"],
+            (linux | macos, _) = ["LIB{i}_POSIX", "HAVE_PTHREAD=1"],
+            default = [],
+        }}
+    ) + ["LIB{i}_VERSION={j}"],
+)
+"#,
+                srcs = srcs.join(", "),
+                prev = j.saturating_sub(1),
+                dep = i / 2,
+            );
+        }
+        let path = dir.join("ANUBIS");
+        std::fs::write(&path, config)?;
+        files.push(path);
+    }
+    Ok(files)
+}
+
+/// Benchmark: startup cost of loading a 500-file monorepo by parsing vs. from snapshots.
+/// Run with: cargo test --release bench_snapshot_load -- --ignored --nocapture
+#[test]
+#[ignore]
+fn bench_snapshot_load() -> anyhow::Result<()> {
+    let root = scratch_dir("papyrus_snapshot_tests", "bench");
+    let files = generate_monorepo(&root, 500)?;
+    let source_bytes: u64 = files.iter().map(|f| std::fs::metadata(f).map_or(0, |m| m.len())).sum();
+
+    let load_all = |snapshots: &PapyrusSnapshots| -> anyhow::Result<Vec<Value>> {
+        files.iter().map(|file| snapshots.read_papyrus_file(file)).collect()
+    };
+
+    let start = Instant::now();
+    let parsed = load_all(&PapyrusSnapshots::default())?;
+    let cold_parse = start.elapsed();
+
+    let snapshots = PapyrusSnapshots::new(root.join(".papyrus"));
+    let start = Instant::now();
+    load_all(&snapshots)?;
+    let parse_and_write = start.elapsed();
+
+    let snapshots = PapyrusSnapshots::new(root.join(".papyrus"));
+    let start = Instant::now();
+    let loaded = load_all(&snapshots)?;
+    let snapshot_load = start.elapsed();
+
+    assert_eq!(snapshots.hits(), files.len());
+    assert!(parsed == loaded);
+    println!("{} files, {} KiB of Papyrus", files.len(), source_bytes / 1024);
+    println!("  cold parse:        {:?}", cold_parse);
+    println!("  parse + snapshot:  {:?}", parse_and_write);
+    println!("  snapshot load:     {:?}", snapshot_load);
+    println!("  speedup:           {:.1}x", cold_parse.as_secs_f64() / snapshot_load.as_secs_f64());
+
+    let _ = std::fs::remove_dir_all(&root);
+    Ok(())
+}
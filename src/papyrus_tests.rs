@@ -1,4 +1,5 @@
 use crate::anubis::AnubisTarget;
+use crate::glob_cache::GlobCache;
 use crate::papyrus::*;
 use crate::rules::cc_rules::CcBinary;
 use anyhow::Result;
@@ -113,17 +114,17 @@ fn test_parse_basic_types() -> Result<()> {
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
             assert_eq!(obj.typename, "test_rule");
-            if let Value::String(s) = &obj.fields[&Identifier("string".to_string())] {
+            if let Value::String(s) = &obj.fields[&Identifier::new("string")] {
                 assert_eq!(s, "hello world");
             } else {
                 panic!("Expected string value");
             }
-            if let Value::Array(arr) = &obj.fields[&Identifier("array".to_string())] {
+            if let Value::Array(arr) = &obj.fields[&Identifier::new("array")] {
                 assert_eq!(arr.len(), 3);
             } else {
                 panic!("Expected array value");
             }
-            if let Value::Map(map) = &obj.fields[&Identifier("map".to_string())] {
+            if let Value::Map(map) = &obj.fields[&Identifier::new("map")] {
                 assert_eq!(map.len(), 2);
             } else {
                 panic!("Expected map value");
@@ -166,7 +167,7 @@ fn test_glob_parsing_simple() -> Result<()> {
     let value = read_papyrus_str(config_str, "test")?;
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Glob(glob) = &obj.fields[&Identifier("files".to_string())] {
+            if let Value::Glob(glob) = &obj.fields[&Identifier::new("files")] {
                 assert_eq!(glob.includes.len(), 2);
                 assert_eq!(glob.includes[0], "*.cpp");
                 assert_eq!(glob.includes[1], "src/**/*.h");
@@ -192,7 +193,7 @@ fn test_glob_parsing_with_exclude() -> Result<()> {
     let value = read_papyrus_str(config_str, "test")?;
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Glob(glob) = &obj.fields[&Identifier("files".to_string())] {
+            if let Value::Glob(glob) = &obj.fields[&Identifier::new("files")] {
                 assert_eq!(glob.includes.len(), 2);
                 assert_eq!(glob.includes[0], "*.cpp");
                 assert_eq!(glob.includes[1], "src/**/*.h");
@@ -225,7 +226,7 @@ fn test_select_parsing() -> Result<()> {
     let value = read_papyrus_str(config_str, "test")?;
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Select(select) = &obj.fields[&Identifier("config".to_string())] {
+            if let Value::Select(select) = &obj.fields[&Identifier::new("config")] {
                 assert_eq!(select.inputs.len(), 2);
                 assert_eq!(select.filters.len(), 3);
             } else {
@@ -255,11 +256,11 @@ fn test_select_resolution() -> Result<()> {
     vars.insert("arch".to_string(), "x64".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::String(s) = &obj.fields[&Identifier("config".to_string())] {
+            if let Value::String(s) = &obj.fields[&Identifier::new("config")] {
                 assert_eq!(s, "win64");
             } else {
                 panic!("Expected resolved string value");
@@ -279,11 +280,11 @@ fn test_concat_arrays() -> Result<()> {
     "#;
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &HashMap::new())?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &HashMap::new())?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(files) = &obj.fields[&Identifier("files".to_string())] {
+            if let Value::Array(files) = &obj.fields[&Identifier::new("files")] {
                 assert_eq!(files.len(), 4);
                 assert_eq!(
                     files,
@@ -318,11 +319,11 @@ fn test_concat_arrays_select() -> Result<()> {
 
     let mut vars = HashMap::<String, String>::new();
     vars.insert("platform".into(), "windows".into());
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(files) = &obj.fields[&Identifier("files".to_string())] {
+            if let Value::Array(files) = &obj.fields[&Identifier::new("files")] {
                 assert_eq!(files.len(), 4);
                 assert_eq!(
                     files,
@@ -355,13 +356,13 @@ fn test_concat_objects() -> Result<()> {
     "#;
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &HashMap::new())?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &HashMap::new())?;
 
     if let Value::Array(arr) = resolved {
         assert_eq!(arr.len(), 1);
 
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(files) = &obj.fields[&Identifier("files".to_string())] {
+            if let Value::Array(files) = &obj.fields[&Identifier::new("files")] {
                 assert_eq!(files.len(), 4);
                 assert_eq!(
                     files,
@@ -376,7 +377,7 @@ fn test_concat_objects() -> Result<()> {
                 panic!("Expected array value");
             }
 
-            if let Value::String(name) = &obj.fields[&Identifier("name".to_string())] {
+            if let Value::String(name) = &obj.fields[&Identifier::new("name")] {
                 assert_eq!(name, "John");
             } else {
                 panic!("Expected array value");
@@ -395,7 +396,7 @@ fn test_invalid_concat() {
     "#;
 
     let value = read_papyrus_str(config_str, "test").unwrap();
-    let result = resolve_value(value, &PathBuf::from("."), &HashMap::new());
+    let result = resolve_value(&value, &PathBuf::from("."), &HashMap::new());
     assert!(result.is_err());
 }
 
@@ -416,9 +417,9 @@ fn test_nested_objects() -> Result<()> {
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
             assert_eq!(obj.typename, "parent_rule");
-            if let Value::Object(child) = &obj.fields[&Identifier("child".to_string())] {
+            if let Value::Object(child) = &obj.fields[&Identifier::new("child")] {
                 assert_eq!(child.typename, "child_rule");
-                if let Value::String(s) = &child.fields[&Identifier("value".to_string())] {
+                if let Value::String(s) = &child.fields[&Identifier::new("value")] {
                     assert_eq!(s, "nested");
                 } else {
                     panic!("Expected string value in nested object");
@@ -450,11 +451,11 @@ fn test_resolve_with_vars() -> Result<()> {
     vars.insert("env".to_string(), "dev".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::String(s) = &obj.fields[&Identifier("value".to_string())] {
+            if let Value::String(s) = &obj.fields[&Identifier::new("value")] {
                 assert_eq!(s, "development");
             } else {
                 panic!("Expected string value after resolution");
@@ -477,11 +478,11 @@ fn test_resolve_missing_vars() -> Result<()> {
     "#;
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &HashMap::new())?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &HashMap::new())?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::String(s) = &obj.fields[&Identifier("value".to_string())] {
+            if let Value::String(s) = &obj.fields[&Identifier::new("value")] {
                 assert_eq!(s, "unknown", "Should use default value when vars are missing");
             } else {
                 panic!("Expected string value after resolution");
@@ -575,7 +576,7 @@ fn test_select_no_match_returns_unresolved() -> Result<()> {
     vars.insert("platform".to_string(), "macos".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     // The entire object should be unresolved because the config field is unresolved
     if let Value::Array(arr) = &resolved {
@@ -609,12 +610,12 @@ fn test_select_with_default_still_resolves() -> Result<()> {
     vars.insert("platform".to_string(), "macos".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     // Should resolve to default value
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::String(s) = &obj.fields[&Identifier("config".to_string())] {
+            if let Value::String(s) = &obj.fields[&Identifier::new("config")] {
                 assert_eq!(s, "fallback");
             } else {
                 panic!("Expected string value");
@@ -645,7 +646,7 @@ fn test_unresolved_propagates_through_concat() -> Result<()> {
     vars.insert("platform".to_string(), "linux".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     // The object should be unresolved because the concat result is unresolved
     if let Value::Array(arr) = &resolved {
@@ -681,7 +682,7 @@ fn test_multiple_rules_partial_resolution() -> Result<()> {
     vars.insert("platform".to_string(), "linux".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     // First rule should be unresolved, second should be resolved
     if let Value::Array(arr) = &resolved {
@@ -726,7 +727,7 @@ fn test_unresolved_info_contains_diagnostic_data() -> Result<()> {
     vars.insert("arch".to_string(), "x64".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = &resolved {
         let info = arr[0].as_unresolved().expect("Should have unresolved info");
@@ -763,7 +764,7 @@ fn test_deserialize_unresolved_fails_with_info() {
     vars.insert("platform".to_string(), "linux".to_string());
 
     let value = read_papyrus_str(config_str, "test").unwrap();
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars).unwrap();
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars).unwrap();
 
     // Attempting to deserialize an unresolved object should fail with detailed error
     let result: Result<TestRule> = resolved.deserialize_named_object("unresolved_target");
@@ -791,15 +792,16 @@ fn test_relative_target_resolved_with_dir() -> Result<()> {
 
     // Resolve with a directory relative path
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("."),
         &HashMap::new(),
         Some("examples/myproject"),
+        &GlobCache::default(),
     )?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Targets(deps) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Targets(deps) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(deps.len(), 2);
                 // First dep should be resolved to absolute path
                 assert_eq!(
@@ -832,11 +834,11 @@ fn test_relative_target_without_dir_unchanged() -> Result<()> {
     let value = read_papyrus_str(config_str, "test")?;
 
     // Resolve without a directory path (using the basic resolve_value)
-    let resolved = resolve_value(value, &PathBuf::from("."), &HashMap::new())?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &HashMap::new())?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(deps) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Array(deps) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(deps.len(), 1);
                 // Relative dep should remain unchanged when no dir_relpath is provided
                 assert_eq!(deps[0], Value::String(":relative_dep".to_string()));
@@ -873,11 +875,17 @@ fn test_relative_target_in_nested_select() -> Result<()> {
     vars.insert("platform".to_string(), "windows".to_string());
 
     // Resolve with a directory relative path
-    let resolved = resolve_value_with_dir(value, &PathBuf::from("."), &vars, Some("libs/mylib"))?;
+    let resolved = resolve_value_with_dir(
+        &value,
+        &PathBuf::from("."),
+        &vars,
+        Some("libs/mylib"),
+        &GlobCache::default(),
+    )?;
 
     if let Value::Array(ref arr) = &resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(deps) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Array(deps) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(deps.len(), 1);
                 // Relative dep should be resolved
                 assert_eq!(
@@ -909,15 +917,16 @@ fn test_relative_target_in_concat() -> Result<()> {
 
     // Resolve with a directory relative path
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("."),
         &HashMap::new(),
         Some("path/to/module"),
+        &GlobCache::default(),
     )?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(deps) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Array(deps) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(deps.len(), 3);
                 assert_eq!(
                     deps[0],
@@ -977,13 +986,13 @@ fn test_target_parsing() -> Result<()> {
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
             // Check single_dep
-            if let Value::Target(target) = &obj.fields[&Identifier("single_dep".to_string())] {
+            if let Value::Target(target) = &obj.fields[&Identifier::new("single_dep")] {
                 assert_eq!(target, &AnubisTarget::new(":local_lib").unwrap());
             } else {
                 panic!("Expected Target value for single_dep");
             }
             // Check absolute_dep
-            if let Value::Target(target) = &obj.fields[&Identifier("absolute_dep".to_string())] {
+            if let Value::Target(target) = &obj.fields[&Identifier::new("absolute_dep")] {
                 assert_eq!(target, &AnubisTarget::new("//path/to:other_lib").unwrap());
             } else {
                 panic!("Expected Target value for absolute_dep");
@@ -1010,7 +1019,7 @@ fn test_targets_parsing() -> Result<()> {
 
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Targets(targets) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Targets(targets) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(targets.len(), 3);
                 assert_eq!(targets[0], AnubisTarget::new(":lib1").unwrap());
                 assert_eq!(targets[1], AnubisTarget::new(":lib2").unwrap());
@@ -1038,15 +1047,16 @@ fn test_target_resolution_with_dir() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("examples/mylib"),
+        &GlobCache::default(),
     )?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Target(target) = &obj.fields[&Identifier("dep".to_string())] {
+            if let Value::Target(target) = &obj.fields[&Identifier::new("dep")] {
                 assert_eq!(target, &AnubisTarget::new("//examples/mylib:local_lib").unwrap());
             } else {
                 panic!("Expected Target value");
@@ -1071,15 +1081,16 @@ fn test_targets_resolution_with_dir() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("examples/myapp"),
+        &GlobCache::default(),
     )?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Targets(targets) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Targets(targets) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(targets.len(), 3);
                 // Relative targets should be resolved
                 assert_eq!(targets[0], AnubisTarget::new("//examples/myapp:lib1").unwrap());
@@ -1109,15 +1120,16 @@ fn test_targets_concat() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("examples/myapp"),
+        &GlobCache::default(),
     )?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Targets(targets) = &obj.fields[&Identifier("deps".to_string())] {
+            if let Value::Targets(targets) = &obj.fields[&Identifier::new("deps")] {
                 assert_eq!(targets.len(), 3);
                 assert_eq!(targets[0], AnubisTarget::new("//examples/myapp:lib1").unwrap());
                 assert_eq!(targets[1], AnubisTarget::new("//examples/myapp:lib2").unwrap());
@@ -1148,11 +1160,11 @@ fn test_concat_string_and_relpath() -> Result<()> {
     "#;
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("/project"), &HashMap::new())?;
+    let resolved = resolve_value(&value, &PathBuf::from("/project"), &HashMap::new())?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::String(flag) = &obj.fields[&Identifier("flag".to_string())] {
+            if let Value::String(flag) = &obj.fields[&Identifier::new("flag")] {
                 // The path should be resolved relative to /project
                 assert!(
                     flag.starts_with("-isysroot="),
@@ -1183,11 +1195,11 @@ fn test_concat_string_and_relpath_in_array() -> Result<()> {
     "#;
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("/project"), &HashMap::new())?;
+    let resolved = resolve_value(&value, &PathBuf::from("/project"), &HashMap::new())?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 assert_eq!(flags.len(), 2);
 
                 if let Value::String(flag0) = &flags[0] {
@@ -1239,7 +1251,7 @@ fn test_multi_select_parsing() -> Result<()> {
     let value = read_papyrus_str(config_str, "test")?;
     if let Value::Array(arr) = value {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::MultiSelect(select) = &obj.fields[&Identifier("config".to_string())] {
+            if let Value::MultiSelect(select) = &obj.fields[&Identifier::new("config")] {
                 assert_eq!(select.inputs.len(), 2);
                 assert_eq!(select.filters.len(), 3);
             } else {
@@ -1268,11 +1280,11 @@ fn test_multi_select_single_match() -> Result<()> {
     vars.insert("platform".to_string(), "windows".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 assert_eq!(flags.len(), 1);
                 assert_eq!(flags[0], Value::String("-DWINDOWS".to_string()));
             } else {
@@ -1303,11 +1315,11 @@ fn test_multi_select_multiple_matches() -> Result<()> {
     vars.insert("arch".to_string(), "x64".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 // Should have both -DWINDOWS and -DX64 concatenated
                 assert_eq!(flags.len(), 2, "Expected 2 flags from multi_select");
                 assert_eq!(flags[0], Value::String("-DWINDOWS".to_string()));
@@ -1339,11 +1351,11 @@ fn test_multi_select_default_only_when_no_match() -> Result<()> {
     vars.insert("platform".to_string(), "macos".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 assert_eq!(flags.len(), 1);
                 assert_eq!(flags[0], Value::String("-DUNKNOWN".to_string()));
             } else {
@@ -1372,11 +1384,11 @@ fn test_multi_select_default_ignored_when_match_exists() -> Result<()> {
     vars.insert("platform".to_string(), "windows".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 // Should only have -DWINDOWS, NOT the default
                 assert_eq!(flags.len(), 1);
                 assert_eq!(flags[0], Value::String("-DWINDOWS".to_string()));
@@ -1407,11 +1419,11 @@ fn test_multi_select_preserves_order() -> Result<()> {
     vars.insert("b".to_string(), "yes".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 // All three should match, in config file order
                 assert_eq!(flags.len(), 3);
                 assert_eq!(flags[0], Value::String("third".to_string()));
@@ -1443,7 +1455,7 @@ fn test_multi_select_no_match_no_default_returns_unresolved() -> Result<()> {
     vars.insert("platform".to_string(), "macos".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = &resolved {
         assert!(
@@ -1476,11 +1488,11 @@ fn test_multi_select_with_concat() -> Result<()> {
     vars.insert("platform".to_string(), "windows".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 assert_eq!(flags.len(), 2);
                 assert_eq!(flags[0], Value::String("-DBASE".to_string()));
                 assert_eq!(flags[1], Value::String("-DWINDOWS".to_string()));
@@ -1510,11 +1522,11 @@ fn test_multi_select_with_or_patterns() -> Result<()> {
     vars.insert("platform".to_string(), "linux".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(obj) = &arr[0] {
-            if let Value::Array(flags) = &obj.fields[&Identifier("flags".to_string())] {
+            if let Value::Array(flags) = &obj.fields[&Identifier::new("flags")] {
                 assert_eq!(flags.len(), 2);
                 assert_eq!(flags[0], Value::String("-DDESKTOP".to_string()));
                 assert_eq!(flags[1], Value::String("-DUNIX".to_string()));
@@ -1544,11 +1556,11 @@ fn test_multi_select_with_objects() -> Result<()> {
     vars.insert("mode".to_string(), "debug".to_string());
 
     let value = read_papyrus_str(config_str, "test")?;
-    let resolved = resolve_value(value, &PathBuf::from("."), &vars)?;
+    let resolved = resolve_value(&value, &PathBuf::from("."), &vars)?;
 
     if let Value::Array(arr) = resolved {
         if let Value::Object(outer_obj) = &arr[0] {
-            if let Value::Object(inner_obj) = &outer_obj.fields[&Identifier("config".to_string())] {
+            if let Value::Object(inner_obj) = &outer_obj.fields[&Identifier::new("config")] {
                 assert_eq!(inner_obj.typename, "inner");
                 assert!(inner_obj.fields.contains_key("a"));
             } else {
@@ -1589,10 +1601,11 @@ fn test_target_syntax_accepted_for_anubis_target() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("test/dir"),
+        &GlobCache::default(),
     )?;
 
     // Deserialize the rule
@@ -1619,10 +1632,11 @@ fn test_string_syntax_rejected_for_anubis_target() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("test/dir"),
+        &GlobCache::default(),
     )?;
 
     // Attempt to deserialize - this should fail because "//lib:foo" is a String, not a Target
@@ -1655,10 +1669,11 @@ fn test_relative_target_syntax_accepted() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("my/module"),
+        &GlobCache::default(),
     )?;
 
     let rule: RuleWithDeps = resolved.deserialize_named_object("my_rule")?;
@@ -1682,10 +1697,11 @@ fn test_relative_string_syntax_rejected() -> Result<()> {
 
     let value = read_papyrus_str(config_str, "test")?;
     let resolved = resolve_value_with_dir(
-        value,
+        &value,
         &PathBuf::from("/project"),
         &HashMap::new(),
         Some("my/module"),
+        &GlobCache::default(),
     )?;
 
     // This should fail because ":local_dep" is a String, not a Target
@@ -0,0 +1,415 @@
+//! Child process management for external tools.
+//!
+//! Every tool is handed to a single reaper thread that owns the `Child` until it exits. `spawn`
+//! returns right away and runs a callback on the reaper thread when the tool exits, which lets
+//! the job system keep tools in flight without pinning a worker to each. `output` waits for the
+//! exit on a channel instead. Either way the reactor can kill in-flight children the moment a
+//! build aborts instead of letting every running compile finish first.
+//!
+//! stdout and stderr go to capture files rather than pipes. Nothing has to drain them while the
+//! tool runs, so a chatty tool can never stall on a full pipe, and no per-child reader threads
+//! are needed. The files are read once the tool exits and then deleted.
+//!
+//! On unix the reaper blocks in `waitid(P_ALL, WNOWAIT)` until any child exits, then reaps it
+//! with `wait4`, which also returns its resource usage. `WNOWAIT` leaves children the reactor
+//! doesn't own (e.g. a `Command::status` elsewhere in the process) for their owner to reap.
+//! Elsewhere it sweeps `try_wait`, backing off from 100µs to 2ms while nothing exits.
+//!
+//! The usage of every tool a job waits on with `output` is summed per worker thread and picked
+//! up by the job system when the job ends.
+
+use std::cell::Cell;
+use std::io::{Read, Seek};
+use std::path::PathBuf;
+use std::process::{Child, Command, ExitStatus, Output, Stdio};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Condvar, Mutex, OnceLock};
+use std::time::{Duration, Instant};
+
+/// How long to leave an exited child the reactor doesn't know (yet) to its owner.
+#[cfg(unix)]
+const FOREIGN_CHILD_BACKOFF: Duration = Duration::from_millis(1);
+#[cfg(not(unix))]
+const MIN_SWEEP_INTERVAL: Duration = Duration::from_micros(100);
+#[cfg(not(unix))]
+const MAX_SWEEP_INTERVAL: Duration = Duration::from_millis(2);
+
+static REACTOR: OnceLock<ProcessReactor> = OnceLock::new();
+static CAPTURE_DIR: OnceLock<PathBuf> = OnceLock::new();
+static NEXT_CAPTURE: AtomicU64 = AtomicU64::new(0);
+static SPAWNED: AtomicU64 = AtomicU64::new(0);
+
+thread_local! {
+    /// Usage of the tools run by the job on this thread so far.
+    static JOB_USAGE: Cell<Option<ResourceUsage>> = const { Cell::new(None) };
+}
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+/// Resources consumed by one or more child processes.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ResourceUsage {
+    pub user_time: Duration,
+    pub system_time: Duration,
+    /// Peak resident set size in bytes. The largest child's peak when summed.
+    pub max_rss: u64,
+    /// Filesystem input and output, in 512-byte blocks.
+    pub read_blocks: u64,
+    pub written_blocks: u64,
+}
+
+/// How a child started with `spawn` exited, with everything it wrote.
+#[derive(Debug)]
+pub struct ChildExit {
+    pub output: Output,
+    pub usage: Option<ResourceUsage>,
+    /// Wall time from spawn to exit.
+    pub duration: Duration,
+}
+
+/// Runs on the reaper thread once a spawned child exits. Must not wait on other children.
+pub type OnExit = Box<dyn FnOnce(std::io::Result<ChildExit>) + Send>;
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Default)]
+struct ProcessReactor {
+    children: Mutex<Vec<InFlight>>,
+    cvar: Condvar,
+}
+
+struct InFlight {
+    child: Child,
+    /// The job system that started this child, so an abort only kills its own children.
+    group: usize,
+    stdout: CaptureFile,
+    stderr: CaptureFile,
+    start: Instant,
+    on_exit: OnExit,
+}
+
+/// A file that receives one stream of a child and is deleted on drop.
+struct CaptureFile {
+    path: PathBuf,
+    file: std::fs::File,
+}
+
+// ----------------------------------------------------------------------------
+// Public functions
+// ----------------------------------------------------------------------------
+/// Puts capture files under `dir` instead of the system temp directory.
+pub fn set_capture_dir(dir: PathBuf) {
+    let _ = CAPTURE_DIR.set(dir);
+}
+
+/// Starts `cmd` and returns without waiting for it. `on_exit` runs on the reaper thread once it
+/// exits. `group` tags the child for `kill_group`.
+pub fn spawn(cmd: &mut Command, group: usize, on_exit: OnExit) -> std::io::Result<()> {
+    let stdout = CaptureFile::new("stdout")?;
+    let stderr = CaptureFile::new("stderr")?;
+    cmd.stdin(Stdio::null()).stdout(stdout.stdio()?).stderr(stderr.stdio()?);
+    let start = Instant::now();
+    let child = cmd.spawn()?;
+    SPAWNED.fetch_add(1, Ordering::Relaxed);
+
+    reactor().register(InFlight {
+        child,
+        group,
+        stdout,
+        stderr,
+        start,
+        on_exit,
+    });
+    Ok(())
+}
+
+/// Runs `cmd` to completion and collects its output, like `Command::output`. `group` tags the
+/// child for `kill_group`.
+pub fn output(cmd: &mut Command, group: usize) -> std::io::Result<Output> {
+    let (done_tx, done_rx) = crossbeam::channel::bounded(1);
+    spawn(cmd, group, Box::new(move |exit| drop(done_tx.send(exit))))?;
+    let exit = done_rx
+        .recv()
+        .map_err(|_| std::io::Error::other("Process reactor dropped a child without reporting its exit"))??;
+    if let Some(usage) = exit.usage {
+        add_thread_usage(usage);
+    }
+    Ok(exit.output)
+}
+
+/// Kills every in-flight child of `group`. Their exits are reported as usual once reaped.
+pub fn kill_group(group: usize) {
+    let Some(reactor) = REACTOR.get() else {
+        return;
+    };
+
+    // Children are only reaped under this lock, so none of these pids can have been reused
+    let mut children = reactor.children.lock().unwrap();
+    let mut killed = 0;
+    for in_flight in children.iter_mut().filter(|c| c.group == group) {
+        let _ = in_flight.child.kill();
+        killed += 1;
+    }
+    if killed > 0 {
+        tracing::debug!("Killing {} in-flight child processes", killed);
+    }
+}
+
+/// Returns and resets the usage of every tool run on this thread since the last call.
+pub fn take_thread_usage() -> Option<ResourceUsage> {
+    JOB_USAGE.with(|total| total.take())
+}
+
+/// Counts `usage` toward the job running on this thread, e.g. for a tool it started with `spawn`.
+pub fn add_thread_usage(usage: ResourceUsage) {
+    JOB_USAGE.with(|total| total.set(Some(total.get().unwrap_or_default() + usage)));
+}
+
+/// Number of children started by this process so far.
+pub fn spawned() -> u64 {
+    SPAWNED.load(Ordering::Relaxed)
+}
+
+/// Number of children currently waiting to be reaped.
+pub fn in_flight() -> usize {
+    REACTOR.get().map_or(0, |r| r.children.lock().unwrap().len())
+}
+
+// ----------------------------------------------------------------------------
+// Private functions
+// ----------------------------------------------------------------------------
+fn reactor() -> &'static ProcessReactor {
+    REACTOR.get_or_init(|| {
+        std::thread::Builder::new()
+            .name("process-reactor".into())
+            .spawn(|| reactor().reap())
+            .expect("Failed to spawn process reactor thread");
+        Default::default()
+    })
+}
+
+/// Blocks until any child of this process has exited and returns its pid, leaving it unreaped.
+#[cfg(unix)]
+fn wait_any() -> std::io::Result<u32> {
+    loop {
+        // SAFETY: `siginfo_t` is plain data, so all-zeroes is a valid value
+        let mut info: libc::siginfo_t = unsafe { std::mem::zeroed() };
+        // SAFETY: valid out-pointer; WNOWAIT leaves the child waitable
+        if unsafe { libc::waitid(libc::P_ALL, 0, &mut info, libc::WEXITED | libc::WNOWAIT) } == 0 {
+            return Ok(siginfo_pid(&info) as u32);
+        }
+        match std::io::Error::last_os_error() {
+            e if e.kind() == std::io::ErrorKind::Interrupted => continue,
+            e => return Err(e),
+        }
+    }
+}
+
+#[cfg(all(unix, any(target_os = "linux", target_os = "android")))]
+fn siginfo_pid(info: &libc::siginfo_t) -> libc::pid_t {
+    // SAFETY: filled in by a successful waitid
+    unsafe { info.si_pid() }
+}
+
+#[cfg(all(unix, not(any(target_os = "linux", target_os = "android"))))]
+fn siginfo_pid(info: &libc::siginfo_t) -> libc::pid_t {
+    info.si_pid
+}
+
+/// Reaps `child`, which `wait_any` reported as exited, returning its status and resource usage.
+#[cfg(unix)]
+fn reap_exited(child: &Child) -> std::io::Result<(ExitStatus, Option<ResourceUsage>)> {
+    use std::os::unix::process::ExitStatusExt;
+
+    let mut status: libc::c_int = 0;
+    // SAFETY: `rusage` is plain data, so all-zeroes is a valid value
+    let mut rusage: libc::rusage = unsafe { std::mem::zeroed() };
+    loop {
+        // SAFETY: waits on a pid we own and haven't reaped, with valid out-pointers
+        match unsafe { libc::wait4(child.id() as libc::pid_t, &mut status, 0, &mut rusage) } {
+            -1 => match std::io::Error::last_os_error() {
+                e if e.kind() == std::io::ErrorKind::Interrupted => continue,
+                e => return Err(e),
+            },
+            _ => return Ok((ExitStatus::from_raw(status), Some(ResourceUsage::from_rusage(&rusage)))),
+        }
+    }
+}
+
+#[cfg(not(unix))]
+fn try_reap(child: &mut Child) -> std::io::Result<Option<(ExitStatus, Option<ResourceUsage>)>> {
+    Ok(child.try_wait()?.map(|status| (status, None)))
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+#[cfg(unix)]
+impl ResourceUsage {
+    fn from_rusage(rusage: &libc::rusage) -> ResourceUsage {
+        let time = |t: libc::timeval| Duration::new(t.tv_sec as u64, t.tv_usec as u32 * 1000);
+        // Linux reports max RSS in KiB, macOS in bytes
+        let rss_unit = if cfg!(target_os = "macos") { 1 } else { 1024 };
+        ResourceUsage {
+            user_time: time(rusage.ru_utime),
+            system_time: time(rusage.ru_stime),
+            max_rss: rusage.ru_maxrss as u64 * rss_unit,
+            read_blocks: rusage.ru_inblock as u64,
+            written_blocks: rusage.ru_oublock as u64,
+        }
+    }
+}
+
+impl ResourceUsage {
+    pub fn cpu_time(&self) -> Duration {
+        self.user_time + self.system_time
+    }
+}
+
+impl std::ops::Add for ResourceUsage {
+    type Output = ResourceUsage;
+
+    fn add(self, other: ResourceUsage) -> ResourceUsage {
+        ResourceUsage {
+            user_time: self.user_time + other.user_time,
+            system_time: self.system_time + other.system_time,
+            max_rss: self.max_rss.max(other.max_rss),
+            read_blocks: self.read_blocks + other.read_blocks,
+            written_blocks: self.written_blocks + other.written_blocks,
+        }
+    }
+}
+
+impl ProcessReactor {
+    fn register(&self, in_flight: InFlight) {
+        self.children.lock().unwrap().push(in_flight);
+        self.cvar.notify_one();
+    }
+
+    /// Reaper thread body: reports each child's exit to its `on_exit`.
+    #[cfg(unix)]
+    fn reap(&self) {
+        loop {
+            // Sleep while there's nothing to wait for
+            let mut children = self.children.lock().unwrap();
+            while children.is_empty() {
+                children = self.cvar.wait(children).unwrap();
+            }
+            drop(children);
+
+            let pid = match wait_any() {
+                Ok(pid) => pid,
+                Err(e) => {
+                    // Only possible if someone else reaped our children. Fail them rather than hang.
+                    let failed: Vec<InFlight> = self.children.lock().unwrap().drain(..).collect();
+                    for in_flight in failed {
+                        (in_flight.on_exit)(Err(std::io::Error::new(e.kind(), e.to_string())));
+                    }
+                    continue;
+                }
+            };
+
+            let mut children = self.children.lock().unwrap();
+            let Some(index) = children.iter().position(|c| c.child.id() == pid) else {
+                // Not ours, or not registered yet. Give its owner a moment before looking again.
+                drop(self.cvar.wait_timeout(children, FOREIGN_CHILD_BACKOFF).unwrap());
+                continue;
+            };
+            let in_flight = children.swap_remove(index);
+            let exit = reap_exited(&in_flight.child);
+            drop(children);
+            in_flight.finish(exit);
+        }
+    }
+
+    /// Reaper thread body: sweeps the in-flight children, reporting each exit to its `on_exit`.
+    #[cfg(not(unix))]
+    fn reap(&self) {
+        let mut interval = MIN_SWEEP_INTERVAL;
+        let mut children = self.children.lock().unwrap();
+        loop {
+            if children.is_empty() {
+                children = self.cvar.wait(children).unwrap();
+                interval = MIN_SWEEP_INTERVAL;
+                continue;
+            }
+
+            let mut exited = Vec::new();
+            let mut index = 0;
+            while index < children.len() {
+                match try_reap(&mut children[index].child) {
+                    Ok(None) => index += 1,
+                    exit => exited.push((children.swap_remove(index), exit.map(Option::unwrap))),
+                }
+            }
+
+            interval = if exited.is_empty() {
+                (interval * 2).min(MAX_SWEEP_INTERVAL)
+            } else {
+                MIN_SWEEP_INTERVAL
+            };
+            drop(children);
+            for (in_flight, exit) in exited {
+                in_flight.finish(exit);
+            }
+            children = self.cvar.wait_timeout(self.children.lock().unwrap(), interval).unwrap().0;
+        }
+    }
+}
+
+impl InFlight {
+    /// Collects the output of a reaped child and hands it to `on_exit`.
+    fn finish(mut self, exit: std::io::Result<(ExitStatus, Option<ResourceUsage>)>) {
+        let duration = self.start.elapsed();
+        let exit = exit.and_then(|(status, usage)| {
+            let output = Output {
+                status,
+                stdout: self.stdout.read_all()?,
+                stderr: self.stderr.read_all()?,
+            };
+            Ok(ChildExit { output, usage, duration })
+        });
+        (self.on_exit)(exit);
+    }
+}
+
+impl CaptureFile {
+    fn new(stream: &str) -> std::io::Result<CaptureFile> {
+        let dir = CAPTURE_DIR.get().cloned().unwrap_or_else(std::env::temp_dir);
+        let name = format!(
+            "anubis-{}-{}.{}",
+            std::process::id(),
+            NEXT_CAPTURE.fetch_add(1, Ordering::Relaxed),
+            stream
+        );
+        let path = dir.join(name);
+        let open = || std::fs::File::options().read(true).write(true).create_new(true).open(&path);
+        let file = match open() {
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => {
+                std::fs::create_dir_all(&dir)?;
+                open()?
+            }
+            result => result?,
+        };
+        Ok(CaptureFile { path, file })
+    }
+
+    fn stdio(&self) -> std::io::Result<Stdio> {
+        Ok(Stdio::from(self.file.try_clone()?))
+    }
+
+    fn read_all(&mut self) -> std::io::Result<Vec<u8>> {
+        let mut bytes = Vec::new();
+        self.file.rewind()?;
+        self.file.read_to_end(&mut bytes)?;
+        Ok(bytes)
+    }
+}
+
+impl Drop for CaptureFile {
+    fn drop(&mut self) {
+        let _ = std::fs::remove_file(&self.path);
+    }
+}
@@ -0,0 +1,133 @@
+//! Tests for process_reactor.rs
+
+#![cfg(unix)]
+
+use crate::process_reactor::*;
+use std::process::Command;
+use std::time::{Duration, Instant};
+
+fn shell(script: &str) -> Command {
+    let mut cmd = Command::new("sh");
+    cmd.args(["-c", script]);
+    cmd
+}
+
+#[test]
+fn collects_status_and_both_streams() -> anyhow::Result<()> {
+    let output = output(&mut shell("echo out; echo err >&2; exit 3"), 0)?;
+    assert_eq!(output.status.code(), Some(3));
+    assert_eq!(output.stdout, b"out\n");
+    assert_eq!(output.stderr, b"err\n");
+    Ok(())
+}
+
+#[test]
+fn output_larger_than_a_pipe_buffer() -> anyhow::Result<()> {
+    let output = output(&mut shell("head -c 1048576 /dev/zero; head -c 300000 /dev/zero >&2"), 0)?;
+    assert!(output.status.success());
+    assert_eq!(output.stdout.len(), 1 << 20);
+    assert_eq!(output.stderr.len(), 300000);
+    Ok(())
+}
+
+#[test]
+fn many_children_in_flight() -> anyhow::Result<()> {
+    std::thread::scope(|scope| {
+        let handles: Vec<_> = (0..16)
+            .map(|i| scope.spawn(move || output(&mut shell(&format!("sleep 0.05; echo {}", i)), 0)))
+            .collect();
+        for (i, handle) in handles.into_iter().enumerate() {
+            let output = handle.join().unwrap()?;
+            assert_eq!(String::from_utf8_lossy(&output.stdout).trim(), i.to_string());
+        }
+        Ok::<(), anyhow::Error>(())
+    })
+}
+
+#[test]
+fn kill_group_stops_only_its_children() -> anyhow::Result<()> {
+    const GROUP: usize = 0xdead_0001;
+    let start = Instant::now();
+    std::thread::scope(|scope| {
+        let doomed = scope.spawn(|| output(&mut shell("sleep 30"), GROUP));
+        let survivor = scope.spawn(|| output(&mut shell("sleep 0.3; echo done"), GROUP + 1));
+
+        while in_flight() < 2 {
+            std::thread::sleep(Duration::from_millis(1));
+        }
+        kill_group(GROUP);
+
+        let doomed = doomed.join().unwrap()?;
+        assert!(!doomed.status.success());
+        assert!(start.elapsed() < Duration::from_secs(10));
+
+        let survivor = survivor.join().unwrap()?;
+        assert_eq!(survivor.stdout, b"done\n");
+        Ok::<(), anyhow::Error>(())
+    })
+}
+
+#[test]
+fn children_spawned_elsewhere_are_left_to_their_owner() -> anyhow::Result<()> {
+    std::thread::scope(|scope| {
+        let reactor = scope.spawn(|| output(&mut shell("sleep 0.2; echo reactor"), 0));
+        while in_flight() < 1 {
+            std::thread::sleep(Duration::from_millis(1));
+        }
+
+        // Waited on by std, not the reactor, while a reactor child is still running
+        let status = shell("exit 7").status()?;
+        assert_eq!(status.code(), Some(7));
+
+        let reactor = reactor.join().unwrap()?;
+        assert!(reactor.status.success());
+        assert_eq!(reactor.stdout, b"reactor\n");
+        Ok::<(), anyhow::Error>(())
+    })
+}
+
+#[test]
+fn usage_accumulates_per_thread() -> anyhow::Result<()> {
+    take_thread_usage();
+    assert_eq!(take_thread_usage(), None);
+
+    // Touch a few megabytes so the peak RSS is clearly nonzero
+    output(&mut shell("head -c 8388608 /dev/zero | od > /dev/null"), 0)?;
+    let first = take_thread_usage().expect("usage of the first child");
+    assert!(first.max_rss > 0);
+
+    output(&mut shell("true"), 0)?;
+    output(&mut shell("true"), 0)?;
+    let both = take_thread_usage().expect("usage of the later children");
+    assert!(both.max_rss > 0);
+    assert_eq!(take_thread_usage(), None);
+
+    // Another thread's children don't show up here
+    std::thread::spawn(|| output(&mut shell("true"), 0)).join().unwrap()?;
+    assert_eq!(take_thread_usage(), None);
+    Ok(())
+}
+
+#[test]
+fn usage_sums_times_and_keeps_peak_rss() {
+    let a = ResourceUsage {
+        user_time: Duration::from_millis(30),
+        system_time: Duration::from_millis(5),
+        max_rss: 100 << 20,
+        read_blocks: 8,
+        written_blocks: 2,
+    };
+    let b = ResourceUsage {
+        user_time: Duration::from_millis(70),
+        system_time: Duration::from_millis(15),
+        max_rss: 40 << 20,
+        read_blocks: 1,
+        written_blocks: 4,
+    };
+    let sum = a + b;
+    assert_eq!(sum.user_time, Duration::from_millis(100));
+    assert_eq!(sum.system_time, Duration::from_millis(20));
+    assert_eq!(sum.cpu_time(), Duration::from_millis(120));
+    assert_eq!(sum.max_rss, 100 << 20);
+    assert_eq!((sum.read_blocks, sum.written_blocks), (9, 6));
+}
@@ -8,7 +8,11 @@ use std::time::{Duration, Instant};
 use crate::job_system::{JobDisplayInfo, JobId};
 use crate::logging::LogLevel;
 use crate::logging::PROGRESS_SENDER;
-use crate::util::format_duration;
+use crate::process_reactor::ResourceUsage;
+use crate::util::{format_bytes, format_duration};
+
+/// Jobs listed per ranking in the resource usage summary.
+const TOP_USAGE_JOBS: usize = 5;
 
 /// Duration thresholds for color-coded display.
 const DURATION_WARN: Duration = Duration::from_secs(3);
@@ -37,6 +41,8 @@ pub enum ProgressEvent {
         job_id: JobId,
         display: JobDisplayInfo,
         duration: Duration,
+        /// Summed usage of the external tools the job ran, where the platform reports it.
+        usage: Option<ResourceUsage>,
     },
     WorkerIdle {
         worker_id: usize,
@@ -76,6 +82,8 @@ struct ProgressState {
     start_time: Instant,
     /// Per-worker accumulated active time
     worker_active_time: Vec<Duration>,
+    /// Tool resource usage of each completed job that ran one.
+    job_usage: Vec<(String, ResourceUsage)>,
 }
 
 #[derive(Clone, Copy, PartialEq)]
@@ -169,6 +177,7 @@ fn render_loop(mode: DisplayMode, num_workers: usize, event_rx: Receiver<Progres
         worker_status: (0..num_workers).map(|_| None).collect(),
         start_time: Instant::now(),
         worker_active_time: vec![Duration::ZERO; num_workers],
+        job_usage: Vec::new(),
     };
 
     // Live job counter polled each tick for accurate total
@@ -202,6 +211,7 @@ fn render_loop(mode: DisplayMode, num_workers: usize, event_rx: Receiver<Progres
                             worker_id,
                             display,
                             duration,
+                            usage,
                             ..
                         } => {
                             state.completed_jobs += 1;
@@ -211,6 +221,9 @@ fn render_loop(mode: DisplayMode, num_workers: usize, event_rx: Receiver<Progres
                             }
                             let label = if verbose { &display.detail } else { &display.short_name };
                             let short = format!("{} {}", display.verb, label);
+                            if let Some(usage) = usage {
+                                state.job_usage.push((short.clone(), usage));
+                            }
                             let dur = format_duration(duration);
                             scroll_messages.push(format_scroll_line(&short, &dur, duration));
                         }
@@ -340,6 +353,36 @@ fn render_final_summary(state: &ProgressState, num_workers: usize) {
             state.completed_jobs, elapsed_str, efficiency
         );
     }
+
+    render_usage_summary(&state.job_usage, elapsed);
+}
+
+/// Print total tool CPU time against wall time, and the jobs that used the most memory and CPU.
+fn render_usage_summary(job_usage: &[(String, ResourceUsage)], elapsed: Duration) {
+    if job_usage.is_empty() {
+        return;
+    }
+
+    let total_cpu: Duration = job_usage.iter().map(|(_, usage)| usage.cpu_time()).sum();
+    let parallelism = total_cpu.as_secs_f64() / elapsed.as_secs_f64().max(0.001);
+    println!(
+        "{GRAY}     Usage{RESET} {} tool CPU over {} wall ({:.1}x parallel)",
+        format_duration(total_cpu),
+        format_duration(elapsed),
+        parallelism
+    );
+
+    let mut by_rss: Vec<&(String, ResourceUsage)> = job_usage.iter().collect();
+    by_rss.sort_by_key(|(_, usage)| std::cmp::Reverse(usage.max_rss));
+    for (label, usage) in by_rss.iter().take(TOP_USAGE_JOBS) {
+        println!("{GRAY}    Memory{RESET} {:>10}  {}", format_bytes(usage.max_rss), label);
+    }
+
+    let mut by_cpu = by_rss;
+    by_cpu.sort_by_key(|(_, usage)| std::cmp::Reverse(usage.cpu_time()));
+    for (label, usage) in by_cpu.iter().take(TOP_USAGE_JOBS) {
+        println!("{GRAY}       CPU{RESET} {:>10}  {}", format_duration(usage.cpu_time()), label);
+    }
 }
 
 // ----------------------------------------------------------------------------
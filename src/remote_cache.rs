@@ -0,0 +1,329 @@
+//! Remote action cache over plain HTTP.
+//!
+//! Speaks the bazel-remote HTTP layout so a build farm can share outputs between machines:
+//! - `GET/PUT {base}/ac/{key}`: action manifests
+//! - `GET/PUT {base}/cas/{hash}`: output blobs
+//!
+//! Keys are the same 16-digit xxh3 hex strings used by the local store. Downloads happen
+//! inline during a lookup; uploads are queued to a background thread so workers never wait
+//! on the network. `flush` blocks until the queue drains and is called once per build.
+//!
+//! `CacheServer` is a minimal server for the same protocol backed by a directory, used by
+//! `anubis cache-server` and by tests.
+
+use crate::{anyhow_loc, bail_loc, bail_loc_if, function_name};
+use anyhow::Context;
+use camino::{Utf8Path, Utf8PathBuf};
+use crossbeam::channel::{Receiver, Sender};
+use std::io::{BufRead, BufReader, Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+
+const CONNECT_TIMEOUT: Duration = Duration::from_secs(5);
+const REQUEST_TIMEOUT: Duration = Duration::from_secs(300);
+const IO_TIMEOUT: Duration = Duration::from_secs(60);
+
+// ----------------------------------------------------------------------------
+// Public Structs
+// ----------------------------------------------------------------------------
+#[derive(Debug)]
+pub struct RemoteCache {
+    client: HttpClient,
+    uploads: Sender<Upload>,
+}
+
+/// Namespaces defined by the bazel-remote HTTP layout.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum RemoteKind {
+    ActionCache,
+    Cas,
+}
+
+/// Serves `ac/` and `cas/` entries from a directory.
+#[derive(Debug)]
+pub struct CacheServer {
+    dir: Utf8PathBuf,
+    listener: TcpListener,
+}
+
+// ----------------------------------------------------------------------------
+// Private Structs
+// ----------------------------------------------------------------------------
+#[derive(Clone, Debug)]
+struct HttpClient {
+    agent: ureq::Agent,
+    base_url: String,
+
+    /// Set after the first connection failure so an unreachable server costs one timeout, not one per action.
+    disabled: Arc<AtomicBool>,
+}
+
+#[derive(Debug)]
+enum Upload {
+    Bytes(RemoteKind, u64, Vec<u8>),
+    File(RemoteKind, u64, Utf8PathBuf),
+    Flush(Sender<()>),
+}
+
+// ----------------------------------------------------------------------------
+// Implementations
+// ----------------------------------------------------------------------------
+impl RemoteKind {
+    fn as_str(self) -> &'static str {
+        match self {
+            RemoteKind::ActionCache => "ac",
+            RemoteKind::Cas => "cas",
+        }
+    }
+}
+
+impl RemoteCache {
+    /// Creates a client for `url` (e.g. `http://cache.local:9092` or `https://host/instance`).
+    /// Nothing is sent until the first lookup or upload.
+    pub fn new(url: &str) -> anyhow::Result<RemoteCache> {
+        bail_loc_if!(
+            !url.starts_with("http://") && !url.starts_with("https://"),
+            "Remote cache url [{}] must start with http:// or https://",
+            url
+        );
+        let config = ureq::Agent::config_builder()
+            .timeout_connect(Some(CONNECT_TIMEOUT))
+            .timeout_global(Some(REQUEST_TIMEOUT))
+            .http_status_as_error(false)
+            .build();
+        let client = HttpClient {
+            agent: ureq::Agent::new_with_config(config),
+            base_url: url.trim_end_matches('/').to_owned(),
+            disabled: Default::default(),
+        };
+
+        // The upload thread exits once the cache (and with it the sender) is dropped
+        let (tx, rx) = crossbeam::channel::unbounded();
+        let upload_client = client.clone();
+        std::thread::Builder::new()
+            .name("anubis-cache-upload".into())
+            .spawn(move || upload_loop(upload_client, rx))?;
+
+        Ok(RemoteCache { client, uploads: tx })
+    }
+
+    /// Fetches an entry. Returns `Ok(None)` if the server doesn't have it or is unreachable.
+    pub fn get(&self, kind: RemoteKind, key: u64) -> anyhow::Result<Option<Vec<u8>>> {
+        self.client.get(kind, key)
+    }
+
+    /// Uploads an entry, blocking until the server responds.
+    pub fn put(&self, kind: RemoteKind, key: u64, body: &[u8]) -> anyhow::Result<()> {
+        self.client.put(kind, key, body)
+    }
+
+    /// Queues an upload of in-memory bytes.
+    pub fn upload_bytes(&self, kind: RemoteKind, key: u64, body: Vec<u8>) {
+        let _ = self.uploads.send(Upload::Bytes(kind, key, body));
+    }
+
+    /// Queues an upload of a file. The file is read on the upload thread, so it must not change.
+    pub fn upload_file(&self, kind: RemoteKind, key: u64, path: Utf8PathBuf) {
+        let _ = self.uploads.send(Upload::File(kind, key, path));
+    }
+
+    /// Blocks until every queued upload has been attempted.
+    pub fn flush(&self) {
+        let (tx, rx) = crossbeam::channel::bounded(1);
+        if self.uploads.send(Upload::Flush(tx)).is_ok() {
+            let _ = rx.recv();
+        }
+    }
+}
+
+impl HttpClient {
+    fn get(&self, kind: RemoteKind, key: u64) -> anyhow::Result<Option<Vec<u8>>> {
+        if self.disabled.load(Ordering::Relaxed) {
+            return Ok(None);
+        }
+        let url = self.url(kind, key);
+        let response = match self.agent.get(&url).call() {
+            Ok(response) => response,
+            Err(e) => return self.disable(e).map(|_| None),
+        };
+        match response.status().as_u16() {
+            200 => {
+                let mut body = Vec::new();
+                response.into_body().into_reader().read_to_end(&mut body)?;
+                Ok(Some(body))
+            }
+            404 => Ok(None),
+            status => bail_loc!("Remote cache GET [{}] returned {}", url, status),
+        }
+    }
+
+    fn put(&self, kind: RemoteKind, key: u64, body: &[u8]) -> anyhow::Result<()> {
+        if self.disabled.load(Ordering::Relaxed) {
+            return Ok(());
+        }
+        let url = self.url(kind, key);
+        let response = match self.agent.put(&url).send(body) {
+            Ok(response) => response,
+            Err(e) => return self.disable(e),
+        };
+        let status = response.status().as_u16();
+        bail_loc_if!(!(200..300).contains(&status), "Remote cache PUT [{}] returned {}", url, status);
+        Ok(())
+    }
+
+    /// Stops talking to a server that failed at the transport level.
+    fn disable(&self, e: ureq::Error) -> anyhow::Result<()> {
+        if !self.disabled.swap(true, Ordering::Relaxed) {
+            tracing::warn!("Remote cache [{}] unreachable, disabling for this build: {}", self.base_url, e);
+        }
+        Ok(())
+    }
+
+    fn url(&self, kind: RemoteKind, key: u64) -> String {
+        format!("{}/{}/{:016x}", self.base_url, kind.as_str(), key)
+    }
+}
+
+impl CacheServer {
+    /// Binds to `addr` (e.g. `127.0.0.1:9092`, or port 0 for any free port) and serves `dir`.
+    pub fn bind(dir: Utf8PathBuf, addr: &str) -> anyhow::Result<CacheServer> {
+        for kind in [RemoteKind::ActionCache, RemoteKind::Cas] {
+            std::fs::create_dir_all(dir.join(kind.as_str()))
+                .with_context(|| anyhow_loc!("Failed to create [{}]", dir.join(kind.as_str())))?;
+        }
+        let listener = TcpListener::bind(addr).with_context(|| anyhow_loc!("Failed to bind [{}]", addr))?;
+        Ok(CacheServer { dir, listener })
+    }
+
+    pub fn local_addr(&self) -> anyhow::Result<std::net::SocketAddr> {
+        Ok(self.listener.local_addr()?)
+    }
+
+    /// Serves requests until the process exits. Each connection gets its own thread.
+    pub fn run(self) -> anyhow::Result<()> {
+        for stream in self.listener.incoming() {
+            let stream = match stream {
+                Ok(stream) => stream,
+                Err(e) => {
+                    tracing::warn!("Failed to accept connection: {}", e);
+                    continue;
+                }
+            };
+            let dir = self.dir.clone();
+            std::thread::spawn(move || {
+                if let Err(e) = serve_connection(&dir, stream) {
+                    tracing::debug!("Cache server connection failed: {}", e);
+                }
+            });
+        }
+        Ok(())
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Private functions
+// ----------------------------------------------------------------------------
+
+/// Drains the upload queue. Failures are logged and dropped; a missed upload is only a missed hit.
+fn upload_loop(client: HttpClient, rx: Receiver<Upload>) {
+    while let Ok(upload) = rx.recv() {
+        let result = match upload {
+            Upload::Bytes(kind, key, body) => client.put(kind, key, &body),
+            Upload::File(kind, key, path) => std::fs::read(&path)
+                .with_context(|| anyhow_loc!("Failed to read [{}] for upload", path))
+                .and_then(|body| client.put(kind, key, &body)),
+            Upload::Flush(done) => {
+                let _ = done.send(());
+                Ok(())
+            }
+        };
+        if let Err(e) = result {
+            tracing::debug!("Remote cache upload failed: {}", e);
+        }
+    }
+}
+
+/// Reads headers up to the blank line and returns the Content-Length, if any.
+fn read_headers(reader: &mut impl BufRead) -> anyhow::Result<Option<usize>> {
+    let mut content_length = None;
+    loop {
+        let mut line = String::new();
+        bail_loc_if!(reader.read_line(&mut line)? == 0, "Unexpected end of HTTP headers");
+        let line = line.trim_end();
+        if line.is_empty() {
+            return Ok(content_length);
+        }
+        if let Some((name, value)) = line.split_once(':') {
+            if name.trim().eq_ignore_ascii_case("content-length") {
+                content_length = Some(value.trim().parse()?);
+            }
+        }
+    }
+}
+
+fn serve_connection(dir: &Utf8Path, stream: TcpStream) -> anyhow::Result<()> {
+    stream.set_read_timeout(Some(IO_TIMEOUT))?;
+    let mut reader = BufReader::new(stream.try_clone()?);
+    let mut request_line = String::new();
+    reader.read_line(&mut request_line)?;
+    let mut parts = request_line.split_whitespace();
+    let method = parts.next().unwrap_or_default().to_owned();
+    let path = parts.next().unwrap_or_default().to_owned();
+    let content_length = read_headers(&mut reader)?.unwrap_or(0);
+
+    let (status, body) = match (method.as_str(), entry_path(dir, &path)) {
+        (_, None) => (400, Vec::new()),
+        ("GET", Some(file)) => match std::fs::read(&file) {
+            Ok(bytes) => (200, bytes),
+            Err(_) => (404, Vec::new()),
+        },
+        ("HEAD", Some(file)) => (if file.exists() { 200 } else { 404 }, Vec::new()),
+        ("PUT", Some(file)) => {
+            let mut body = vec![0; content_length];
+            reader.read_exact(&mut body)?;
+            // Concurrent PUTs of the same key carry identical bytes, so last rename wins
+            static COUNTER: AtomicU64 = AtomicU64::new(0);
+            let temp = format!("{}.{}.tmp", file, COUNTER.fetch_add(1, Ordering::Relaxed));
+            std::fs::write(&temp, &body)?;
+            std::fs::rename(&temp, &file)?;
+            (200, Vec::new())
+        }
+        _ => (405, Vec::new()),
+    };
+
+    let reason = match status {
+        200 => "OK",
+        400 => "Bad Request",
+        404 => "Not Found",
+        _ => "Method Not Allowed",
+    };
+    let mut stream = stream;
+    let content_length = if method == "HEAD" { 0 } else { body.len() };
+    write!(
+        stream,
+        "HTTP/1.1 {} {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+        status, reason, content_length
+    )?;
+    if method != "HEAD" {
+        stream.write_all(&body)?;
+    }
+    stream.flush()?;
+    Ok(())
+}
+
+/// Maps a request path ending in `/ac/{hex}` or `/cas/{hex}` to a file in `dir`.
+/// Any instance prefix before the namespace is ignored. Other paths are rejected.
+fn entry_path(dir: &Utf8Path, path: &str) -> Option<Utf8PathBuf> {
+    let mut segments = path.rsplit('/');
+    let key = segments.next()?;
+    let kind = segments.next()?;
+    if key.is_empty() || !key.chars().all(|c| c.is_ascii_hexdigit()) {
+        return None;
+    }
+    match kind {
+        "ac" | "cas" => Some(dir.join(kind).join(key)),
+        _ => None,
+    }
+}
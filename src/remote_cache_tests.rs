@@ -0,0 +1,80 @@
+//! Tests for remote_cache.rs
+
+use camino::Utf8PathBuf;
+
+use crate::action_cache::ActionCache;
+use crate::remote_cache::*;
+use crate::{assert_err, assert_ok};
+use crate::test_utils::scratch_dir;
+
+/// Starts a cache server on a free localhost port and returns its url.
+fn start_server(dir: Utf8PathBuf) -> String {
+    let server = CacheServer::bind(dir, "127.0.0.1:0").unwrap();
+    let url = format!("http://{}", server.local_addr().unwrap());
+    std::thread::spawn(move || server.run());
+    url
+}
+
+#[test]
+fn remote_cache_get_put_roundtrip() {
+    let dir = scratch_dir("remote_cache_tests", "roundtrip");
+    let remote = RemoteCache::new(&start_server(dir.join("server"))).unwrap();
+
+    assert_eq!(remote.get(RemoteKind::Cas, 0xabc).unwrap(), None);
+    assert_ok!(remote.put(RemoteKind::Cas, 0xabc, b"blob bytes"));
+    assert_eq!(remote.get(RemoteKind::Cas, 0xabc).unwrap().as_deref(), Some(&b"blob bytes"[..]));
+
+    // Namespaces are separate, and entries land in the bazel-remote layout on disk
+    assert_eq!(remote.get(RemoteKind::ActionCache, 0xabc).unwrap(), None);
+    assert!(dir.join("server/cas/0000000000000abc").exists());
+
+    // Queued uploads are visible after a flush
+    remote.upload_bytes(RemoteKind::ActionCache, 7, b"manifest".to_vec());
+    remote.flush();
+    assert_eq!(remote.get(RemoteKind::ActionCache, 7).unwrap().as_deref(), Some(&b"manifest"[..]));
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
+
+#[test]
+fn remote_cache_url_validation_and_unreachable_server() {
+    assert_err!(RemoteCache::new("ftp://cache.local"));
+    assert_err!(RemoteCache::new("cache.local:9092"));
+
+    // Nothing listens on a port we just released; lookups degrade to misses
+    let port = std::net::TcpListener::bind("127.0.0.1:0").unwrap().local_addr().unwrap().port();
+    let remote = RemoteCache::new(&format!("http://127.0.0.1:{}/instance", port)).unwrap();
+    assert_eq!(remote.get(RemoteKind::Cas, 1).unwrap(), None);
+    assert_ok!(remote.put(RemoteKind::Cas, 1, b"ignored"));
+}
+
+#[test]
+fn action_cache_falls_back_to_remote() {
+    let dir = scratch_dir("remote_cache_tests", "action_cache");
+    let url = start_server(dir.join("server"));
+    let src = dir.join("foo.cpp");
+    std::fs::write(&src, "int foo() { return 1; }").unwrap();
+
+    // Machine A builds and uploads
+    let obj_a = dir.join("a/foo.obj");
+    std::fs::create_dir_all(obj_a.parent().unwrap()).unwrap();
+    std::fs::write(&obj_a, "object bytes").unwrap();
+    let mut cache_a = ActionCache::new(dir.join("cache_a"));
+    cache_a.set_remote(RemoteCache::new(&url).unwrap());
+    assert_ok!(cache_a.store(42, &[src.clone()], &[&obj_a]));
+    cache_a.flush_uploads();
+
+    // Machine B has an empty local store and restores from the remote
+    let obj_b = dir.join("b/foo.obj");
+    let mut cache_b = ActionCache::new(dir.join("cache_b"));
+    cache_b.set_remote(RemoteCache::new(&url).unwrap());
+    let inputs = cache_b.lookup(42, &[&obj_b]).unwrap().unwrap();
+    assert_eq!(inputs[0].path, src);
+    assert_eq!(std::fs::read_to_string(&obj_b).unwrap(), "object bytes");
+
+    // The download was kept locally
+    let local_only = ActionCache::new(dir.join("cache_b"));
+    assert!(local_only.lookup(42, &[&obj_b]).unwrap().is_some());
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
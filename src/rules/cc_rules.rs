@@ -3,8 +3,11 @@
 #![allow(unused_imports)]
 #![allow(unused_mut)]
 
+use crate::action_cache::{self, ActionCache, ActionInput};
 use crate::anubis::{self, AnubisTarget, JobCacheKey, RuleExt};
-use crate::rules::rule_utils::{ensure_directory, ensure_directory_for_file, run_command_verbose};
+use crate::rules::rule_utils::{
+    ensure_directory, ensure_directory_for_file, run_command_verbose, spawn_command, tool_output,
+};
 use crate::util::{self, SlashFix};
 use crate::{anubis::RuleTypename, Anubis, Rule, RuleTypeInfo};
 use crate::{job_system::*, toolchain};
@@ -80,6 +83,8 @@ pub struct CcBinary {
     #[serde(default)] pub libraries: Vec<Utf8PathBuf>,
     #[serde(default)] pub library_dirs: Vec<Utf8PathBuf>,
     #[serde(default)] pub exe_name: Option<String>,
+    /// Peak memory of the link (e.g. "12G"), overriding the scheduler's default estimate
+    #[serde(default)] pub link_memory: Option<String>,
 
     #[serde(skip_deserializing)]
     target: anubis::AnubisTarget,
@@ -133,6 +138,9 @@ pub struct CcBuildOutput {
 
     /// Transitive library dependencies (accumulated from deps)
     pub transitive_libraries: Vec<Utf8PathBuf>,
+
+    /// Hash of the file this step produced (the object for compile steps, the library for archive steps)
+    pub output_hash: Option<u64>,
 }
 
 // ----------------------------------------------------------------------------
@@ -158,6 +166,9 @@ struct CcExtraArgs {
 #[derive(Debug)]
 pub struct CompileExeArtifact {
     pub output_file: Utf8PathBuf,
+
+    /// Hash of the linked executable
+    pub output_hash: Option<u64>,
 }
 
 // ----------------------------------------------------------------------------
@@ -184,6 +195,20 @@ trait CcContextExt<'a> {
 // ----------------------------------------------------------------------------
 // Struct Implementations
 // ----------------------------------------------------------------------------
+impl CcBuildOutput {
+    /// Records this step's output hash against the file it describes, if both are known.
+    fn collect_output_hash(&self, known_hashes: &mut HashMap<Utf8PathBuf, u64>) {
+        let output_file = match (&self.library, self.object_files.as_slice()) {
+            (Some(library), _) => library,
+            (None, [object_file]) => object_file,
+            _ => return,
+        };
+        if let Some(hash) = self.output_hash {
+            known_hashes.insert(output_file.clone(), hash);
+        }
+    }
+}
+
 impl CcExtraArgs {
     fn extend_static_public(&mut self, other: &CcStaticLibrary) {
         self.compiler_flags.extend(other.public_compiler_flags.iter().cloned());
@@ -405,7 +430,7 @@ fn build_cc_binary(binary: Arc<CcBinary>, job: Job) -> anyhow::Result<JobOutcome
     // Create a blocker job that waits for all dependencies to complete.
     // This ensures any generated source files exist before compilation starts.
     let deps_blocker_id = if !child_jobs.is_empty() {
-        let blocker = job.ctx.new_job(
+        let blocker = job.ctx.new_inline_job(
             format!("{} (await deps)", job.desc),
             JobDisplayInfo { verb: "Awaiting", short_name: "deps".to_string(), detail: job.display.detail.clone() },
             Box::new(|_| Ok(JobOutcome::Success(Arc::new(DepsCompleteMarker)))),
@@ -464,7 +489,10 @@ fn build_cc_binary(binary: Arc<CcBinary>, job: Job) -> anyhow::Result<JobOutcome
         short_name: binary.name.clone(),
         detail: binary.target.target_path().to_string(),
     };
-    let continuation_job = job.ctx.new_job(format!("{} (link)", job.desc), link_display, Box::new(link_job));
+    let mut continuation_job = job.ctx.new_job(format!("{} (link)", job.desc), link_display, Box::new(link_job));
+    if let Some(link_memory) = &binary.link_memory {
+        continuation_job.memory = util::parse_byte_size(link_memory)?;
+    }
 
     // Defer!
     Ok(JobOutcome::Deferred(JobDeferral {
@@ -510,7 +538,7 @@ fn build_cc_static_library(static_library: Arc<CcStaticLibrary>, job: Job) -> an
     // Create a blocker job that waits for all dependencies to complete.
     // This ensures any generated source files exist before compilation starts.
     let deps_blocker_id = if !child_jobs.is_empty() {
-        let blocker = job.ctx.new_job(
+        let blocker = job.ctx.new_inline_job(
             format!("{} (await deps)", job.desc),
             JobDisplayInfo { verb: "Awaiting", short_name: "deps".to_string(), detail: job.display.detail.clone() },
             Box::new(|_| Ok(JobOutcome::Success(Arc::new(DepsCompleteMarker)))),
@@ -617,10 +645,17 @@ fn build_cc_file(
     // Create a new job that builds the file
     let ctx2 = ctx.clone();
     let src_abspath2 = src_abspath.clone();
-    let job_fn = move |job| -> anyhow::Result<JobOutcome> {
+    let job_fn = move |job: Job| -> anyhow::Result<JobOutcome> {
         // Get initial args args
         let mut args = ctx2.get_args(lang)?;
 
+        // Strip the checkout location from debug info and __FILE__
+        let anubis_root = &ctx2.anubis.root;
+        if !ctx2.get_cc_toolchain(lang)?.absolute_debug_paths {
+            args.push(format!("-ffile-prefix-map={}=.", anubis_root));
+            args.push("-fdebug-compilation-dir=.".into());
+        }
+
         // Add extra args
         args.push("-c".into()); // compile object file, do not link
 
@@ -658,43 +693,96 @@ fn build_cc_file(
         // Specify file to compile
         args.push(src_abspath2.to_string());
 
-        // Run the command
         let compiler = ctx2.get_compiler(lang)?;
-        let verbose = ctx2.anubis.verbose_tools;
-        let (output, compile_duration) = {
-            let _span = tracing::info_span!("compile", file = %src_filename).entered();
-            let compile_start = std::time::Instant::now();
-            let output = run_command_verbose(compiler.as_ref(), &args, verbose)?;
-            (output, compile_start.elapsed())
+        let journal = &ctx2.anubis.build_journal;
+
+        // Stat-only check against the build journal. Nothing is read or hashed on a no-op build.
+        let command_hash = util::quick_hash(&(compiler, &args));
+        if journal.is_up_to_date(&output_file, command_hash) {
+            tracing::trace!(source_file = %src_filename, "Up to date");
+            let output_hash = journal.output_hash(&output_file);
+            return compiled_object(output_file, output_hash);
+        }
+
+        // Check the action cache before spawning the compiler
+        let action_cache = &ctx2.anubis.action_cache;
+        let action_key = match compile_action_key(action_cache, compiler, &args, &src_abspath2, anubis_root) {
+            Ok(key) => Some(key),
+            Err(e) => {
+                tracing::debug!("No action cache key for [{}]: {}", src_filename, e);
+                None
+            }
         };
+        if let Some(action_key) = action_key {
+            match action_cache.lookup(action_key, &[&output_file]) {
+                Ok(Some(inputs)) => {
+                    tracing::debug!(source_file = %src_filename, "Action cache hit");
+                    action_cache::write_dep_file(&dep_file, &output_file, &inputs)?;
+                    let output_hash = record_tool_output(&ctx2.anubis, &output_file, command_hash, compiler, inputs);
+                    return compiled_object(output_file, output_hash);
+                }
+                Ok(None) => (),
+                Err(e) => tracing::warn!("Action cache lookup failed for [{}]: {}", src_filename, e),
+            }
+        }
+
+        // Start the compiler and free this worker until it exits
+        action_cache::unlink_outputs(&[&output_file, &dep_file])?;
+        let compiler_job = spawn_command(&job.ctx, compiler.as_ref(), &args)?;
+
+        // The continuation checks and records what the compiler produced
+        let finish_compile = move |finish_job: Job| -> anyhow::Result<JobOutcome> {
+            let ctx = finish_job.ctx;
+            let exit = tool_output(&ctx, compiler_job, ctx.anubis.verbose_tools)?;
+            let output = &exit.output;
+            if !output.status.success() {
+                tracing::error!(
+                    source_file = %src_filename,
+                    exit_code = output.status.code(),
+                    compile_time_ms = exit.duration.as_millis(),
+                    stdout = %String::from_utf8_lossy(&output.stdout),
+                    stderr = %String::from_utf8_lossy(&output.stderr),
+                    "Compilation failed"
+                );
+
+                bail_loc!(
+                    "Command completed with error status [{}].\n  Args: {}\n  stdout: {}\n  stderr: {}",
+                    output.status,
+                    args.join(" "),
+                    String::from_utf8_lossy(&output.stdout),
+                    String::from_utf8_lossy(&output.stderr)
+                )
+            }
 
-        if output.status.success() {
             // Validate hermetic dependencies
-            validate_hermetic_deps(dep_file.as_std_path(), ctx2.anubis.root.as_std_path())?;
+            validate_hermetic_deps(dep_file.as_std_path(), ctx.anubis.root.as_std_path())?;
+
+            // Record the result so the next build can skip this compile
+            let mut output_hash = None;
+            if let Some(action_key) = action_key {
+                let stored = action_cache::parse_dep_file(&dep_file)
+                    .and_then(|inputs| ctx.anubis.action_cache.store(action_key, &inputs, &[&output_file]));
+                match stored {
+                    Ok(inputs) => {
+                        let compiler = ctx.get_compiler(lang)?;
+                        output_hash =
+                            record_tool_output(&ctx.anubis, &output_file, command_hash, compiler, inputs)
+                    }
+                    Err(e) => tracing::warn!("Failed to store [{}] in action cache: {}", src_filename, e),
+                }
+            }
 
-            Ok(JobOutcome::Success(Arc::new(CcBuildOutput {
-                object_files: vec![output_file],
-                library: None,
-                transitive_libraries: Vec::new(),
-            })))
-        } else {
-            tracing::error!(
-                source_file = %src_filename,
-                exit_code = output.status.code(),
-                compile_time_ms = compile_duration.as_millis(),
-                stdout = %String::from_utf8_lossy(&output.stdout),
-                stderr = %String::from_utf8_lossy(&output.stderr),
-                "Compilation failed"
-            );
-
-            bail_loc!(
-                "Command completed with error status [{}].\n  Args: {}\n  stdout: {}\n  stderr: {}",
-                output.status,
-                args.join(" "),
-                String::from_utf8_lossy(&output.stdout),
-                String::from_utf8_lossy(&output.stderr)
-            )
-        }
+            compiled_object(output_file, output_hash)
+        };
+
+        // The compile's memory reservation went to the compiler, so the continuation needs none
+        let mut continuation_job =
+            job.ctx.new_job(format!("{} (finish)", job.desc), job.display.clone(), Box::new(finish_compile));
+        continuation_job.memory = 0;
+        Ok(JobOutcome::Deferred(JobDeferral {
+            blocked_by: vec![compiler_job],
+            continuation_job,
+        }))
     };
 
     let filename = src_abspath.file_name().unwrap_or(src_abspath.as_str()).to_string();
@@ -721,10 +809,12 @@ fn archive_static_library(
     // Collect object files and transitive libraries from all child jobs
     let mut object_files: Vec<Utf8PathBuf> = Default::default();
     let mut transitive_libraries: IndexSet<Utf8PathBuf> = Default::default();
+    let mut known_hashes: HashMap<Utf8PathBuf, u64> = Default::default();
 
     for job_id in child_jobs {
         let job_result = ctx.job_system.get_result(*job_id)?;
         if let Ok(r) = job_result.cast::<CcBuildOutput>() {
+            r.collect_output_hash(&mut known_hashes);
             // Collect object files
             object_files.extend(r.object_files.iter().cloned());
             // Collect this dep's library
@@ -763,13 +853,43 @@ fn archive_static_library(
     ensure_directory(build_dir.as_ref())?;
 
     let output_file = build_dir.join(name).with_extension("lib").slash_fix();
+    args.push(output_file.to_string());
 
-    // Delete existing archive to ensure clean build (llvm-ar updates in place)
-    if output_file.exists() {
-        std::fs::remove_file(&output_file)?;
+    let journal = &ctx.anubis.build_journal;
+    let previous_hash = journal.output_hash(&output_file);
+    let build_output = |output_hash: Option<u64>| CcBuildOutput {
+        object_files: Vec::new(), // Archive doesn't expose object files
+        library: Some(output_file.clone()),
+        transitive_libraries: transitive_libraries.iter().cloned().collect(),
+        output_hash,
+    };
+
+    // Keep the existing archive if it was built from identical objects by the same command.
+    // Objects that were recompiled to identical bytes are verified with the hashes their jobs reported.
+    let archiver = ctx.get_archiver(lang)?;
+    let command_hash = util::quick_hash(&(archiver, &args, &object_files));
+    if journal.is_up_to_date_with(&output_file, command_hash, |p| known_hashes.get(p).copied()) {
+        tracing::debug!(target = %target.target_path(), "Archive up to date");
+        return Ok(JobOutcome::Success(Arc::new(build_output(previous_hash))));
     }
 
-    args.push(output_file.to_string());
+    // Another mode or worktree may have already archived identical objects
+    let key_args: Vec<String> = args.iter().cloned().chain(object_files.iter().map(|p| p.to_string())).collect();
+    let action = tool_action(&ctx.anubis, archiver, &key_args, object_files.iter(), &known_hashes);
+    if let Some((action_key, inputs)) = &action {
+        match ctx.anubis.action_cache.lookup(*action_key, &[&output_file]) {
+            Ok(Some(_)) => {
+                tracing::debug!(target = %target.target_path(), "Archive action cache hit");
+                let output_hash = record_tool_output(&ctx.anubis, &output_file, command_hash, archiver, inputs.clone());
+                return Ok(JobOutcome::Success(Arc::new(build_output(output_hash))));
+            }
+            Ok(None) => (),
+            Err(e) => tracing::warn!("Action cache lookup failed for [{}]: {}", output_file, e),
+        }
+    }
+
+    // Delete existing archive to ensure clean build (llvm-ar updates in place)
+    action_cache::unlink_outputs(&[&output_file])?;
 
     // put link args in a response file
     let response_filepath = build_dir.join(name).with_extension("rsp").slash_fix();
@@ -784,7 +904,6 @@ fn archive_static_library(
     args.push(format!("@{}", response_filepath));
 
     // run the command
-    let archiver = ctx.get_archiver(lang)?;
     let verbose = ctx.anubis.verbose_tools;
     let output = {
         let _span = tracing::info_span!("archive", target = %name).entered();
@@ -792,12 +911,15 @@ fn archive_static_library(
     };
 
     if output.status.success() {
+        let output_hash = action.and_then(|(action_key, inputs)| {
+            if let Err(e) = ctx.anubis.action_cache.store(action_key, &[], &[&output_file]) {
+                tracing::warn!("Failed to store [{}] in action cache: {}", output_file, e);
+            }
+            record_tool_output(&ctx.anubis, &output_file, command_hash, archiver, inputs)
+        });
+
         // Return CcBuildOutput with this library and accumulated transitive deps
-        Ok(JobOutcome::Success(Arc::new(CcBuildOutput {
-            object_files: Vec::new(), // Archive doesn't expose object files
-            library: Some(output_file),
-            transitive_libraries: transitive_libraries.into_iter().collect(),
-        })))
+        Ok(JobOutcome::Success(Arc::new(build_output(output_hash))))
     } else {
         tracing::error!(
             target = %target.target_path(),
@@ -829,10 +951,12 @@ fn link_exe(
     // Collect object files and libraries from all child jobs
     let mut object_files: Vec<Utf8PathBuf> = Default::default();
     let mut library_files: IndexSet<Utf8PathBuf> = Default::default();
+    let mut known_hashes: HashMap<Utf8PathBuf, u64> = Default::default();
 
     for job_id in child_jobs {
         let job_result = ctx.job_system.get_result(*job_id)?;
         if let Ok(r) = job_result.cast::<CcBuildOutput>() {
+            r.collect_output_hash(&mut known_hashes);
             // Collect object files
             object_files.extend(r.object_files.iter().cloned());
             // Collect this dep's library
@@ -948,8 +1072,69 @@ fn link_exe(
         args.push(output_file.to_string());
     }
 
-    // run the command
+    // Libraries passed by name are inputs too. One the linker finds somewhere we can't see can
+    // change without us noticing, so such a link is neither journaled nor cached.
+    let library_dirs: Vec<&Utf8Path> =
+        cc_toolchain.library_dirs.iter().chain(&extra_args.library_dirs).map(|d| d.as_path()).collect();
+    let mut named_libraries: Vec<Utf8PathBuf> = Default::default();
+    let mut unresolved_libraries: Vec<&Utf8Path> = Default::default();
+    for lib in cc_toolchain.libraries.iter().chain(&extra_args.libraries) {
+        match resolve_library(lib.as_str(), &library_dirs, is_msvc_linker) {
+            Some(path) => named_libraries.push(path),
+            None => unresolved_libraries.push(lib),
+        }
+    }
+    let trackable = unresolved_libraries.is_empty();
+    if !trackable {
+        tracing::debug!(
+            target = %target.target_path(),
+            "Link always runs, libraries not found in library dirs: {:?}",
+            unresolved_libraries
+        );
+    }
+
+    // Skip the link if every object and library is unchanged and the command is the same
     let linker = ctx.get_linker(lang)?;
+    let journal = &ctx.anubis.build_journal;
+    let previous_hash = journal.output_hash(&output_file);
+    let command_hash = util::quick_hash(&(linker, &args));
+    if trackable && journal.is_up_to_date_with(&output_file, command_hash, |p| known_hashes.get(p).copied()) {
+        tracing::debug!(target = %target.target_path(), "Link up to date");
+        return Ok(JobOutcome::Success(Arc::new(CompileExeArtifact {
+            output_file,
+            output_hash: previous_hash,
+        })));
+    }
+
+    let action = trackable
+        .then(|| {
+            tool_action(
+                &ctx.anubis,
+                linker,
+                &args,
+                object_files.iter().chain(library_files.iter()).chain(named_libraries.iter()),
+                &known_hashes,
+            )
+        })
+        .flatten();
+    if let Some((action_key, inputs)) = &action {
+        match ctx.anubis.action_cache.lookup(*action_key, &[&output_file]) {
+            Ok(Some(_)) => {
+                tracing::debug!(target = %target.target_path(), "Link action cache hit");
+                let output_hash =
+                    record_tool_output(&ctx.anubis, &output_file, command_hash, linker, inputs.clone());
+                return Ok(JobOutcome::Success(Arc::new(CompileExeArtifact {
+                    output_file,
+                    output_hash,
+                })));
+            }
+            Ok(None) => (),
+            Err(e) => tracing::warn!("Action cache lookup failed for [{}]: {}", output_file, e),
+        }
+    }
+
+    // run the command
+    action_cache::unlink_outputs(&[&output_file])?;
     let verbose = ctx.anubis.verbose_tools;
     let (output, link_duration) = {
         let _span = tracing::info_span!("link", target = %name).entered();
@@ -959,7 +1144,17 @@ fn link_exe(
     };
 
     if output.status.success() {
-        Ok(JobOutcome::Success(Arc::new(CompileExeArtifact { output_file })))
+        let output_hash = action.and_then(|(action_key, inputs)| {
+            if let Err(e) = ctx.anubis.action_cache.store(action_key, &[], &[&output_file]) {
+                tracing::warn!("Failed to store [{}] in action cache: {}", output_file, e);
+            }
+            record_tool_output(&ctx.anubis, &output_file, command_hash, linker, inputs)
+        });
+
+        Ok(JobOutcome::Success(Arc::new(CompileExeArtifact {
+            output_file,
+            output_hash,
+        })))
     } else {
         tracing::error!(
             target = %target.target_path(),
@@ -1031,6 +1226,117 @@ fn validate_hermetic_deps(dep_file: &Path, anubis_root: &Path) -> anyhow::Result
     Ok(())
 }
 
+/// Computes the action cache key for compiling a single source file.
+/// Covers the compiler binary, the root-relative argument vector, and the source contents.
+/// Headers are tracked by the action cache manifest via the `.d` file.
+fn compile_action_key(
+    action_cache: &ActionCache,
+    compiler: &Utf8Path,
+    args: &[String],
+    src: &Utf8Path,
+    root: &Utf8Path,
+) -> anyhow::Result<u64> {
+    let compiler_hash = action_cache.tool_hash(compiler)?;
+    let src_hash = action_cache::hash_file(src)?;
+    Ok(util::quick_hash(&(compiler_hash, root_relative_args(args, root), src_hash)))
+}
+
+/// Rewrites absolute paths under `root` to `./...` so action keys match across checkouts.
+fn root_relative_args(args: &[String], root: &Utf8Path) -> Vec<String> {
+    args.iter().map(|arg| util::root_relative(arg, root)).collect()
+}
+
+/// Records a finished tool invocation in the build journal and returns the output's hash.
+/// The tool binary is journaled alongside the inputs so a toolchain update forces a rebuild.
+fn record_tool_output(
+    anubis: &Anubis,
+    output_file: &Utf8Path,
+    command_hash: u64,
+    tool: &Utf8Path,
+    mut inputs: Vec<ActionInput>,
+) -> Option<u64> {
+    let tool_hash = anubis.action_cache.tool_hash(tool).ok()?;
+    inputs.push(ActionInput {
+        path: tool.to_owned(),
+        hash: tool_hash,
+    });
+    anubis.build_journal.record(output_file, command_hash, &inputs)
+}
+
+/// Hashes the object files and libraries consumed by a link or archive step for the build journal.
+/// Files whose hash was already reported by a child job are not read again.
+fn hash_link_inputs<'a>(
+    paths: impl Iterator<Item = &'a Utf8PathBuf>,
+    known_hashes: &HashMap<Utf8PathBuf, u64>,
+) -> anyhow::Result<Vec<ActionInput>> {
+    paths
+        .map(|path| {
+            let hash = match known_hashes.get(path) {
+                Some(hash) => *hash,
+                None => action_cache::hash_file(path)?,
+            };
+            Ok(ActionInput { path: path.clone(), hash })
+        })
+        .collect()
+}
+
+/// Result of a compile step that produced (or kept) `output_file`.
+fn compiled_object(output_file: Utf8PathBuf, output_hash: Option<u64>) -> anyhow::Result<JobOutcome> {
+    Ok(JobOutcome::Success(Arc::new(CcBuildOutput {
+        object_files: vec![output_file],
+        library: None,
+        transitive_libraries: Vec::new(),
+        output_hash,
+    })))
+}
+
+/// Finds the file a library named in `libraries` resolves to, searching `library_dirs` in order
+/// the way the linker does. GNU-style names try `lib{name}.so` then `lib{name}.a`, and `:file`
+/// names an exact file. MSVC names are file names with an optional `.lib` extension.
+fn resolve_library(name: &str, library_dirs: &[&Utf8Path], is_msvc_linker: bool) -> Option<Utf8PathBuf> {
+    let candidates: Vec<String> = if is_msvc_linker {
+        if name.to_lowercase().ends_with(".lib") {
+            vec![name.to_owned()]
+        } else {
+            vec![format!("{}.lib", name)]
+        }
+    } else if let Some(file_name) = name.strip_prefix(':') {
+        vec![file_name.to_owned()]
+    } else {
+        vec![format!("lib{}.so", name), format!("lib{}.a", name)]
+    };
+
+    library_dirs.iter().find_map(|dir| {
+        candidates.iter().map(|candidate| dir.join(candidate)).find(|path| path.is_file())
+    })
+}
+
+/// Hashes the inputs of an archive or link step and derives its action cache key.
+/// The key covers the tool's contents, the root-relative arguments, and the contents of every
+/// object and library. Returns `None` if anything can't be hashed, in which case the step
+/// always runs and is not journaled.
+fn tool_action<'a>(
+    anubis: &Anubis,
+    tool: &Utf8Path,
+    key_args: &[String],
+    paths: impl Iterator<Item = &'a Utf8PathBuf>,
+    known_hashes: &HashMap<Utf8PathBuf, u64>,
+) -> Option<(u64, Vec<ActionInput>)> {
+    let keyed = hash_link_inputs(paths, known_hashes).and_then(|inputs| {
+        let tool_hash = anubis.action_cache.tool_hash(tool)?;
+        let input_hashes: Vec<u64> = inputs.iter().map(|input| input.hash).collect();
+        let key_args = root_relative_args(key_args, &anubis.root);
+        Ok((util::quick_hash(&(tool_hash, key_args, input_hashes)), inputs))
+    });
+    match keyed {
+        Ok(keyed) => Some(keyed),
+        Err(e) => {
+            tracing::warn!("Failed to hash inputs for [{}]: {}", tool, e);
+            None
+        }
+    }
+}
+
 /// Normalize a path for comparison: forward slashes, lowercase on Windows.
 fn normalize_path_for_comparison(path: &Path) -> String {
     let s = path.to_string_lossy().to_string().slash_fix();
@@ -213,6 +213,7 @@ fn spawn_command_jobs(cmd: Arc<AnubisCmd>, tool_job_id: JobId, mut job: Job) ->
         detail: cmd.target.target_path().to_string(),
     };
     job.job_fn = Some(Box::new(finalize_job));
+    job.inline = true;
 
     Ok(JobOutcome::Deferred(JobDeferral {
         blocked_by: child_job_ids,
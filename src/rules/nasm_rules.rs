@@ -158,7 +158,8 @@ fn build_nasm_objects(nasm: Arc<NasmObjects>, job: Job) -> anyhow::Result<JobOut
         short_name: job.display.short_name.clone(),
         detail: job.display.detail.clone(),
     };
-    let continuation_job = job.ctx.new_job(format!("{} (aggregate)", job.desc), agg_display, Box::new(aggregate_job));
+    let continuation_job =
+        job.ctx.new_inline_job(format!("{} (aggregate)", job.desc), agg_display, Box::new(aggregate_job));
 
     Ok(JobOutcome::Deferred(JobDeferral {
         blocked_by: aggregate_job_ids,
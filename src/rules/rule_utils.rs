@@ -3,7 +3,11 @@
 use anyhow::Context;
 use std::path::Path;
 use std::process::Output;
+use std::sync::Arc;
 
+use crate::job_system::{self, JobContext, JobId};
+use crate::job_tokens;
+use crate::process_reactor::{self, ChildExit};
 use crate::{anyhow_loc, function_name};
 
 /// Ensures that the directory for a given file path exists, creating it if necessary.
@@ -23,7 +27,7 @@ pub fn ensure_directory(dir: &Path) -> anyhow::Result<()> {
 ///
 /// This function provides a standardized way to run subprocesses with:
 /// - Trace-level logging of the command being executed
-/// - Piped stdout/stderr for capture
+/// - Captured stdout/stderr
 /// - Consistent error handling
 ///
 /// # Arguments
@@ -40,8 +44,9 @@ pub fn run_command(exe: &Path, args: &[String]) -> anyhow::Result<Output> {
 ///
 /// This function provides a standardized way to run subprocesses with:
 /// - Trace-level logging of the command being executed
-/// - Piped stdout/stderr for capture
+/// - Captured stdout/stderr
 /// - Consistent error handling
+/// - Access to the build's make jobserver, so tools that support it share the worker budget
 /// - Optional info-level logging of stdout/stderr (when verbose_tools is true)
 ///
 /// # Arguments
@@ -57,25 +62,59 @@ pub fn run_command_verbose(exe: &Path, args: &[String], verbose_tools: bool) ->
 
     tracing::trace!("Executing command: {command_display}",);
 
-    let output = std::process::Command::new(exe)
-        .args(args)
-        .stdout(std::process::Stdio::piped())
-        .stderr(std::process::Stdio::piped())
-        .output()
+    let mut command = std::process::Command::new(exe);
+    command.args(args);
+    job_tokens::configure_command(&mut command);
+    let output = process_reactor::output(&mut command, job_system::current_job_system())
         .with_context(|| format!("Failed to execute command: {command_display}",))?;
 
-    // Log stdout/stderr at info level when verbose_tools is enabled
     if verbose_tools {
-        let stdout = String::from_utf8_lossy(&output.stdout);
-        let stderr = String::from_utf8_lossy(&output.stderr);
-
-        if !stdout.is_empty() {
-            tracing::info!(target: "command_output", "stdout:\n{}", stdout);
-        }
-        if !stderr.is_empty() {
-            tracing::info!(target: "command_output", "stderr:\n{}", stderr);
-        }
+        log_command_output(&output);
     }
 
     Ok(output)
 }
+
+/// Starts a command like `run_command_verbose` but returns without waiting for it, so the calling
+/// job's worker is free while the tool runs. Must be called from a running job.
+///
+/// # Returns
+/// The id of a job that finishes when the tool exits. Defer on it, then read the result with
+/// `tool_output`.
+pub fn spawn_command(ctx: &JobContext, exe: &Path, args: &[String]) -> anyhow::Result<JobId> {
+    let command_display = format!("{} {}", exe.display(), args.join(" "));
+    tracing::trace!("Spawning command: {command_display}",);
+
+    let mut command = std::process::Command::new(exe);
+    command.args(args);
+    job_tokens::configure_command(&mut command);
+    ctx.job_system
+        .spawn_tool(&mut command, exe.display().to_string())
+        .with_context(|| format!("Failed to execute command: {command_display}",))
+}
+
+/// Returns the exit of a tool started with `spawn_command` and counts its resource usage toward
+/// the calling job. Logs stdout/stderr at info level when `verbose_tools` is true.
+pub fn tool_output(ctx: &JobContext, tool_job: JobId, verbose_tools: bool) -> anyhow::Result<Arc<ChildExit>> {
+    let exit = ctx.job_system.expect_result::<ChildExit>(tool_job)?;
+    if let Some(usage) = exit.usage {
+        process_reactor::add_thread_usage(usage);
+    }
+    if verbose_tools {
+        log_command_output(&exit.output);
+    }
+    Ok(exit)
+}
+
+/// Logs a tool's stdout/stderr at info level.
+fn log_command_output(output: &Output) {
+    let stdout = String::from_utf8_lossy(&output.stdout);
+    let stderr = String::from_utf8_lossy(&output.stderr);
+
+    if !stdout.is_empty() {
+        tracing::info!(target: "command_output", "stdout:\n{}", stdout);
+    }
+    if !stderr.is_empty() {
+        tracing::info!(target: "command_output", "stderr:\n{}", stderr);
+    }
+}
@@ -179,6 +179,7 @@ fn build_zig_glibc(zig_glibc: Arc<ZigGlibc>, job: Job) -> anyhow::Result<JobOutc
             object_files: Vec::new(),
             library: None,
             transitive_libraries: link_args,
+            ..Default::default()
         })))
     } else {
         tracing::error!(
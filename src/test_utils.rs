@@ -15,3 +15,90 @@ macro_rules! assert_err {
         assert!($result.is_err(), "Expected Err, got Ok: {:#?}", $result);
     };
 }
+
+/// Creates a fresh, empty scratch directory for a single test. `prefix` names the test module. The
+/// pid, a per-process counter, and the time keep every directory unique, so neither concurrent
+/// test binaries nor repeated names can share one.
+pub fn scratch_dir(prefix: &str, name: &str) -> camino::Utf8PathBuf {
+    static NEXT: std::sync::atomic::AtomicU64 = std::sync::atomic::AtomicU64::new(0);
+    let unique = NEXT.fetch_add(1, std::sync::atomic::Ordering::Relaxed);
+    let since_epoch = std::time::SystemTime::now().duration_since(std::time::UNIX_EPOCH);
+    let nanos = since_epoch.unwrap_or_default().as_nanos();
+    let dir = camino::Utf8PathBuf::try_from(std::env::temp_dir())
+        .unwrap()
+        .join(format!("anubis_{}_{}_{}_{}_{}", prefix, name, std::process::id(), unique, nanos));
+    std::fs::create_dir_all(&dir).unwrap();
+    dir
+}
+
+/// Writes `contents` and backdates the mtime so a later write is guaranteed to change it.
+pub fn write_backdated(path: &camino::Utf8Path, contents: &str) {
+    std::fs::write(path, contents).unwrap();
+    let file = std::fs::File::options().write(true).open(path).unwrap();
+    file.set_modified(std::time::SystemTime::now() - std::time::Duration::from_secs(60)).unwrap();
+}
+
+/// The action input for `path` as it is on disk now.
+pub fn input(path: &camino::Utf8Path) -> crate::action_cache::ActionInput {
+    crate::action_cache::ActionInput {
+        path: path.to_owned(),
+        hash: crate::action_cache::hash_file(path).unwrap(),
+    }
+}
+
+/// Heap usage seen by `CountingAllocator`.
+#[cfg(feature = "count-allocations")]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct AllocationStats {
+    pub allocations: u64,
+    pub peak_bytes: usize,
+}
+
+/// Global allocator for tests that counts allocations and tracks peak live heap bytes. It adds
+/// atomics to every allocation in the test binary, so it's only installed with the
+/// `count-allocations` feature.
+#[cfg(feature = "count-allocations")]
+pub struct CountingAllocator;
+
+#[cfg(feature = "count-allocations")]
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+#[cfg(feature = "count-allocations")]
+static ALLOCATIONS: std::sync::atomic::AtomicU64 = std::sync::atomic::AtomicU64::new(0);
+#[cfg(feature = "count-allocations")]
+static LIVE_BYTES: std::sync::atomic::AtomicUsize = std::sync::atomic::AtomicUsize::new(0);
+#[cfg(feature = "count-allocations")]
+static PEAK_BYTES: std::sync::atomic::AtomicUsize = std::sync::atomic::AtomicUsize::new(0);
+
+#[cfg(feature = "count-allocations")]
+unsafe impl std::alloc::GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: std::alloc::Layout) -> *mut u8 {
+        use std::sync::atomic::Ordering::Relaxed;
+        ALLOCATIONS.fetch_add(1, Relaxed);
+        let live = LIVE_BYTES.fetch_add(layout.size(), Relaxed) + layout.size();
+        PEAK_BYTES.fetch_max(live, Relaxed);
+        std::alloc::System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: std::alloc::Layout) {
+        LIVE_BYTES.fetch_sub(layout.size(), std::sync::atomic::Ordering::Relaxed);
+        std::alloc::System.dealloc(ptr, layout)
+    }
+}
+
+/// Runs `f` and returns what it allocated. Peak bytes are measured above the heap in use when `f`
+/// starts. Only meaningful when no other test runs at the same time.
+#[cfg(feature = "count-allocations")]
+pub fn measure_allocations<T>(f: impl FnOnce() -> T) -> (T, AllocationStats) {
+    use std::sync::atomic::Ordering::Relaxed;
+    let start_allocations = ALLOCATIONS.load(Relaxed);
+    let start_live = LIVE_BYTES.load(Relaxed);
+    PEAK_BYTES.store(start_live, Relaxed);
+    let result = f();
+    let stats = AllocationStats {
+        allocations: ALLOCATIONS.load(Relaxed) - start_allocations,
+        peak_bytes: PEAK_BYTES.load(Relaxed).saturating_sub(start_live),
+    };
+    (result, stats)
+}
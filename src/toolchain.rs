@@ -55,6 +55,11 @@ pub struct CcToolchain {
     pub system_include_dirs: Vec<Utf8PathBuf>,
     pub defines: Vec<String>,
     pub exe_deps: Vec<AnubisTarget>,
+
+    /// Keep absolute checkout paths in debug info and `__FILE__`. By default compiles add
+    /// `-ffile-prefix-map={root}=.` and `-fdebug-compilation-dir=.` so objects are identical
+    /// in every checkout and can be shared through the action cache.
+    pub absolute_debug_paths: bool,
 }
 
 #[derive(Clone, Debug, Default, Deserialize)]
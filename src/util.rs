@@ -1,4 +1,5 @@
-use crate::{anyhow_loc, function_name};
+use crate::{anyhow_loc, bail_loc_if, function_name};
+use anyhow::Context;
 use camino::{Utf8Path, Utf8PathBuf};
 use std::hash::{Hash, Hasher};
 use std::path::{Path, PathBuf};
@@ -31,6 +32,47 @@ pub fn format_duration(duration: Duration) -> String {
     }
 }
 
+// ----------------------------------------------------------------------------
+// Byte Sizes
+// ----------------------------------------------------------------------------
+
+/// Parses a human-readable byte size such as "512", "300M", or "10G".
+/// Suffixes are binary (K = 1024) and case-insensitive; a trailing "B" is allowed.
+pub fn parse_byte_size(s: &str) -> anyhow::Result<u64> {
+    let upper = s.trim().to_ascii_uppercase();
+    let digits = upper.strip_suffix('B').unwrap_or(&upper);
+    let (number, shift) = match digits.chars().last() {
+        Some('K') => (&digits[..digits.len() - 1], 10),
+        Some('M') => (&digits[..digits.len() - 1], 20),
+        Some('G') => (&digits[..digits.len() - 1], 30),
+        Some('T') => (&digits[..digits.len() - 1], 40),
+        _ => (digits, 0),
+    };
+    let value: u64 = number
+        .trim()
+        .parse()
+        .map_err(|_| anyhow_loc!("Invalid byte size [{}]", s))?;
+    value
+        .checked_mul(1u64 << shift)
+        .ok_or_else(|| anyhow_loc!("Byte size [{}] is too large", s))
+}
+
+/// Formats a byte count with a binary unit (e.g., "1.5 GiB").
+pub fn format_bytes(bytes: u64) -> String {
+    const UNITS: [&str; 5] = ["B", "KiB", "MiB", "GiB", "TiB"];
+    let mut value = bytes as f64;
+    let mut unit = 0;
+    while value >= 1024.0 && unit < UNITS.len() - 1 {
+        value /= 1024.0;
+        unit += 1;
+    }
+    if unit == 0 {
+        format!("{} B", bytes)
+    } else {
+        format!("{:.1} {}", value, UNITS[unit])
+    }
+}
+
 // ----------------------------------------------------------------------------
 // SlashFix
 // ----------------------------------------------------------------------------
@@ -90,6 +132,11 @@ pub fn get_global_db_path() -> Utf8PathBuf {
     get_anubis_home().join("toolchains.db")
 }
 
+/// Returns the global action cache and content-addressable store (`~/.anubis/cache`).
+pub fn get_global_cache_dir() -> Utf8PathBuf {
+    get_anubis_home().join("cache")
+}
+
 /// Returns the global temp directory for downloads (`~/.anubis/temp`).
 pub fn get_global_temp_dir() -> Utf8PathBuf {
     get_anubis_home().join("temp")
@@ -198,6 +245,143 @@ macro_rules! superluminal_span {
     }};
 }
 
+// ----------------------------------------------------------------------------
+// Root-relative Paths
+// ----------------------------------------------------------------------------
+
+/// Replaces every occurrence of `root` in `s` with `.` so strings that embed absolute paths
+/// (e.g. `-I{root}/include`) compare equal across checkouts.
+/// Only whole path components match: `{root}2/foo` is left untouched.
+pub fn root_relative(s: &str, root: &Utf8Path) -> String {
+    let root = root.as_str().trim_end_matches(['/', '\\']);
+    if root.is_empty() {
+        return s.to_owned();
+    }
+
+    let mut result = String::with_capacity(s.len());
+    let mut rest = s;
+    while let Some(idx) = rest.find(root) {
+        let after = &rest[idx + root.len()..];
+        result.push_str(&rest[..idx]);
+        if after.is_empty() || after.starts_with(['/', '\\', '=', ':', ' ']) {
+            result.push('.');
+        } else {
+            result.push_str(root);
+        }
+        rest = after;
+    }
+    result.push_str(rest);
+    result
+}
+
+/// Inverse of `root_relative` for a single path: `./foo` becomes `{root}/foo`.
+/// Paths that were not under the root are returned unchanged.
+pub fn resolve_root_relative(path: &Utf8Path, root: &Utf8Path) -> Utf8PathBuf {
+    match path.as_str().strip_prefix("./") {
+        Some(rel) => root.join(rel),
+        None if path == "." => root.to_owned(),
+        None => path.to_owned(),
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Binary Files
+// ----------------------------------------------------------------------------
+
+/// Writes `bytes` to a temporary sibling and renames it over `path`, creating parent directories.
+/// Readers see either the old file or the new one, never a partial write.
+pub fn write_atomic(path: &Utf8Path, bytes: &[u8]) -> anyhow::Result<()> {
+    if let Some(parent) = path.parent() {
+        std::fs::create_dir_all(parent).with_context(|| anyhow_loc!("Failed to create [{}]", parent))?;
+    }
+    let temp = temp_path(path);
+    std::fs::write(&temp, bytes).with_context(|| anyhow_loc!("Failed to write [{}]", temp))?;
+    std::fs::rename(&temp, path).with_context(|| anyhow_loc!("Failed to rename [{}] to [{}]", temp, path))?;
+    Ok(())
+}
+
+/// Unique sibling path used to write a file before atomically renaming it into place.
+pub fn temp_path(path: &Utf8Path) -> Utf8PathBuf {
+    static COUNTER: std::sync::atomic::AtomicU64 = std::sync::atomic::AtomicU64::new(0);
+    let n = COUNTER.fetch_add(1, std::sync::atomic::Ordering::Relaxed);
+    Utf8PathBuf::from(format!("{}.{}.{}.tmp", path, std::process::id(), n))
+}
+
+/// Appends `s` as `len:u32 bytes[len]`, the layout `ByteReader::str` reads back.
+pub fn put_str(bytes: &mut Vec<u8>, s: &str) {
+    bytes.extend((s.len() as u32).to_le_bytes());
+    bytes.extend(s.as_bytes());
+}
+
+/// Reads the little-endian binary formats anubis keeps on disk. `what` names the format in errors.
+pub struct ByteReader<'a> {
+    bytes: &'a [u8],
+    pos: usize,
+    what: &'static str,
+}
+
+impl<'a> ByteReader<'a> {
+    pub fn new(bytes: &'a [u8], what: &'static str) -> ByteReader<'a> {
+        ByteReader { bytes, pos: 0, what }
+    }
+
+    pub fn take(&mut self, n: usize) -> anyhow::Result<&'a [u8]> {
+        bail_loc_if!(n > self.bytes.len() - self.pos, "Unexpected end of {}", self.what);
+        let slice = &self.bytes[self.pos..self.pos + n];
+        self.pos += n;
+        Ok(slice)
+    }
+
+    pub fn flag(&mut self) -> anyhow::Result<bool> {
+        Ok(self.take(1)?[0] != 0)
+    }
+
+    pub fn u32(&mut self) -> anyhow::Result<u32> {
+        Ok(u32::from_le_bytes(self.take(4)?.try_into()?))
+    }
+
+    pub fn u64(&mut self) -> anyhow::Result<u64> {
+        Ok(u64::from_le_bytes(self.take(8)?.try_into()?))
+    }
+
+    /// Reads `has_value:u8 value:u64`. The value is always present, zero when absent.
+    pub fn optional_u64(&mut self) -> anyhow::Result<Option<u64>> {
+        let has_value = self.flag()?;
+        let value = self.u64()?;
+        Ok(has_value.then_some(value))
+    }
+
+    pub fn str(&mut self) -> anyhow::Result<&'a str> {
+        let len = self.u32()? as usize;
+        let bytes = self.take(len)?;
+        std::str::from_utf8(bytes).map_err(|e| anyhow_loc!("Invalid string in {}: {}", self.what, e))
+    }
+
+    pub fn string(&mut self) -> anyhow::Result<String> {
+        Ok(self.str()?.to_owned())
+    }
+
+    /// Reads `count:u32` followed by `count` items.
+    pub fn list<T>(
+        &mut self,
+        decode_item: impl Fn(&mut Self) -> anyhow::Result<T>,
+    ) -> anyhow::Result<Vec<T>> {
+        let count = self.u32()? as usize;
+        // Don't trust the count for the allocation, a truncated file would otherwise allocate it all
+        let mut items = Vec::with_capacity(count.min(self.bytes.len() - self.pos));
+        for _ in 0..count {
+            items.push(decode_item(self)?);
+        }
+        Ok(items)
+    }
+
+    /// Fails if anything is left after the last field.
+    pub fn finish(&self) -> anyhow::Result<()> {
+        bail_loc_if!(self.pos != self.bytes.len(), "Trailing bytes after {}", self.what);
+        Ok(())
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Hashing
 // ----------------------------------------------------------------------------
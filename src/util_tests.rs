@@ -1,6 +1,10 @@
 //! Tests for util.rs
 
-use crate::util::format_duration;
+use crate::assert_err;
+use crate::util::{
+    format_bytes, format_duration, parse_byte_size, put_str, resolve_root_relative, root_relative, ByteReader,
+};
+use camino::Utf8Path;
 use std::time::Duration;
 
 #[test]
@@ -34,3 +38,70 @@ fn format_duration_minutes() {
     assert_eq!(format_duration(Duration::from_secs(125)), "2m 5s");
     assert_eq!(format_duration(Duration::from_secs(3661)), "61m 1s");
 }
+
+#[test]
+fn parse_byte_size_suffixes() {
+    assert_eq!(parse_byte_size("512").unwrap(), 512);
+    assert_eq!(parse_byte_size("4k").unwrap(), 4 * 1024);
+    assert_eq!(parse_byte_size("300M").unwrap(), 300 * 1024 * 1024);
+    assert_eq!(parse_byte_size("10GB").unwrap(), 10 * 1024 * 1024 * 1024);
+    assert_err!(parse_byte_size(""));
+    assert_err!(parse_byte_size("ten"));
+    assert_err!(parse_byte_size("99999999999T"));
+}
+
+#[test]
+fn format_bytes_units() {
+    assert_eq!(format_bytes(0), "0 B");
+    assert_eq!(format_bytes(1023), "1023 B");
+    assert_eq!(format_bytes(1536), "1.5 KiB");
+    assert_eq!(format_bytes(10 * 1024 * 1024 * 1024), "10.0 GiB");
+}
+
+#[test]
+fn root_relative_replaces_whole_components() {
+    let root = Utf8Path::new("/home/dev/repo");
+    assert_eq!(root_relative("-I/home/dev/repo/include", root), "-I./include");
+    assert_eq!(root_relative("-ffile-prefix-map=/home/dev/repo=.", root), "-ffile-prefix-map=.=.");
+    assert_eq!(root_relative("/home/dev/repo", root), ".");
+    assert_eq!(root_relative("/home/dev/repo2/include", root), "/home/dev/repo2/include");
+    assert_eq!(root_relative("/usr/include", root), "/usr/include");
+    assert_eq!(root_relative("-c", Utf8Path::new("")), "-c");
+}
+
+#[test]
+fn resolve_root_relative_roundtrip() {
+    let root = Utf8Path::new("/home/dev/repo");
+    let rel = root_relative("/home/dev/repo/src/foo.h", root);
+    assert_eq!(resolve_root_relative(Utf8Path::new(&rel), root), "/home/dev/repo/src/foo.h");
+    assert_eq!(resolve_root_relative(Utf8Path::new("."), root), "/home/dev/repo");
+    assert_eq!(resolve_root_relative(Utf8Path::new("/usr/include/stdio.h"), root), "/usr/include/stdio.h");
+}
+
+#[test]
+fn byte_reader_reads_what_was_written() -> anyhow::Result<()> {
+    let mut bytes = vec![1u8];
+    bytes.extend(7u32.to_le_bytes());
+    bytes.extend(u64::MAX.to_le_bytes());
+    put_str(&mut bytes, "héllo");
+    bytes.extend(2u32.to_le_bytes());
+    put_str(&mut bytes, "a");
+    put_str(&mut bytes, "");
+
+    let mut r = ByteReader::new(&bytes, "test file");
+    assert!(r.flag()?);
+    assert_eq!(r.u32()?, 7);
+    assert_eq!(r.u64()?, u64::MAX);
+    assert_eq!(r.str()?, "héllo");
+    assert_eq!(r.list(ByteReader::string)?, ["a", ""]);
+    r.finish()?;
+
+    // Truncated input and leftover bytes are both errors
+    let mut r = ByteReader::new(&bytes[..bytes.len() - 1], "test file");
+    r.take(bytes.len() - 4)?;
+    assert_err!(r.u32());
+    let mut r = ByteReader::new(&bytes, "test file");
+    r.flag()?;
+    assert!(r.finish().unwrap_err().to_string().contains("Trailing bytes after test file"));
+    Ok(())
+}